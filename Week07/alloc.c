@@ -0,0 +1,99 @@
+/* 
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "alloc.h"
+
+__thread long allocCount;
+
+void* memAlloc(size_t size) {
+  allocCount ++;
+  return malloc(size);
+}
+
+void* memRealloc(void* ptr, size_t size) {
+  allocCount ++;
+  return realloc(ptr, size);
+}
+
+void memFree(void* ptr) {
+  free(ptr);
+}
+
+/******************************************************************/
+
+#define REGION_BLOCK_SIZE (64 * 1024)
+#define REGION_ALIGN 16
+
+struct RegionBlock_ {
+  RegionBlock *next;
+  size_t size;
+  /* keeps the payload aligned like malloc */
+  union { long double ld; void *p; long l; } align;
+};
+
+void* regionAlloc(Region* region, size_t size) {
+  RegionBlock *block;
+  size_t blockSize;
+  char *p;
+
+  size = (size + REGION_ALIGN - 1) & ~(size_t) (REGION_ALIGN - 1);
+  if (region->next == NULL || (size_t) (region->limit - region->next) < size) {
+    blockSize = size > REGION_BLOCK_SIZE ? size : REGION_BLOCK_SIZE;
+    if (region->spare != NULL && region->spare->size >= size) {
+      block = region->spare;
+      region->spare = block->next;
+      blockSize = block->size;
+    } else {
+      block = (RegionBlock*) memAlloc(sizeof(RegionBlock) + blockSize);
+      block->size = blockSize;
+    }
+    block->next = region->blocks;
+    region->blocks = block;
+    region->next = (char*) (block + 1);
+    region->limit = region->next + blockSize;
+  }
+
+  p = region->next;
+  region->next += size;
+  return p;
+}
+
+/* Region memory cannot be resized in place; the old copy stays until
+ * the region is released.
+ */
+void* regionGrow(Region* region, void* ptr, size_t oldSize, size_t size) {
+  void *p = regionAlloc(region, size);
+  if (ptr != NULL)
+    memcpy(p, ptr, oldSize);
+  return p;
+}
+
+/* Forget everything handed out but keep the blocks for the next use */
+void regionReset(Region* region) {
+  RegionBlock *block;
+
+  while (region->blocks != NULL) {
+    block = region->blocks;
+    region->blocks = block->next;
+    block->next = region->spare;
+    region->spare = block;
+  }
+  region->next = NULL;
+  region->limit = NULL;
+}
+
+void regionRelease(Region* region) {
+  RegionBlock *block;
+
+  regionReset(region);
+  while (region->spare != NULL) {
+    block = region->spare;
+    region->spare = block->next;
+    memFree(block);
+  }
+}
@@ -0,0 +1,40 @@
+/* 
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#ifndef __ALLOC_H__
+#define __ALLOC_H__
+
+#include <stddef.h>
+
+/* All heap memory of the compiler goes through these wrappers so that
+ * the number of allocations can be observed. The count is per thread,
+ * like the compilations themselves.
+ */
+extern __thread long allocCount;
+
+void* memAlloc(size_t size);
+void* memRealloc(void* ptr, size_t size);
+void memFree(void* ptr);
+
+/* A region hands out memory by bumping a pointer through large blocks
+ * and releases everything it handed out at once. A reset region keeps
+ * its blocks as spares, so reusing it costs no allocation.
+ */
+typedef struct RegionBlock_ RegionBlock;
+
+typedef struct {
+  RegionBlock *blocks;
+  RegionBlock *spare;
+  char *next;
+  char *limit;
+} Region;
+
+void* regionAlloc(Region* region, size_t size);
+void* regionGrow(Region* region, void* ptr, size_t oldSize, size_t size);
+void regionReset(Region* region);
+void regionRelease(Region* region);
+
+#endif
@@ -0,0 +1,62 @@
+/* Abstract syntax tree
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#include <string.h>
+#include "alloc.h"
+#include "ast.h"
+
+#define AST_INITIAL_NODES 1024
+#define AST_INITIAL_OBJECTS 256
+
+/* The arena grows by doubling. Nodes refer to each other by index, so
+ * moving the array leaves the tree intact.
+ */
+AstRef newAstNode(Ast *ast, enum AstKind kind, int pos) {
+  AstNode *node;
+
+  if (ast->count == 0) ast->count = 1;
+  if (ast->count >= ast->capacity) {
+    ast->capacity = ast->capacity == 0 ? AST_INITIAL_NODES : ast->capacity * 2;
+    ast->nodes = (AstNode*) memRealloc(ast->nodes, ast->capacity * sizeof(AstNode));
+  }
+
+  node = &ast->nodes[ast->count];
+  memset(node, 0, sizeof(AstNode));
+  node->kind = kind;
+  node->pos = pos;
+  return ast->count++;
+}
+
+AstRef newAstObjectNode(Ast *ast, enum AstKind kind, int pos, struct Object_ *obj) {
+  AstRef ref = newAstNode(ast, kind, pos);
+
+  if (ast->objectCount == ast->objectCapacity) {
+    ast->objectCapacity = ast->objectCapacity == 0 ? AST_INITIAL_OBJECTS : ast->objectCapacity * 2;
+    ast->objects = (struct Object_**) memRealloc(ast->objects, ast->objectCapacity * sizeof(struct Object_*));
+  }
+  ast->objects[ast->objectCount] = obj;
+  ast->nodes[ref].value = ast->objectCount++;
+  return ref;
+}
+
+uint32_t astNodeCount(Ast *ast) {
+  return ast->count == 0 ? 0 : ast->count - 1;
+}
+
+size_t astBytes(Ast *ast) {
+  return astNodeCount(ast) * sizeof(AstNode) + ast->objectCount * sizeof(struct Object_*);
+}
+
+void resetAst(Ast *ast) {
+  ast->count = 1;
+  ast->objectCount = 0;
+}
+
+void cleanAst(Ast *ast) {
+  memFree(ast->nodes);
+  memFree(ast->objects);
+  memset(ast, 0, sizeof(Ast));
+}
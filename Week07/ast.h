@@ -0,0 +1,97 @@
+/* Abstract syntax tree
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#ifndef __AST_H__
+#define __AST_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* A node is named by its 32-bit index in the arena of its compilation.
+ * Index 0 is never a node and stands for none.
+ */
+typedef uint32_t AstRef;
+
+#define NO_NODE 0
+
+/* The children of each kind of node. A list of statements or arguments
+ * is chained through next.
+ *
+ *   AST_ASSIGN    child[0] the lvalue, child[1] the expression
+ *   AST_CALL      object the procedure, child[0] the arguments
+ *   AST_GROUP     child[0] the statements
+ *   AST_IF        child[0] the condition, child[1] then, child[2] else
+ *   AST_WHILE     child[0] the condition, child[1] the body
+ *   AST_FOR       object the variable, child[0] from, child[1] to,
+ *                 child[2] the body
+ *   AST_NUMBER    value the number, or an integer constant
+ *   AST_CHAR      value the character, or a character constant
+ *   AST_VARIABLE  object a variable, a parameter or the function result
+ *   AST_INDEX     child[0] the array, child[1] the index
+ *   AST_FCALL     object the function, child[0] the arguments
+ *   AST_UNARY     op SB_PLUS or SB_MINUS, child[0] the operand
+ *   AST_BINARY    op SB_PLUS, SB_MINUS, SB_TIMES or SB_SLASH,
+ *                 child[0] and child[1] the operands
+ *   AST_COMPARE   op the comparator, child[0] and child[1] the operands
+ */
+enum AstKind {
+  AST_ASSIGN,
+  AST_CALL,
+  AST_GROUP,
+  AST_IF,
+  AST_WHILE,
+  AST_FOR,
+  AST_NUMBER,
+  AST_CHAR,
+  AST_VARIABLE,
+  AST_INDEX,
+  AST_FCALL,
+  AST_UNARY,
+  AST_BINARY,
+  AST_COMPARE
+};
+
+/* pos is the last token of an expression, an assignment or a
+ * condition, and the variable of a FOR.
+ */
+typedef struct {
+  unsigned char kind;
+  unsigned char op;
+  unsigned short unused;
+  int pos;
+  AstRef child[3];
+  AstRef next;
+  int value;
+} AstNode;
+
+/* The nodes of one compilation in a single array. Objects are named by
+ * their index in a table of their own, so a node holds no pointer. A
+ * zeroed arena is empty; a reset one keeps its arrays.
+ */
+typedef struct {
+  AstNode *nodes;
+  uint32_t count;
+  uint32_t capacity;
+  struct Object_ **objects;
+  uint32_t objectCount;
+  uint32_t objectCapacity;
+} Ast;
+
+#define astAt(ast, ref) (&(ast)->nodes[ref])
+#define astObjectAt(ast, node) ((ast)->objects[(node)->value])
+
+AstRef newAstNode(Ast *ast, enum AstKind kind, int pos);
+/* A node that names obj in its value */
+AstRef newAstObjectNode(Ast *ast, enum AstKind kind, int pos, struct Object_ *obj);
+
+/* The number of nodes and the bytes they and the object table take */
+uint32_t astNodeCount(Ast *ast);
+size_t astBytes(Ast *ast);
+
+void resetAst(Ast *ast);
+void cleanAst(Ast *ast);
+
+#endif
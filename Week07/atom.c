@@ -0,0 +1,191 @@
+/* Interned identifiers
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "alloc.h"
+#include "atom.h"
+
+#define ATOM_BLOCK_SIZE 4096
+
+/* Names are packed into blocks that never move, so atomName() pointers
+ * stay valid until cleanAtoms(). The hash index is open addressing with
+ * linear probing and is kept at most half full.
+ */
+typedef struct AtomBlock_ {
+  struct AtomBlock_ *next;
+  int used;
+  int size;
+  char text[];
+} AtomBlock;
+
+typedef struct AtomEntry_ {
+  unsigned int hash;
+  int length;
+  const char *name;
+} AtomEntry;
+
+static const char *const predefinedNames[PREDEFINED_ATOMS] = {
+  "READC", "READI", "WRITEI", "WRITEC", "WRITELN", "I", "CH"
+};
+
+
+/* Names are folded to upper case as they are hashed, compared and
+ * stored, so that text is never copied to be looked up
+ */
+static unsigned int hashName(const char *text, int length) {
+  unsigned int h = 2166136261u;
+  int i;
+
+  for (i = 0; i < length; i++)
+    h = (h ^ (unsigned char) toupper((unsigned char) text[i])) * 16777619u;
+  return h;
+}
+
+static int sameName(const char *name, const char *text, int length) {
+  int i;
+
+  for (i = 0; i < length; i++)
+    if (name[i] != toupper((unsigned char) text[i])) return 0;
+  return 1;
+}
+
+static char *storeName(AtomTable *table, const char *text, int length) {
+  AtomBlock *block = table->blocks;
+  char *name;
+  int size, i;
+
+  if (block == NULL || block->size - block->used < length + 1) {
+    size = length + 1 > ATOM_BLOCK_SIZE ? length + 1 : ATOM_BLOCK_SIZE;
+    block = (AtomBlock*) memAlloc(sizeof(AtomBlock) + size);
+    block->next = table->blocks;
+    block->used = 0;
+    block->size = size;
+    table->blocks = block;
+  }
+
+  name = block->text + block->used;
+  for (i = 0; i < length; i++)
+    name[i] = toupper((unsigned char) text[i]);
+  name[length] = '\0';
+  block->used += length + 1;
+  return name;
+}
+
+static void rehash(AtomTable *table) {
+  Atom a;
+  int b;
+
+  for (b = 0; b <= table->bucketMask; b++)
+    table->buckets[b] = NO_ATOM;
+  for (a = 0; a < table->total; a++) {
+    b = table->entries[a].hash & table->bucketMask;
+    while (table->buckets[b] != NO_ATOM)
+      b = (b + 1) & table->bucketMask;
+    table->buckets[b] = a;
+  }
+}
+
+static void growBuckets(AtomTable *table) {
+  int size = table->bucketMask == 0 ? 256 : (table->bucketMask + 1) * 2;
+
+  memFree(table->buckets);
+  table->buckets = (Atom*) memAlloc(size * sizeof(Atom));
+  table->bucketMask = size - 1;
+  rehash(table);
+}
+
+/* The predefined names take the first atoms; their text is static. A
+ * table that was reset keeps its arrays.
+ */
+static void predefineAtoms(AtomTable *table) {
+  int a;
+
+  if (table->capacity == 0) {
+    table->capacity = 128;
+    table->entries = (AtomEntry*) memAlloc(table->capacity * sizeof(AtomEntry));
+  }
+  for (a = 0; a < PREDEFINED_ATOMS; a++) {
+    table->entries[a].name = predefinedNames[a];
+    table->entries[a].length = strlen(predefinedNames[a]);
+    table->entries[a].hash = hashName(table->entries[a].name, table->entries[a].length);
+  }
+  table->total = PREDEFINED_ATOMS;
+  if (table->bucketMask == 0) growBuckets(table);
+  else rehash(table);
+}
+
+/* The atom of text[0..length), folded to upper case */
+Atom internName(AtomTable *table, const char *text, int length) {
+  unsigned int h;
+  Atom a;
+  int b;
+
+  if (table->total == 0)
+    predefineAtoms(table);
+  if (2 * (table->total + 1) > table->bucketMask + 1)
+    growBuckets(table);
+
+  h = hashName(text, length);
+  b = h & table->bucketMask;
+  while ((a = table->buckets[b]) != NO_ATOM) {
+    if (table->entries[a].hash == h && table->entries[a].length == length
+	&& sameName(table->entries[a].name, text, length))
+      break;
+    b = (b + 1) & table->bucketMask;
+  }
+
+  if (a == NO_ATOM) {
+    if (table->total == table->capacity) {
+      table->capacity = table->capacity == 0 ? 128 : table->capacity * 2;
+      table->entries = (AtomEntry*) memRealloc(table->entries, table->capacity * sizeof(AtomEntry));
+    }
+    a = table->total++;
+    table->entries[a].hash = h;
+    table->entries[a].length = length;
+    table->entries[a].name = storeName(table, text, length);
+    table->buckets[b] = a;
+  }
+  return a;
+}
+
+const char *atomName(AtomTable *table, Atom atom) {
+  return table->entries[atom].name;
+}
+
+int atomCount(AtomTable *table) {
+  return table->total;
+}
+
+/* Drop all the names but keep the memory of the table for reuse */
+void resetAtoms(AtomTable *table) {
+  AtomBlock *block;
+
+  while (table->blocks != NULL && table->blocks->next != NULL) {
+    block = table->blocks;
+    table->blocks = block->next;
+    memFree(block);
+  }
+  if (table->blocks != NULL)
+    table->blocks->used = 0;
+  table->total = 0;
+}
+
+void cleanAtoms(AtomTable *table) {
+  AtomBlock *block;
+
+  while (table->blocks != NULL) {
+    block = table->blocks;
+    table->blocks = block->next;
+    memFree(block);
+  }
+  memFree(table->entries);
+  memFree(table->buckets);
+  table->entries = NULL;
+  table->buckets = NULL;
+  table->total = table->capacity = table->bucketMask = 0;
+}
@@ -0,0 +1,47 @@
+/* Interned identifiers
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#ifndef __ATOM_H__
+#define __ATOM_H__
+
+/* An atom is the index of a distinct upper-cased identifier. Two names
+ * are equal exactly when their atoms are.
+ */
+typedef int Atom;
+
+#define NO_ATOM (-1)
+
+/* Identifiers with atoms fixed at build time, so that the builtin
+ * environment can be constant data
+ */
+enum {
+  ATOM_READC,
+  ATOM_READI,
+  ATOM_WRITEI,
+  ATOM_WRITEC,
+  ATOM_WRITELN,
+  ATOM_I,
+  ATOM_CH,
+  PREDEFINED_ATOMS
+};
+
+/* The identifiers of one compilation. A zeroed table is empty. */
+typedef struct {
+  struct AtomBlock_ *blocks;
+  struct AtomEntry_ *entries;
+  int total;
+  int capacity;
+  Atom *buckets;
+  int bucketMask;
+} AtomTable;
+
+Atom internName(AtomTable *table, const char *text, int length);
+const char *atomName(AtomTable *table, Atom atom);
+int atomCount(AtomTable *table);
+void resetAtoms(AtomTable *table);
+void cleanAtoms(AtomTable *table);
+
+#endif
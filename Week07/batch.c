@@ -0,0 +1,167 @@
+/* Batch compilation
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <pthread.h>
+#include "alloc.h"
+#include "reader.h"
+#include "parser.h"
+#include "batch.h"
+
+/* Every worker compiles in its own context, reused from one file to the
+ * next, into a memory stream. The files are handed out one at a time
+ * through a shared counter, so a large file does not hold back a whole
+ * share of the list. The output of each file is kept until all the
+ * files before it are written.
+ */
+typedef struct {
+  char *output;
+  size_t size;
+  int result;
+  int done;
+} BatchResult;
+
+typedef struct {
+  char **fileNames;
+  int fileCount;
+  int next;
+  BatchResult *results;
+  Cache *cache;
+  pthread_mutex_t lock;
+  pthread_cond_t finished;
+} Batch;
+
+static void compileOne(Batch *batch, CompilerContext *ctx, int i) {
+  BatchResult *result = &(batch->results[i]);
+  char *output = NULL;
+  size_t size = 0;
+  FILE *out = open_memstream(&output, &size);
+
+  /* without a stream the file fails with no output */
+  if (out == NULL) result->result = IO_ERROR;
+  else {
+    ctx->out = out;
+    result->result = compile(ctx, batch->fileNames[i]);
+    if (result->result == IO_ERROR)
+      fprintf(out, "Can\'t read input file!\n");
+    fclose(out);
+  }
+
+  pthread_mutex_lock(&batch->lock);
+  result->output = output;
+  result->size = size;
+  result->done = 1;
+  pthread_cond_broadcast(&batch->finished);
+  pthread_mutex_unlock(&batch->lock);
+}
+
+static void *batchWorker(void *arg) {
+  Batch *batch = (Batch *) arg;
+  CompilerContext ctx;
+  int i;
+
+  initContext(&ctx, NULL);
+  ctx.cache = batch->cache;
+  while ((i = __sync_fetch_and_add(&batch->next, 1)) < batch->fileCount)
+    compileOne(batch, &ctx, i);
+  freeContext(&ctx);
+  return NULL;
+}
+
+int compileBatch(char **fileNames, int fileCount, int threads, Cache *cache, FILE *out) {
+  Batch batch;
+  pthread_t *workers;
+  int failed = 0, started = 0;
+  int i;
+
+  if (threads > fileCount) threads = fileCount;
+  if (threads < 1) threads = 1;
+
+  batch.fileNames = fileNames;
+  batch.fileCount = fileCount;
+  batch.next = 0;
+  batch.cache = cache;
+  batch.results = (BatchResult*) memAlloc(fileCount * sizeof(BatchResult));
+  memset(batch.results, 0, fileCount * sizeof(BatchResult));
+  pthread_mutex_init(&batch.lock, NULL);
+  pthread_cond_init(&batch.finished, NULL);
+
+  workers = (pthread_t*) memAlloc(threads * sizeof(pthread_t));
+  for (i = 0; i < threads; i++)
+    if (pthread_create(&workers[started], NULL, batchWorker, &batch) == 0)
+      started ++;
+  /* with no thread to wait for, the files are compiled here */
+  if (started == 0) batchWorker(&batch);
+
+  /* write the outputs in list order as they become available */
+  for (i = 0; i < fileCount; i++) {
+    pthread_mutex_lock(&batch.lock);
+    while (!batch.results[i].done)
+      pthread_cond_wait(&batch.finished, &batch.lock);
+    pthread_mutex_unlock(&batch.lock);
+
+    fprintf(out, "==> %s <==\n", fileNames[i]);
+    if (batch.results[i].output != NULL)
+      fwrite(batch.results[i].output, 1, batch.results[i].size, out);
+    free(batch.results[i].output);
+    if (batch.results[i].result == IO_ERROR) failed ++;
+  }
+
+  for (i = 0; i < started; i++)
+    pthread_join(workers[i], NULL);
+
+  pthread_cond_destroy(&batch.finished);
+  pthread_mutex_destroy(&batch.lock);
+  memFree(workers);
+  memFree(batch.results);
+  return failed;
+}
+
+/******************************************************************/
+
+static int compareNames(const void *a, const void *b) {
+  return strcmp(*(char * const *) a, *(char * const *) b);
+}
+
+char **listDirectory(char *dirName, int *fileCount) {
+  DIR *dir = opendir(dirName);
+  struct dirent *entry;
+  char **fileNames = NULL;
+  int count = 0, capacity = 0;
+  int length;
+
+  *fileCount = 0;
+  if (dir == NULL) return NULL;
+
+  while ((entry = readdir(dir)) != NULL) {
+    length = strlen(entry->d_name);
+    if (length < 5 || strcmp(entry->d_name + length - 4, ".kpl") != 0)
+      continue;
+    if (count == capacity) {
+      capacity = capacity == 0 ? 256 : capacity * 2;
+      fileNames = (char**) memRealloc(fileNames, capacity * sizeof(char*));
+    }
+    fileNames[count] = (char*) memAlloc(strlen(dirName) + length + 2);
+    sprintf(fileNames[count], "%s/%s", dirName, entry->d_name);
+    count ++;
+  }
+  closedir(dir);
+
+  qsort(fileNames, count, sizeof(char*), compareNames);
+  *fileCount = count;
+  return fileNames;
+}
+
+void freeFileList(char **fileNames, int fileCount) {
+  int i;
+
+  for (i = 0; i < fileCount; i++)
+    memFree(fileNames[i]);
+  memFree(fileNames);
+}
@@ -0,0 +1,26 @@
+/* Batch compilation
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#ifndef __BATCH_H__
+#define __BATCH_H__
+
+#include <stdio.h>
+#include "cache.h"
+
+/* Compile the files on a pool of threads and write the output of each
+ * to out, in the order of the list. cache may be NULL. Returns the
+ * number of files that could not be read, or whose output could not
+ * be kept.
+ */
+int compileBatch(char **fileNames, int fileCount, int threads, Cache *cache, FILE *out);
+
+/* The files of a directory whose name ends in .kpl, sorted by name. The
+ * list and the names are released with freeFileList().
+ */
+char **listDirectory(char *dirName, int *fileCount);
+void freeFileList(char **fileNames, int fileCount);
+
+#endif
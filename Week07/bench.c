@@ -0,0 +1,912 @@
+/* Benchmarks for the KPL compiler
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "alloc.h"
+#include "reader.h"
+#include "scanner.h"
+#include "simd.h"
+#include "atom.h"
+#include "parser.h"
+#include "error.h"
+#include "server.h"
+#include "kpl.h"
+#include "vm.h"
+#include "regvm.h"
+
+double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/******************************************************************/
+
+/* Generate a syntactically and semantically valid program with the
+ * given number of procedures. Used as a large input for the benchmarks.
+ */
+void genProgram(FILE *f, int units) {
+  int i;
+
+  fprintf(f, "Program Generated; (* generated benchmark input *)\n");
+  fprintf(f, "Const Limit = 100;\n");
+  fprintf(f, "Type Vector = Array(. 10 .) Of Integer;\n");
+  fprintf(f, "Var Total : Integer;\n    Buffer : Vector;\n\n");
+
+  for (i = 0; i < units; i++) {
+    fprintf(f, "(* procedure number %d, it only touches its own locals *)\n", i);
+    fprintf(f, "Procedure Work%d(Count : Integer; Var Result : Integer);\n", i);
+    fprintf(f, "Var Index : Integer;\n    Accumulator : Integer;\n    Letter : Char;\n");
+    fprintf(f, "Begin\n");
+    fprintf(f, "  Accumulator := 0;\n");
+    fprintf(f, "  For Index := 1 To Count Do\n");
+    fprintf(f, "    Begin\n");
+    fprintf(f, "      Accumulator := Accumulator + Index * %d - Buffer(. Index .);\n", i % 97);
+    fprintf(f, "      If Accumulator >= Limit Then Accumulator := Accumulator / 2\n");
+    fprintf(f, "    End;\n");
+    fprintf(f, "  Letter := 'x';\n");
+    fprintf(f, "  While Accumulator != 0 Do Accumulator := Accumulator - 1;\n");
+    fprintf(f, "  Result := Accumulator\n");
+    fprintf(f, "End;\n\n");
+  }
+
+  fprintf(f, "Begin\n  Total := 0");
+  for (i = 0; i < units; i++)
+    fprintf(f, ";\n  Call Work%d(%d, Total)", i, i % 10);
+  fprintf(f, ";\n  Call WriteI(Total)\nEnd.\n");
+}
+
+/* Mostly comments: every procedure is preceded by a long comment block */
+void genCommentHeavy(FILE *f, int units) {
+  int i, j;
+
+  fprintf(f, "Program Comments;\nVar Total : Integer;\n");
+  for (i = 0; i < units; i++) {
+    fprintf(f, "(* Procedure %d.\n", i);
+    for (j = 0; j < 24; j++)
+      fprintf(f, "   This line documents step %d of the procedure; it mentions x * y and (a) but no closing mark.\n", j);
+    fprintf(f, "*)\nProcedure P%d; Begin Total := Total + %d End;\n", i, i);
+  }
+  fprintf(f, "Begin\n  Total := 0\nEnd.\n");
+}
+
+/* Pathological trivia: a million comments and blank lines between two tokens */
+void genTrivia(FILE *f, int units) {
+  int i;
+
+  fprintf(f, "Program Trivia;\n");
+  for (i = 0; i < units; i++)
+    fprintf(f, i % 2 ? "(* %d *)\n\n" : "(**)   \t", i);
+  fprintf(f, "Begin\nEnd.\n");
+}
+
+/* One block with units constants and units variables */
+void genDeclHeavy(FILE *f, int units) {
+  int i;
+
+  fprintf(f, "Program Decls;\nConst\n");
+  for (i = 0; i < units; i++)
+    fprintf(f, "  C%d = %d;\n", i, i);
+  fprintf(f, "Var\n");
+  for (i = 0; i < units; i++)
+    fprintf(f, "  V%d : Integer;\n", i);
+  fprintf(f, "Begin\n  V0 := C%d\nEnd.\n", units > 0 ? units - 1 : 0);
+}
+
+/* units nested procedures; the innermost one uses a global many times */
+void genDeepNesting(FILE *f, int units) {
+  int i;
+
+  fprintf(f, "Program Deep;\nVar G : Integer;\n");
+  for (i = 0; i < units; i++)
+    fprintf(f, "Procedure P%d;\nVar L%d : Integer;\n", i, i);
+  fprintf(f, "Begin\n");
+  for (i = 0; i < 100 * units; i++)
+    fprintf(f, "  G := G + 1;\n");
+  fprintf(f, "  G := 0\nEnd;\n");
+  for (i = 1; i < units; i++)
+    fprintf(f, "Begin G := G + L%d End;\n", units - 1 - i);
+  fprintf(f, "Begin Call P0 End.\n");
+}
+
+/* Mostly long identifiers in expression-heavy statements */
+void genIdentHeavy(FILE *f, int units) {
+  int i, j;
+
+  fprintf(f, "Program Identifiers;\n");
+  fprintf(f, "Var AccumulatorOne : Integer;\n    AccumulatorTwo : Integer;\n");
+  fprintf(f, "    IntermediateRes : Integer;\n    LoopCounterVal : Integer;\n");
+  for (i = 0; i < units; i++) {
+    fprintf(f, "Procedure ComputeStep%d;\nBegin\n", i);
+    for (j = 0; j < 16; j++)
+      fprintf(f, "  IntermediateRes := AccumulatorOne * LoopCounterVal + AccumulatorTwo - IntermediateRes;\n");
+    fprintf(f, "  AccumulatorOne := IntermediateRes\nEnd;\n");
+  }
+  fprintf(f, "Begin\n  AccumulatorOne := 0\nEnd.\n");
+}
+
+/* Write a corpus of small programs of varied sizes, as a grading run
+ * would see them; one in sixteen has a semantic error.
+ */
+int genCorpus(char *dirName, int files) {
+  char fileName[1024];
+  FILE *f;
+  int i;
+
+  mkdir(dirName, 0755);
+  for (i = 0; i < files; i++) {
+    snprintf(fileName, sizeof(fileName), "%s/prog%05d.kpl", dirName, i);
+    f = fopen(fileName, "w");
+    if (f == NULL) return IO_ERROR;
+    if (i % 16 == 15)
+      fprintf(f, "Program Broken%d;\nVar X : Integer;\nBegin\n  X := Y%d\nEnd.\n", i, i);
+    else genProgram(f, 1 + i % 40);
+    fclose(f);
+  }
+  return IO_SUCCESS;
+}
+
+/******************************************************************/
+
+/* Scan the whole file `reps` times and report the lexing throughput. */
+int benchLex(char *fileName, int mode, int reps, SimdLevel simd) {
+  long tokens = 0, bytes = 0;
+  long allocs = 0;
+  double start, elapsed;
+  CompilerContext ctx;
+  Token token;
+  FILE *f;
+  int i;
+
+  f = fopen(fileName, "rb");
+  if (f == NULL) return IO_ERROR;
+  fseek(f, 0, SEEK_END);
+  bytes = ftell(f);
+  fclose(f);
+
+  simd = selectSimdLevel(simd);
+
+  initContext(&ctx, stdout);
+  start = now();
+  for (i = 0; i < reps; i++) {
+    if (openInputStreamMode(&ctx, fileName, mode) == IO_ERROR)
+      return IO_ERROR;
+    if (setjmp(ctx.errorJump) != 0) {
+      printDiagnostic(&ctx);
+      closeInputStream(&ctx);
+      cleanAtoms(&ctx.atoms);
+      return IO_ERROR;
+    }
+    allocs -= allocCount;
+    do {
+      getToken(&ctx, &token);
+      tokens ++;
+    } while (token.tokenType != TK_EOF);
+    allocs += allocCount;
+    closeInputStream(&ctx);
+  }
+  elapsed = now() - start;
+
+  printf("lex (%s, %s): %ld tokens, %.1f MB in %.3f s: %.1f MB/s, %.1f Mtokens/s\n",
+	 mode == INPUT_MODE_MMAP ? "mmap" : "stream", simdLevelName(simd),
+	 tokens, bytes * (double) reps / 1e6, elapsed,
+	 bytes * (double) reps / 1e6 / elapsed, tokens / 1e6 / elapsed);
+  printf("heap allocations while scanning: %ld (%d distinct identifiers)\n", allocs, atomCount(&ctx.atoms));
+  cleanAtoms(&ctx.atoms);
+  return IO_SUCCESS;
+}
+
+/******************************************************************/
+
+/* Scan a file on a thread whose stack is painted with a known pattern,
+ * then report how much of it was touched. The stack is deliberately
+ * small: a scanner that recursed per comment would overflow it.
+ */
+#define STRESS_STACK_SIZE (256 * 1024)
+#define STACK_PAINT 0xA5
+
+struct StressJob {
+  char *fileName;
+  long tokens;
+  double elapsed;
+};
+
+void *stressWorker(void *arg) {
+  struct StressJob *job = (struct StressJob *) arg;
+  CompilerContext ctx;
+  Token token;
+  double start = now();
+
+  initContext(&ctx, stdout);
+  if (openInputStream(&ctx, job->fileName) == IO_ERROR)
+    return NULL;
+  if (setjmp(ctx.errorJump) == 0)
+    do {
+      getToken(&ctx, &token);
+      job->tokens ++;
+    } while (token.tokenType != TK_EOF);
+  else printDiagnostic(&ctx);
+  closeInputStream(&ctx);
+  cleanAtoms(&ctx.atoms);
+  job->elapsed = now() - start;
+  return NULL;
+}
+
+int benchStress(char *fileName) {
+  struct StressJob job;
+  pthread_attr_t attr;
+  pthread_t thread;
+  unsigned char *stack;
+  size_t untouched = 0;
+
+  stack = mmap(NULL, STRESS_STACK_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (stack == MAP_FAILED) return IO_ERROR;
+  memset(stack, STACK_PAINT, STRESS_STACK_SIZE);
+
+  job.fileName = fileName;
+  job.tokens = 0;
+  job.elapsed = 0;
+  pthread_attr_init(&attr);
+  pthread_attr_setstack(&attr, stack, STRESS_STACK_SIZE);
+  if (pthread_create(&thread, &attr, stressWorker, &job) != 0)
+    return IO_ERROR;
+  pthread_join(thread, NULL);
+  pthread_attr_destroy(&attr);
+
+  /* the stack grows down, so untouched bytes are at the low end */
+  while (untouched < STRESS_STACK_SIZE && stack[untouched] == STACK_PAINT)
+    untouched ++;
+  munmap(stack, STRESS_STACK_SIZE);
+
+  if (job.tokens == 0) return IO_ERROR;
+  printf("stress %s: %ld tokens in %.3f s, stack used %zu bytes\n",
+	 fileName, job.tokens, job.elapsed, (size_t) STRESS_STACK_SIZE - untouched);
+  return IO_SUCCESS;
+}
+
+/******************************************************************/
+
+/* The linear keyword scan that checkKeyword used before the perfect hash */
+struct {
+  char *string;
+  TokenType tokenType;
+} linearKeywords[20] = {
+  {"PROGRAM", KW_PROGRAM}, {"CONST", KW_CONST}, {"TYPE", KW_TYPE}, {"VAR", KW_VAR},
+  {"INTEGER", KW_INTEGER}, {"CHAR", KW_CHAR}, {"ARRAY", KW_ARRAY}, {"OF", KW_OF},
+  {"FUNCTION", KW_FUNCTION}, {"PROCEDURE", KW_PROCEDURE}, {"BEGIN", KW_BEGIN},
+  {"END", KW_END}, {"CALL", KW_CALL}, {"IF", KW_IF}, {"THEN", KW_THEN},
+  {"ELSE", KW_ELSE}, {"WHILE", KW_WHILE}, {"DO", KW_DO}, {"FOR", KW_FOR}, {"TO", KW_TO}
+};
+
+int keywordEq(char *kw, char *string) {
+  while ((*kw != '\0') && (*string != '\0')) {
+    if (*kw != *string) break;
+    kw ++; string ++;
+  }
+  return ((*kw == '\0') && (*string == '\0'));
+}
+
+TokenType checkKeywordLinear(char *string) {
+  int i;
+  for (i = 0; i < 20; i++)
+    if (keywordEq(linearKeywords[i].string, string))
+      return linearKeywords[i].tokenType;
+  return TK_NONE;
+}
+
+/* A mix of keywords and identifiers as they come out of the scanner */
+char *benchWords[] = {
+  "PROGRAM", "VAR", "INDEX", "INTEGER", "ACCUMULATOR", "BEGIN", "FOR", "I",
+  "TO", "COUNT", "DO", "RESULT", "IF", "N", "THEN", "TOTAL", "ELSE", "X",
+  "WHILE", "BUFFER", "END", "WORK17", "CALL", "WRITEI", "LETTER", "CHAR",
+  "ARRAY", "OF", "TMP", "PROCEDURE", "FUNCTION", "SUM"
+};
+#define BENCH_WORDS (sizeof(benchWords) / sizeof(benchWords[0]))
+
+void benchKeywords(long iterations) {
+  int lengths[BENCH_WORDS];
+  long i, found;
+  int w;
+  double start, linear, hashed;
+
+  for (i = 0; i < BENCH_WORDS; i++)
+    lengths[i] = strlen(benchWords[i]);
+
+  for (i = 0; i < BENCH_WORDS; i++)
+    if (checkKeywordLinear(benchWords[i]) != checkKeyword(benchWords[i], lengths[i]))
+      printf("mismatch on %s\n", benchWords[i]);
+
+  found = 0;
+  start = now();
+  for (i = 0, w = 0; i < iterations; i++, w = (w + 1 == BENCH_WORDS) ? 0 : w + 1)
+    found += checkKeywordLinear(benchWords[w]) != TK_NONE;
+  linear = now() - start;
+
+  start = now();
+  for (i = 0, w = 0; i < iterations; i++, w = (w + 1 == BENCH_WORDS) ? 0 : w + 1)
+    found += checkKeyword(benchWords[w], lengths[w]) != TK_NONE;
+  hashed = now() - start;
+
+  printf("keywords: %ld lookups (%ld hits)\n", iterations, found / 2);
+  printf("  linear scan:  %.2f ns/lookup\n", linear * 1e9 / iterations);
+  printf("  perfect hash: %.2f ns/lookup\n", hashed * 1e9 / iterations);
+}
+
+/******************************************************************/
+
+/* A hardware cache-miss counter for this thread, or -1 where the kernel
+ * or the virtual machine does not expose one.
+ */
+int openCacheMissCounter(void) {
+  struct perf_event_attr attr;
+
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.config = PERF_COUNT_HW_CACHE_MISSES;
+  attr.disabled = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+/* Compile a file reps times in one context, with the object tree and
+ * the diagnostics written to /dev/null
+ */
+int benchParse(char *fileName, int reps) {
+  CompilerContext ctx;
+  double start, elapsed;
+  long long misses = 0;
+  int counter = openCacheMissCounter();
+  int errors = 0, result = IO_SUCCESS, i;
+  uint32_t nodes;
+  size_t bytes;
+  FILE *devnull = fopen("/dev/null", "w");
+
+  if (devnull == NULL) return IO_ERROR;
+  initContext(&ctx, devnull);
+
+  if (counter >= 0) ioctl(counter, PERF_EVENT_IOC_ENABLE, 0);
+  start = now();
+  for (i = 0; i < reps; i++) {
+    result = compile(&ctx, fileName);
+    if (result == IO_ERROR) break;
+    if (result == COMPILE_ERROR) errors ++;
+  }
+  elapsed = now() - start;
+  if (counter >= 0) {
+    ioctl(counter, PERF_EVENT_IOC_DISABLE, 0);
+    if (read(counter, &misses, sizeof(misses)) != sizeof(misses)) misses = -1;
+    close(counter);
+  }
+
+  nodes = astNodeCount(&ctx.ast);
+  bytes = astBytes(&ctx.ast);
+  freeContext(&ctx);
+  fclose(devnull);
+  if (result == IO_ERROR) return IO_ERROR;
+
+  printf("parse %s: %.3f ms/compile, ast %u nodes in %lu bytes", fileName,
+	 elapsed * 1e3 / reps, nodes, (unsigned long) bytes);
+  if (counter >= 0) printf(", %lld cache misses/compile", misses / reps);
+  else printf(", cache misses n/a (no hardware counters)");
+  if (errors > 0) printf(", %d/%d with errors", errors, reps);
+  printf("\n");
+  return IO_SUCCESS;
+}
+
+/* Compile a file from memory reps times through the library */
+int benchLibrary(char *fileName, int reps) {
+  kpl_options options = { 1, NULL, 0 };
+  kpl_result result;
+  double start, elapsed;
+  char *source;
+  size_t size;
+  FILE *f;
+  int i;
+
+  f = fopen(fileName, "rb");
+  if (f == NULL) return IO_ERROR;
+  fseek(f, 0, SEEK_END);
+  size = ftell(f);
+  rewind(f);
+  source = (char*) memAlloc(size + 1);
+  if (fread(source, 1, size, f) != size) size = 0;
+  fclose(f);
+
+  start = now();
+  for (i = 0; i < reps; i++) {
+    kpl_compile_buffer(source, size, &options, &result);
+    if (i < reps - 1) kpl_free_result(&result);
+  }
+  elapsed = now() - start;
+
+  printf("kpl_compile_buffer %s: %.3f ms/compile, ", fileName, elapsed * 1e3 / reps);
+  if (result.status == KPL_OK)
+    printf("%ld bytes of objects\n", (long) result.objectsSize);
+  else if (result.diagnosticCount > 0)
+    printf("%d-%d:%s\n", result.diagnostics[0].line, result.diagnostics[0].column, result.diagnostics[0].message);
+  else printf("failed\n");
+  kpl_free_result(&result);
+  kpl_thread_cleanup();
+  memFree(source);
+  return IO_SUCCESS;
+}
+
+/******************************************************************/
+
+/* Run the compiler on a small file reps times, from exec to exit. On a
+ * small input this is dominated by process startup and initialization.
+ */
+int benchStartup(char *compiler, char *fileName, int reps) {
+  double start, elapsed;
+  int devnull, status, i;
+  pid_t pid;
+
+  devnull = open("/dev/null", O_WRONLY);
+  if (devnull < 0) return IO_ERROR;
+
+  start = now();
+  for (i = 0; i < reps; i++) {
+    pid = fork();
+    if (pid == 0) {
+      dup2(devnull, 1);
+      execl(compiler, compiler, fileName, (char *) NULL);
+      _exit(127);
+    }
+    if (pid < 0 || waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+      close(devnull);
+      return IO_ERROR;
+    }
+  }
+  elapsed = now() - start;
+  close(devnull);
+
+  printf("startup %s %s: %.1f us/run over %d runs\n", compiler, fileName, elapsed * 1e6 / reps, reps);
+  return IO_SUCCESS;
+}
+
+/******************************************************************/
+
+static int compareDoubles(const void *a, const void *b) {
+  double x = *(const double *) a, y = *(const double *) b;
+  return x < y ? -1 : x > y;
+}
+
+static void printLatency(char *what, double *samples, int reps) {
+  double total = 0;
+  int i;
+
+  qsort(samples, reps, sizeof(double), compareDoubles);
+  for (i = 0; i < reps; i++) total += samples[i];
+  printf("  %-22s p50 %8.1f us  p99 %8.1f us  mean %8.1f us\n", what,
+	 samples[reps / 2] * 1e6, samples[(int) (reps * 0.99)] * 1e6, total * 1e6 / reps);
+}
+
+/* Per-request latency of a compile server, one connection per request
+ * as a web front end would make, against one compiler process per file.
+ */
+int benchLatency(char *socketPath, char *compiler, char *fileName, int reps) {
+  double *samples = (double*) memAlloc(reps * sizeof(double));
+  char *source, *output;
+  size_t size, outputSize;
+  double start;
+  int devnull, status, fd, i;
+  pid_t pid;
+  FILE *f;
+
+  f = fopen(fileName, "rb");
+  if (f == NULL) return IO_ERROR;
+  fseek(f, 0, SEEK_END);
+  size = ftell(f);
+  rewind(f);
+  source = (char*) memAlloc(size + 1);
+  if (fread(source, 1, size, f) != size) size = 0;
+  fclose(f);
+
+  /* the server may still be starting */
+  for (i = 0; i < 200 && (fd = connectServer(socketPath)) < 0; i++)
+    usleep(10000);
+  if (fd < 0) return IO_ERROR;
+  close(fd);
+
+  printf("latency %s over %d requests:\n", fileName, reps);
+  for (i = 0; i < reps; i++) {
+    start = now();
+    fd = connectServer(socketPath);
+    if (fd < 0 || requestCompile(fd, source, size, &output, &outputSize) < 0) return IO_ERROR;
+    close(fd);
+    samples[i] = now() - start;
+    memFree(output);
+  }
+  printLatency("server:", samples, reps);
+
+  devnull = open("/dev/null", O_WRONLY);
+  if (devnull < 0) return IO_ERROR;
+  for (i = 0; i < reps; i++) {
+    start = now();
+    pid = fork();
+    if (pid == 0) {
+      dup2(devnull, 1);
+      execl(compiler, compiler, fileName, (char *) NULL);
+      _exit(127);
+    }
+    if (pid < 0 || waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+      close(devnull);
+      return IO_ERROR;
+    }
+    samples[i] = now() - start;
+  }
+  close(devnull);
+  printLatency("process per file:", samples, reps);
+
+  memFree(source);
+  memFree(samples);
+  return IO_SUCCESS;
+}
+
+/******************************************************************/
+
+/* Run a compiled program reps times under each dispatch of the machine
+ * and keep the best time of each. The two loops execute the same
+ * instructions with the same handlers, so the difference per
+ * instruction is what the switch costs over threading for dispatch.
+ */
+int benchMachine(char *fileName, int reps) {
+  VMDispatch dispatches[2] = { VM_DISPATCH_SWITCH, VM_DISPATCH_THREADED };
+  double best[2], start, elapsed;
+  CodeBlock code = { NULL, 0, 0 };
+  CompilerContext ctx;
+  Machine machine;
+  VMStatus status = VM_HALTED;
+  FILE *devnull = fopen("/dev/null", "w+");
+  int result, i, j;
+
+  if (devnull == NULL) return IO_ERROR;
+  initContext(&ctx, devnull);
+  ctx.code = &code;
+  result = compile(&ctx, fileName);
+  freeContext(&ctx);
+  if (result != IO_SUCCESS) {
+    fclose(devnull);
+    cleanCode(&code);
+    return IO_ERROR;
+  }
+
+  for (j = 0; j < 2; j++) {
+    best[j] = 0;
+    initMachine(&machine, devnull, devnull);
+    machine.dispatch = dispatches[j];
+    for (i = 0; i < reps && status == VM_HALTED; i++) {
+      rewind(devnull);
+      start = now();
+      status = runMachine(&machine, &code);
+      elapsed = now() - start;
+      if (i == 0 || elapsed < best[j]) best[j] = elapsed;
+    }
+  }
+  fclose(devnull);
+  cleanCode(&code);
+  if (status != VM_HALTED) {
+    printf("vm %s: %s\n", fileName, vmStatusMessage(status));
+    return IO_SUCCESS;
+  }
+
+  printf("vm %s: %lld instructions, %s %.2f ns/instruction", fileName, machine.instructions,
+	 dispatchName(VM_DISPATCH_SWITCH), best[0] * 1e9 / machine.instructions);
+  if (selectDispatch(VM_DISPATCH_THREADED) == VM_DISPATCH_THREADED)
+    printf(", %s %.2f ns/instruction, dispatch overhead %.2f ns/instruction (%.0f%%)\n",
+	   dispatchName(VM_DISPATCH_THREADED), best[1] * 1e9 / machine.instructions,
+	   (best[0] - best[1]) * 1e9 / machine.instructions, (best[0] - best[1]) * 100 / best[0]);
+  else printf(", no threaded dispatch in this build\n");
+  return IO_SUCCESS;
+}
+
+/* Run a program reps times on the stack machine and on the register
+ * machine, both compiled from the same checked AST and both with the
+ * best dispatch of the build, and keep the best time of each.
+ */
+int benchMachines(char *fileName, int reps) {
+  CodeBlock code = { NULL, 0, 0 };
+  RegCode regCode = { NULL, 0, 0 };
+  CompilerContext ctx;
+  Machine machine;
+  VMStatus status = VM_HALTED;
+  double best[2], start, elapsed;
+  long long instructions[2];
+  FILE *devnull = fopen("/dev/null", "w+");
+  int result, i, j;
+
+  if (devnull == NULL) return IO_ERROR;
+  initContext(&ctx, devnull);
+  ctx.code = &code;
+  ctx.regCode = &regCode;
+  result = compile(&ctx, fileName);
+  freeContext(&ctx);
+  if (result != IO_SUCCESS) {
+    fclose(devnull);
+    cleanCode(&code);
+    cleanRegCode(&regCode);
+    return IO_ERROR;
+  }
+
+  for (j = 0; j < 2; j++) {
+    best[j] = 0;
+    initMachine(&machine, devnull, devnull);
+    for (i = 0; i < reps && status == VM_HALTED; i++) {
+      rewind(devnull);
+      start = now();
+      status = j == 0 ? runMachine(&machine, &code) : runRegisterMachine(&machine, &regCode);
+      elapsed = now() - start;
+      if (i == 0 || elapsed < best[j]) best[j] = elapsed;
+    }
+    instructions[j] = machine.instructions;
+  }
+  fclose(devnull);
+
+  if (status != VM_HALTED)
+    printf("machines %s: %s\n", fileName, vmStatusMessage(status));
+  else {
+    printf("machines %s:\n", fileName);
+    printf("  stack:    %11lld instructions %8.1f ms, code %7d bytes\n",
+	   instructions[0], best[0] * 1e3, code.size);
+    printf("  register: %11lld instructions %8.1f ms, code %7lu bytes\n",
+	   instructions[1], best[1] * 1e3, (unsigned long) (regCode.size * sizeof(RegInstruction)));
+    printf("  register/stack: %.2f of the instructions in %.2f of the time\n",
+	   (double) instructions[1] / instructions[0], best[1] / best[0]);
+  }
+  cleanCode(&code);
+  cleanRegCode(&regCode);
+  return IO_SUCCESS;
+}
+
+/* Run a command with stdin and stdout on /dev/null and wait for it */
+static int runCommand(char *const command[]) {
+  int devnull, status;
+  pid_t pid;
+
+  devnull = open("/dev/null", O_RDWR);
+  if (devnull < 0) return -1;
+  pid = fork();
+  if (pid == 0) {
+    dup2(devnull, 0);
+    dup2(devnull, 1);
+    execvp(command[0], command);
+    _exit(127);
+  }
+  close(devnull);
+  if (pid < 0 || waitpid(pid, &status, 0) < 0 || !WIFEXITED(status)) return -1;
+  return WEXITSTATUS(status);
+}
+
+/* Compile a program to x86-64 assembly, link it with the runtime kplrt.o
+ * in the working directory and run it reps times against the two
+ * machines, keeping the best time of each. The native times include
+ * starting the process.
+ */
+int benchNative(char *fileName, int reps) {
+  char *link[] = { "cc", "bench_native.s", "kplrt.o", "-o", "bench_native", NULL };
+  char *run[] = { "./bench_native", NULL };
+  CodeBlock code = { NULL, 0, 0 };
+  RegCode regCode = { NULL, 0, 0 };
+  CompilerContext ctx;
+  Machine machine;
+  VMStatus status = VM_HALTED;
+  double best[3], start, elapsed;
+  FILE *devnull = fopen("/dev/null", "w+");
+  int result, exitCode = 0, i, j;
+
+  if (devnull == NULL) return IO_ERROR;
+  initContext(&ctx, devnull);
+  ctx.code = &code;
+  ctx.regCode = &regCode;
+  ctx.assembly = fopen("bench_native.s", "w");
+  if (ctx.assembly == NULL) {
+    fclose(devnull);
+    return IO_ERROR;
+  }
+  result = compile(&ctx, fileName);
+  fclose(ctx.assembly);
+  freeContext(&ctx);
+  if (result != IO_SUCCESS || runCommand(link) != 0) {
+    fclose(devnull);
+    cleanCode(&code);
+    cleanRegCode(&regCode);
+    return IO_ERROR;
+  }
+
+  for (j = 0; j < 3; j++) {
+    best[j] = 0;
+    initMachine(&machine, devnull, devnull);
+    for (i = 0; i < reps && status == VM_HALTED && exitCode == 0; i++) {
+      rewind(devnull);
+      start = now();
+      if (j == 0) status = runMachine(&machine, &code);
+      else if (j == 1) status = runRegisterMachine(&machine, &regCode);
+      else exitCode = runCommand(run);
+      elapsed = now() - start;
+      if (i == 0 || elapsed < best[j]) best[j] = elapsed;
+    }
+  }
+  fclose(devnull);
+  cleanCode(&code);
+  cleanRegCode(&regCode);
+
+  if (status != VM_HALTED)
+    printf("native %s: %s\n", fileName, vmStatusMessage(status));
+  else if (exitCode != 0)
+    printf("native %s: the native program failed\n", fileName);
+  else {
+    printf("native %s:\n", fileName);
+    printf("  stack:    %8.1f ms\n", best[0] * 1e3);
+    printf("  register: %8.1f ms\n", best[1] * 1e3);
+    printf("  native:   %8.1f ms, %.1fx the stack machine, %.1fx the register machine\n",
+	   best[2] * 1e3, best[0] / best[2], best[1] / best[2]);
+  }
+  return IO_SUCCESS;
+}
+
+/******************************************************************/
+
+void usage(void) {
+  printf("usage: kplbench gen <units> [plain|comments|idents|trivia|decls|deep]\n");
+  printf("       kplbench corpus <directory> <files>\n");
+  printf("       kplbench stress <file>\n");
+  printf("       kplbench lex [-stream] [-simd scalar|sse2|avx2] [-n reps] <file>\n");
+  printf("       kplbench parse [-n reps] <file>\n");
+  printf("       kplbench lib [-n reps] <file>\n");
+  printf("       kplbench startup [-n reps] <compiler> <file>\n");
+  printf("       kplbench latency [-n reps] <socket> <compiler> <file>\n");
+  printf("       kplbench vm [-n reps] <file>\n");
+  printf("       kplbench machines [-n reps] <file>\n");
+  printf("       kplbench native [-n reps] <file>\n");
+  printf("       kplbench kw [iterations]\n");
+}
+
+int main(int argc, char *argv[]) {
+  int mode = INPUT_MODE_MMAP;
+  SimdLevel simd = SIMD_BEST;
+  int reps = 10;
+  int i;
+
+  if (argc >= 2 && strcmp(argv[1], "kw") == 0) {
+    benchKeywords(argc >= 3 ? atol(argv[2]) : 50000000);
+    return 0;
+  }
+
+  if (argc < 3) {
+    usage();
+    return -1;
+  }
+
+  if (strcmp(argv[1], "gen") == 0) {
+    if (argc > 3 && strcmp(argv[3], "comments") == 0) genCommentHeavy(stdout, atoi(argv[2]));
+    else if (argc > 3 && strcmp(argv[3], "idents") == 0) genIdentHeavy(stdout, atoi(argv[2]));
+    else if (argc > 3 && strcmp(argv[3], "trivia") == 0) genTrivia(stdout, atoi(argv[2]));
+    else if (argc > 3 && strcmp(argv[3], "decls") == 0) genDeclHeavy(stdout, atoi(argv[2]));
+    else if (argc > 3 && strcmp(argv[3], "deep") == 0) genDeepNesting(stdout, atoi(argv[2]));
+    else genProgram(stdout, atoi(argv[2]));
+    return 0;
+  }
+
+  if (strcmp(argv[1], "corpus") == 0 && argc > 3) {
+    if (genCorpus(argv[2], atoi(argv[3])) == IO_ERROR) {
+      printf("Can\'t write to %s!\n", argv[2]);
+      return -1;
+    }
+    return 0;
+  }
+
+  if (strcmp(argv[1], "stress") == 0) {
+    if (benchStress(argv[2]) == IO_ERROR) {
+      printf("Can\'t read input file!\n");
+      return -1;
+    }
+    return 0;
+  }
+
+  if (strcmp(argv[1], "startup") == 0 && argc > 3) {
+    reps = 1000;
+    if (argc > 5 && strcmp(argv[2], "-n") == 0) reps = atoi(argv[3]);
+    if (benchStartup(argv[argc - 2], argv[argc - 1], reps) == IO_ERROR) {
+      printf("Can\'t run %s on %s!\n", argv[argc - 2], argv[argc - 1]);
+      return -1;
+    }
+    return 0;
+  }
+
+  if (strcmp(argv[1], "latency") == 0 && argc > 4) {
+    reps = 2000;
+    if (argc > 6 && strcmp(argv[2], "-n") == 0) reps = atoi(argv[3]);
+    if (benchLatency(argv[argc - 3], argv[argc - 2], argv[argc - 1], reps) == IO_ERROR) {
+      printf("Can\'t compile %s through %s or %s!\n", argv[argc - 1], argv[argc - 3], argv[argc - 2]);
+      return -1;
+    }
+    return 0;
+  }
+
+  if (strcmp(argv[1], "lib") == 0) {
+    if (argc > 4 && strcmp(argv[2], "-n") == 0) reps = atoi(argv[3]);
+    if (benchLibrary(argv[argc - 1], reps) == IO_ERROR) {
+      printf("Can\'t read input file!\n");
+      return -1;
+    }
+    return 0;
+  }
+
+  if (strcmp(argv[1], "parse") == 0) {
+    if (argc > 4 && strcmp(argv[2], "-n") == 0) reps = atoi(argv[3]);
+    if (benchParse(argv[argc - 1], reps) == IO_ERROR) {
+      printf("Can\'t read input file!\n");
+      return -1;
+    }
+    return 0;
+  }
+
+  if (strcmp(argv[1], "vm") == 0) {
+    reps = 3;
+    if (argc > 4 && strcmp(argv[2], "-n") == 0) reps = atoi(argv[3]);
+    if (benchMachine(argv[argc - 1], reps) == IO_ERROR) {
+      printf("Can\'t compile input file!\n");
+      return -1;
+    }
+    return 0;
+  }
+
+  if (strcmp(argv[1], "machines") == 0) {
+    reps = 3;
+    if (argc > 4 && strcmp(argv[2], "-n") == 0) reps = atoi(argv[3]);
+    if (benchMachines(argv[argc - 1], reps) == IO_ERROR) {
+      printf("Can\'t compile input file!\n");
+      return -1;
+    }
+    return 0;
+  }
+
+  if (strcmp(argv[1], "native") == 0) {
+    reps = 3;
+    if (argc > 4 && strcmp(argv[2], "-n") == 0) reps = atoi(argv[3]);
+    if (benchNative(argv[argc - 1], reps) == IO_ERROR) {
+      printf("Can\'t compile input file!\n");
+      return -1;
+    }
+    return 0;
+  }
+
+  if (strcmp(argv[1], "lex") == 0) {
+    for (i = 2; i < argc - 1; i++) {
+      if (strcmp(argv[i], "-stream") == 0) mode = INPUT_MODE_STREAM;
+      else if (strcmp(argv[i], "-simd") == 0 && i + 1 < argc - 1) {
+	i ++;
+	if (strcmp(argv[i], "scalar") == 0) simd = SIMD_SCALAR;
+	else if (strcmp(argv[i], "sse2") == 0) simd = SIMD_SSE2;
+	else simd = SIMD_AVX2;
+      }
+      else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc - 1) reps = atoi(argv[++i]);
+    }
+    if (benchLex(argv[argc - 1], mode, reps, simd) == IO_ERROR) {
+      printf("Can\'t read input file!\n");
+      return -1;
+    }
+    return 0;
+  }
+
+  usage();
+  return -1;
+}
@@ -0,0 +1,401 @@
+/* Compile result cache
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "alloc.h"
+#include "reader.h"
+#include "scanner.h"
+#include "parser.h"
+#include "error.h"
+#include "cache.h"
+
+#define CACHE_MAGIC 0x43504c4b
+#define CACHE_VERSION 1
+
+/* The index is a set-associative table: a key can only live in the
+ * ways of one set, so a lookup reads a single cache line and there is
+ * nothing to rehash or tombstone when entries are evicted.
+ */
+#define CACHE_SETS 4096
+#define CACHE_WAYS 4
+#define CACHE_SLOTS (CACHE_SETS * CACHE_WAYS)
+
+typedef struct {
+  uint64_t key;
+  uint32_t tokens;
+  uint32_t size;
+  uint64_t stamp;
+} CacheSlot;
+
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t clock;
+  uint64_t bytes;
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t evictions;
+  CacheSlot slots[CACHE_SLOTS];
+} CacheIndex;
+
+/* An entry file: this header, then the object tree of a successful
+ * compilation. The position of a diagnostic is the index of a token
+ * and an offset into it.
+ */
+typedef struct {
+  int32_t result;
+  int32_t missing;
+  int32_t code;
+  int32_t tokenIndex;
+  int32_t delta;
+  uint32_t size;
+} CacheRecord;
+
+struct Cache_ {
+  char *dirName;
+  long limit;
+  int fd;
+  CacheIndex *index;
+  pthread_mutex_t lock;
+  long hits;
+  long misses;
+  long uncached;
+  long evictions;
+};
+
+Cache *openCache(char *dirName, long limit) {
+  Cache *cache;
+  char *path;
+  int fd;
+  void *addr;
+
+  mkdir(dirName, 0755);
+  path = (char*) memAlloc(strlen(dirName) + 8);
+  sprintf(path, "%s/index", dirName);
+  fd = open(path, O_RDWR | O_CREAT, 0644);
+  memFree(path);
+  if (fd < 0) return NULL;
+
+  flock(fd, LOCK_EX);
+  if (ftruncate(fd, sizeof(CacheIndex)) != 0) {
+    close(fd);
+    return NULL;
+  }
+  addr = mmap(NULL, sizeof(CacheIndex), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (addr == MAP_FAILED) {
+    close(fd);
+    return NULL;
+  }
+
+  cache = (Cache*) memAlloc(sizeof(Cache));
+  memset(cache, 0, sizeof(Cache));
+  cache->dirName = (char*) memAlloc(strlen(dirName) + 1);
+  strcpy(cache->dirName, dirName);
+  cache->limit = limit;
+  cache->fd = fd;
+  cache->index = (CacheIndex*) addr;
+  pthread_mutex_init(&cache->lock, NULL);
+
+  /* a new file reads as zeros; an index of another version is dropped */
+  if (cache->index->magic != CACHE_MAGIC || cache->index->version != CACHE_VERSION) {
+    memset(cache->index, 0, sizeof(CacheIndex));
+    cache->index->magic = CACHE_MAGIC;
+    cache->index->version = CACHE_VERSION;
+  }
+  flock(fd, LOCK_UN);
+  return cache;
+}
+
+void closeCache(Cache *cache) {
+  munmap(cache->index, sizeof(CacheIndex));
+  close(cache->fd);
+  pthread_mutex_destroy(&cache->lock);
+  memFree(cache->dirName);
+  memFree(cache);
+}
+
+void printCacheStats(Cache *cache, FILE *f) {
+  fprintf(f, "cache: %ld hits, %ld misses, %ld not cacheable, %ld evictions; %.1f of %.1f MB used\n",
+	  cache->hits, cache->misses, cache->uncached, cache->evictions,
+	  cache->index->bytes / 1e6, cache->limit / 1e6);
+}
+
+/******************************************************************/
+
+/* Threads of a process share the mutex; processes lock the index file */
+static void lockIndex(Cache *cache) {
+  pthread_mutex_lock(&cache->lock);
+  flock(cache->fd, LOCK_EX);
+}
+
+static void unlockIndex(Cache *cache) {
+  flock(cache->fd, LOCK_UN);
+  pthread_mutex_unlock(&cache->lock);
+}
+
+static void entryPath(Cache *cache, uint64_t key, char *path, size_t size) {
+  snprintf(path, size, "%s/%016llx", cache->dirName, (unsigned long long) key);
+}
+
+/* Called with the index locked */
+static void evictSlot(Cache *cache, CacheSlot *slot) {
+  char path[1024];
+
+  entryPath(cache, slot->key, path, sizeof(path));
+  unlink(path);
+  cache->index->bytes -= slot->size;
+  cache->index->evictions ++;
+  cache->evictions ++;
+  memset(slot, 0, sizeof(CacheSlot));
+}
+
+static CacheSlot *findSlot(Cache *cache, uint64_t key) {
+  CacheSlot *set = &(cache->index->slots[(key % CACHE_SETS) * CACHE_WAYS]);
+  int way;
+
+  for (way = 0; way < CACHE_WAYS; way++)
+    if (set[way].key == key)
+      return &set[way];
+  return NULL;
+}
+
+/* An entry file may be truncated or foreign: its record must describe
+ * the file and a diagnostic must fall on a token of the input, or the
+ * entry is missed.
+ */
+static int validRecord(CacheRecord *record, int tokens) {
+  if (record->result == IO_SUCCESS) return 1;
+  return record->result == COMPILE_ERROR && record->size == 0 && record->delta == 0
+    && record->tokenIndex >= 0 && record->tokenIndex < tokens;
+}
+
+static int readEntry(Cache *cache, uint64_t key, int tokens, CacheRecord *record, char **text) {
+  char path[1024];
+  struct stat st;
+  FILE *f;
+
+  entryPath(cache, key, path, sizeof(path));
+  f = fopen(path, "rb");
+  if (f == NULL) return 0;
+  if (fstat(fileno(f), &st) != 0 || fread(record, sizeof(CacheRecord), 1, f) != 1
+      || record->size > st.st_size - sizeof(CacheRecord) || !validRecord(record, tokens)) {
+    fclose(f);
+    return 0;
+  }
+  *text = (char*) memAlloc(record->size + 1);
+  if (fread(*text, 1, record->size, f) != record->size) {
+    memFree(*text);
+    fclose(f);
+    return 0;
+  }
+  fclose(f);
+  return 1;
+}
+
+static int lookupEntry(Cache *cache, uint64_t key, int tokens, CacheRecord *record, char **text) {
+  CacheSlot *slot;
+  int found = 0;
+
+  lockIndex(cache);
+  slot = findSlot(cache, key);
+  if (slot != NULL && slot->tokens == (uint32_t) tokens && readEntry(cache, key, tokens, record, text)) {
+    slot->stamp = ++ cache->index->clock;
+    cache->index->hits ++;
+    cache->hits ++;
+    found = 1;
+  } else {
+    cache->index->misses ++;
+    cache->misses ++;
+  }
+  unlockIndex(cache);
+  return found;
+}
+
+/* The entry file is written aside and renamed into place, so a reader
+ * in another process never sees half of it.
+ */
+static void storeEntry(Cache *cache, uint64_t key, int tokens, CacheRecord *record, const char *text) {
+  char path[1024], temp[1024 + 64];
+  CacheSlot *set, *slot, *victim;
+  uint32_t size = sizeof(CacheRecord) + record->size;
+  FILE *f;
+  int i;
+
+  if (size > cache->limit) return;
+
+  entryPath(cache, key, path, sizeof(path));
+  snprintf(temp, sizeof(temp), "%s.%d.%lx", path, (int) getpid(), (unsigned long) pthread_self());
+  f = fopen(temp, "wb");
+  if (f == NULL) return;
+  if (fwrite(record, sizeof(CacheRecord), 1, f) != 1
+      || fwrite(text, 1, record->size, f) != record->size) {
+    fclose(f);
+    unlink(temp);
+    return;
+  }
+  fclose(f);
+
+  lockIndex(cache);
+  rename(temp, path);
+
+  slot = findSlot(cache, key);
+  if (slot == NULL) {
+    set = &(cache->index->slots[(key % CACHE_SETS) * CACHE_WAYS]);
+    slot = &set[0];
+    for (i = 0; i < CACHE_WAYS; i++) {
+      if (set[i].key == 0) { slot = &set[i]; break; }
+      if (set[i].stamp < slot->stamp) slot = &set[i];
+    }
+    if (slot->key != 0) evictSlot(cache, slot);
+  } else cache->index->bytes -= slot->size;
+
+  slot->key = key;
+  slot->tokens = tokens;
+  slot->size = size;
+  slot->stamp = ++ cache->index->clock;
+  cache->index->bytes += size;
+
+  /* over the limit, evict the least recently used entries anywhere */
+  while (cache->index->bytes > (uint64_t) cache->limit) {
+    victim = NULL;
+    for (i = 0; i < CACHE_SLOTS; i++)
+      if (cache->index->slots[i].key != 0 && &(cache->index->slots[i]) != slot
+	  && (victim == NULL || cache->index->slots[i].stamp < victim->stamp))
+	victim = &(cache->index->slots[i]);
+    if (victim == NULL) break;
+    evictSlot(cache, victim);
+  }
+  unlockIndex(cache);
+}
+
+/******************************************************************/
+
+#define HASH_BYTE(h, c) (((h) ^ (unsigned char) (c)) * 1099511628211ull)
+
+static uint64_t hashBytes(uint64_t h, const char *text, int length) {
+  int i;
+
+  for (i = 0; i < length; i++)
+    h = HASH_BYTE(h, text[i]);
+  return HASH_BYTE(h, 0);
+}
+
+/* Scan the whole input, hashing each token by its kind and spelling and
+ * recording where it starts. Returns 0 on a lexical error, which the
+ * parser reports in its own time.
+ */
+static int hashTokens(CompilerContext *ctx, uint64_t *key) {
+  volatile uint64_t h = 14695981039346656037ull;
+  Token token;
+  const char *name;
+
+  ctx->tokenCount = 0;
+  if (setjmp(ctx->errorJump) != 0)
+    return 0;
+
+  do {
+    getValidToken(ctx, &token);
+    if (ctx->tokenCount == ctx->tokenCapacity) {
+      ctx->tokenCapacity = ctx->tokenCapacity == 0 ? 1024 : ctx->tokenCapacity * 2;
+      ctx->tokenPos = (int*) memRealloc(ctx->tokenPos, ctx->tokenCapacity * sizeof(int));
+    }
+    ctx->tokenPos[ctx->tokenCount++] = token.pos;
+
+    h = HASH_BYTE(h, token.tokenType);
+    switch (token.tokenType) {
+    case TK_IDENT:
+      name = atomName(&ctx->atoms, token.value);
+      h = hashBytes(h, name, strlen(name));
+      break;
+    case TK_NUMBER:
+      h = hashBytes(h, ctx->inputBuffer + token.pos, token.length);
+      break;
+    case TK_CHAR:
+      h = HASH_BYTE(h, token.value);
+      break;
+    default:
+      break;
+    }
+  } while (token.tokenType != TK_EOF);
+
+  *key = h != 0 ? h : 1;
+  return 1;
+}
+
+/* The index of the token starting at or before pos */
+static int tokenIndexOf(CompilerContext *ctx, int pos) {
+  int lo = 0, hi = ctx->tokenCount - 1, mid;
+
+  while (lo < hi) {
+    mid = (lo + hi + 1) / 2;
+    if (ctx->tokenPos[mid] <= pos) lo = mid;
+    else hi = mid - 1;
+  }
+  return lo;
+}
+
+int compileCached(CompilerContext *ctx) {
+  Cache *cache = ctx->cache;
+  CacheRecord record;
+  uint64_t key;
+  char *text, *output = NULL;
+  size_t outputSize = 0;
+  FILE *out = ctx->out;
+  int result;
+
+  if (!hashTokens(ctx, &key)) {
+    ctx->inputPtr = ctx->inputBuffer;
+    /* the counters of the process are kept under its mutex */
+    pthread_mutex_lock(&cache->lock);
+    cache->uncached ++;
+    pthread_mutex_unlock(&cache->lock);
+    return compileInput(ctx);
+  }
+  ctx->inputPtr = ctx->inputBuffer;
+
+  if (lookupEntry(cache, key, ctx->tokenCount, &record, &text)) {
+    if (record.result == COMPILE_ERROR) {
+      ctx->diagnostic.missing = record.missing;
+      ctx->diagnostic.code = record.code;
+      ctx->diagnostic.pos = ctx->tokenPos[record.tokenIndex] + record.delta;
+      printDiagnostic(ctx);
+    } else fwrite(text, 1, record.size, out);
+    memFree(text);
+    return record.result;
+  }
+
+  ctx->out = open_memstream(&output, &outputSize);
+  result = compileInput(ctx);
+  fclose(ctx->out);
+  ctx->out = out;
+  fwrite(output, 1, outputSize, out);
+
+  /* a diagnostic that is not inside a token cannot be mapped back */
+  memset(&record, 0, sizeof(record));
+  record.result = result;
+  if (result == COMPILE_ERROR) {
+    record.missing = ctx->diagnostic.missing;
+    record.code = ctx->diagnostic.code;
+    record.tokenIndex = tokenIndexOf(ctx, ctx->diagnostic.pos);
+    record.delta = ctx->diagnostic.pos - ctx->tokenPos[record.tokenIndex];
+    if (record.delta == 0)
+      storeEntry(cache, key, ctx->tokenCount, &record, "");
+  } else {
+    record.size = outputSize;
+    storeEntry(cache, key, ctx->tokenCount, &record, output);
+  }
+  free(output);
+  return result;
+}
@@ -0,0 +1,31 @@
+/* Compile result cache
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#ifndef __CACHE_H__
+#define __CACHE_H__
+
+#include <stdio.h>
+#include "context.h"
+
+/* Results are keyed on a hash of the token stream, so inputs that only
+ * differ in blanks, comments or the case of identifiers share an entry.
+ * A diagnostic is kept as a token index and mapped back to the line and
+ * column of the input at hand.
+ */
+typedef struct Cache_ Cache;
+
+/* The cache lives in a directory: an index file mapped by every user
+ * and one file per entry. limit bounds the bytes of the entries; the
+ * least recently used go first.
+ */
+Cache *openCache(char *dirName, long limit);
+void closeCache(Cache *cache);
+void printCacheStats(Cache *cache, FILE *f);
+
+/* Compile the open input of ctx through ctx->cache */
+int compileCached(CompilerContext *ctx);
+
+#endif
@@ -0,0 +1,358 @@
+/* Code generation
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#include <stdlib.h>
+#include "codegen.h"
+
+/* The generator walks the tree with ctx->symtab->currentScope set to
+ * the block whose code it emits; a name is reached through as many
+ * static links as there are blocks between the two scopes.
+ */
+#define node(ref) astAt(&ctx->ast, (ref))
+
+static void genExpression(CompilerContext *ctx, AstRef expr);
+static void genStatements(CompilerContext *ctx, AstRef statement);
+
+int sizeOfType(Type* type) {
+  if (type->typeClass == TP_ARRAY)
+    return type->arraySize * sizeOfType(type->elementType);
+  return 1;
+}
+
+static int scopeDepth(Scope* scope) {
+  int depth = 0;
+
+  for (; scope->outer != NULL; scope = scope->outer)
+    depth ++;
+  return depth;
+}
+
+int levelOf(CompilerContext *ctx, Scope* scope) {
+  return scopeDepth(ctx->symtab->currentScope) - scopeDepth(scope);
+}
+
+Scope* ownerScope(Object* owner) {
+  switch (owner->kind) {
+  case OBJ_FUNCTION:
+    return owner->funcAttrs.scope;
+  case OBJ_PROCEDURE:
+    return owner->procAttrs.scope;
+  default:
+    return owner->progAttrs.scope;
+  }
+}
+
+/* Parameters take a word each, in order, after the reserved words; the
+ * variables follow.
+ */
+void layoutScope(Scope* scope) {
+  int offset = RESERVED_WORDS;
+  Object* obj;
+  int i;
+
+  for (i = 0; i < scope->objectCount; i++) {
+    obj = scope->objects[i];
+    if (obj->kind == OBJ_PARAMETER) {
+      obj->paramAttrs.localOffset = offset;
+      offset ++;
+    } else if (obj->kind == OBJ_VARIABLE) {
+      obj->varAttrs.localOffset = offset;
+      offset += sizeOfType(obj->varAttrs.type);
+    }
+  }
+  scope->frameSize = offset;
+}
+
+Scope* slotOf(Object* obj, int *offset) {
+  switch (obj->kind) {
+  case OBJ_VARIABLE:
+    *offset = obj->varAttrs.localOffset;
+    return obj->varAttrs.scope;
+  case OBJ_PARAMETER:
+    *offset = obj->paramAttrs.localOffset;
+    return ownerScope(obj->paramAttrs.function);
+  default:
+    *offset = FRAME_RV;
+    return obj->funcAttrs.scope;
+  }
+}
+
+int isReferenceParameter(Object* obj) {
+  return obj->kind == OBJ_PARAMETER && obj->paramAttrs.kind == PARAM_REFERENCE;
+}
+
+int isBuiltin(Object* obj, Atom name) {
+  return obj->name == name && ownerScope(obj) == NULL;
+}
+
+/* Push the address of a variable, a parameter or the result of the
+ * running function
+ */
+static void genVariableAddress(CompilerContext *ctx, Object* obj) {
+  Scope* scope;
+
+  switch (obj->kind) {
+  case OBJ_VARIABLE:
+    emitOp2(ctx->code, OP_LA, levelOf(ctx, obj->varAttrs.scope), obj->varAttrs.localOffset);
+    break;
+  case OBJ_PARAMETER:
+    scope = ownerScope(obj->paramAttrs.function);
+    /* a reference parameter holds the address of its argument */
+    if (obj->paramAttrs.kind == PARAM_REFERENCE)
+      emitOp2(ctx->code, OP_LV, levelOf(ctx, scope), obj->paramAttrs.localOffset);
+    else emitOp2(ctx->code, OP_LA, levelOf(ctx, scope), obj->paramAttrs.localOffset);
+    break;
+  default:
+    emitOp2(ctx->code, OP_LA, levelOf(ctx, obj->funcAttrs.scope), FRAME_RV);
+    break;
+  }
+}
+
+/* Push the address of an lvalue and return its type */
+static Type* genLValue(CompilerContext *ctx, AstRef lvalue) {
+  AstNode *n = node(lvalue);
+  Object* obj;
+  Type* type;
+
+  if (n->kind == AST_INDEX) {
+    /* the indexes of an array of n elements run from 1 to n */
+    type = genLValue(ctx, n->child[0]);
+    genExpression(ctx, n->child[1]);
+    emitOp2(ctx->code, OP_IX, type->arraySize, sizeOfType(type->elementType));
+    return type->elementType;
+  }
+
+  obj = astObjectAt(&ctx->ast, n);
+  genVariableAddress(ctx, obj);
+  switch (obj->kind) {
+  case OBJ_VARIABLE:
+    return obj->varAttrs.type;
+  case OBJ_PARAMETER:
+    return obj->paramAttrs.type;
+  default:
+    return obj->funcAttrs.returnType;
+  }
+}
+
+/* The caller reserves the first words of the frame and pushes the
+ * arguments in place of the parameters; CALL then starts the frame
+ * there.
+ */
+static void genCall(CompilerContext *ctx, Scope* scope, int codeAddress, ObjectNode* paramList, AstRef arg) {
+  int count = 0;
+
+  emitOp1(ctx->code, OP_INT, RESERVED_WORDS);
+  for (; arg != NO_NODE; arg = node(arg)->next, paramList = paramList->next) {
+    if (paramList->object->paramAttrs.kind == PARAM_REFERENCE)
+      genLValue(ctx, arg);
+    else genExpression(ctx, arg);
+    count ++;
+  }
+  emitOp1(ctx->code, OP_DCT, RESERVED_WORDS + count);
+  emitOp2(ctx->code, OP_CALL, levelOf(ctx, scope->outer), codeAddress);
+}
+
+static void genExpression(CompilerContext *ctx, AstRef expr) {
+  AstNode *n = node(expr);
+  Object* obj;
+
+  switch (n->kind) {
+  case AST_NUMBER:
+  case AST_CHAR:
+    emitOp1(ctx->code, OP_LC, n->value);
+    break;
+  case AST_VARIABLE:
+    obj = astObjectAt(&ctx->ast, n);
+    if (obj->kind == OBJ_VARIABLE)
+      emitOp2(ctx->code, OP_LV, levelOf(ctx, obj->varAttrs.scope), obj->varAttrs.localOffset);
+    else {
+      genVariableAddress(ctx, obj);
+      emitOp(ctx->code, OP_LI);
+    }
+    break;
+  case AST_INDEX:
+    genLValue(ctx, expr);
+    emitOp(ctx->code, OP_LI);
+    break;
+  case AST_FCALL:
+    obj = astObjectAt(&ctx->ast, n);
+    if (isBuiltin(obj, ATOM_READI))
+      emitOp(ctx->code, OP_RI);
+    else if (isBuiltin(obj, ATOM_READC))
+      emitOp(ctx->code, OP_RC);
+    else genCall(ctx, obj->funcAttrs.scope, obj->funcAttrs.codeAddress, obj->funcAttrs.paramList, n->child[0]);
+    break;
+  case AST_UNARY:
+    genExpression(ctx, n->child[0]);
+    if (n->op == SB_MINUS)
+      emitOp(ctx->code, OP_NEG);
+    break;
+  case AST_BINARY:
+    genExpression(ctx, n->child[0]);
+    genExpression(ctx, n->child[1]);
+    switch (n->op) {
+    case SB_PLUS:
+      emitOp(ctx->code, OP_AD);
+      break;
+    case SB_MINUS:
+      emitOp(ctx->code, OP_SB);
+      break;
+    case SB_TIMES:
+      emitOp(ctx->code, OP_ML);
+      break;
+    default:
+      emitOp(ctx->code, OP_DV);
+      break;
+    }
+    break;
+  default:
+    break;
+  }
+}
+
+static void genCondition(CompilerContext *ctx, AstRef condition) {
+  AstNode *n = node(condition);
+
+  genExpression(ctx, n->child[0]);
+  genExpression(ctx, n->child[1]);
+  switch (n->op) {
+  case SB_EQ:
+    emitOp(ctx->code, OP_EQ);
+    break;
+  case SB_NEQ:
+    emitOp(ctx->code, OP_NE);
+    break;
+  case SB_LE:
+    emitOp(ctx->code, OP_LE);
+    break;
+  case SB_LT:
+    emitOp(ctx->code, OP_LT);
+    break;
+  case SB_GE:
+    emitOp(ctx->code, OP_GE);
+    break;
+  default:
+    emitOp(ctx->code, OP_GT);
+    break;
+  }
+}
+
+static void genStatements(CompilerContext *ctx, AstRef statement) {
+  AstNode *n;
+  Object* obj;
+  int jump, loop;
+
+  for (; statement != NO_NODE; statement = n->next) {
+    n = node(statement);
+    switch (n->kind) {
+    case AST_ASSIGN:
+      genLValue(ctx, n->child[0]);
+      genExpression(ctx, n->child[1]);
+      emitOp(ctx->code, OP_ST);
+      break;
+    case AST_CALL:
+      obj = astObjectAt(&ctx->ast, n);
+      if (isBuiltin(obj, ATOM_WRITEI)) {
+        genExpression(ctx, n->child[0]);
+        emitOp(ctx->code, OP_WRI);
+      } else if (isBuiltin(obj, ATOM_WRITEC)) {
+        genExpression(ctx, n->child[0]);
+        emitOp(ctx->code, OP_WRC);
+      } else if (isBuiltin(obj, ATOM_WRITELN))
+        emitOp(ctx->code, OP_WLN);
+      else genCall(ctx, obj->procAttrs.scope, obj->procAttrs.codeAddress, obj->procAttrs.paramList, n->child[0]);
+      break;
+    case AST_GROUP:
+      genStatements(ctx, n->child[0]);
+      break;
+    case AST_IF:
+      genCondition(ctx, n->child[0]);
+      jump = emitOp1(ctx->code, OP_FJ, 0);
+      genStatements(ctx, n->child[1]);
+      if (n->child[2] != NO_NODE) {
+        loop = emitOp1(ctx->code, OP_J, 0);
+        patchOperand(ctx->code, jump, ctx->code->size);
+        genStatements(ctx, n->child[2]);
+        patchOperand(ctx->code, loop, ctx->code->size);
+      } else patchOperand(ctx->code, jump, ctx->code->size);
+      break;
+    case AST_WHILE:
+      loop = ctx->code->size;
+      genCondition(ctx, n->child[0]);
+      jump = emitOp1(ctx->code, OP_FJ, 0);
+      genStatements(ctx, n->child[1]);
+      emitOp1(ctx->code, OP_J, loop);
+      patchOperand(ctx->code, jump, ctx->code->size);
+      break;
+    case AST_FOR:
+      /* the address of the variable stays on the stack for the loop */
+      genVariableAddress(ctx, astObjectAt(&ctx->ast, n));
+      emitOp(ctx->code, OP_CV);
+      genExpression(ctx, n->child[0]);
+      emitOp(ctx->code, OP_ST);
+      loop = ctx->code->size;
+      emitOp(ctx->code, OP_CV);
+      emitOp(ctx->code, OP_LI);
+      genExpression(ctx, n->child[1]);
+      emitOp(ctx->code, OP_LE);
+      jump = emitOp1(ctx->code, OP_FJ, 0);
+      genStatements(ctx, n->child[2]);
+      emitOp(ctx->code, OP_CV);
+      emitOp(ctx->code, OP_CV);
+      emitOp(ctx->code, OP_LI);
+      emitOp1(ctx->code, OP_LC, 1);
+      emitOp(ctx->code, OP_AD);
+      emitOp(ctx->code, OP_ST);
+      emitOp1(ctx->code, OP_J, loop);
+      patchOperand(ctx->code, jump, ctx->code->size);
+      emitOp1(ctx->code, OP_DCT, 1);
+      break;
+    }
+  }
+}
+
+/* A block starts with a jump over the code of its subroutines to its
+ * body, so its entry is known before they are generated.
+ */
+static void genBlock(CompilerContext *ctx, Object* owner) {
+  Scope* scope = ownerScope(owner);
+  Scope* outer = ctx->symtab->currentScope;
+  int entry, i;
+
+  layoutScope(scope);
+  entry = emitOp1(ctx->code, OP_J, 0);
+  if (owner->kind == OBJ_FUNCTION) owner->funcAttrs.codeAddress = entry;
+  else if (owner->kind == OBJ_PROCEDURE) owner->procAttrs.codeAddress = entry;
+
+  for (i = 0; i < scope->objectCount; i++)
+    if (scope->objects[i]->kind == OBJ_FUNCTION || scope->objects[i]->kind == OBJ_PROCEDURE)
+      genBlock(ctx, scope->objects[i]);
+
+  patchOperand(ctx->code, entry, ctx->code->size);
+  ctx->symtab->currentScope = scope;
+  emitOp1(ctx->code, OP_INT, scope->frameSize);
+
+  switch (owner->kind) {
+  case OBJ_FUNCTION:
+    genStatements(ctx, owner->funcAttrs.body);
+    emitOp(ctx->code, OP_EF);
+    break;
+  case OBJ_PROCEDURE:
+    genStatements(ctx, owner->procAttrs.body);
+    emitOp(ctx->code, OP_EP);
+    break;
+  default:
+    genStatements(ctx, owner->progAttrs.body);
+    emitOp(ctx->code, OP_HL);
+    break;
+  }
+  ctx->symtab->currentScope = outer;
+}
+
+void genCode(CompilerContext *ctx, Object* program) {
+  ctx->code->size = 0;
+  genBlock(ctx, program);
+}
@@ -0,0 +1,32 @@
+/* Code generation
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#ifndef __CODEGEN_H__
+#define __CODEGEN_H__
+
+#include "symtab.h"
+#include "instructions.h"
+
+int sizeOfType(Type* type);
+
+/* Shared with the register code generator */
+Scope* ownerScope(Object* owner);
+/* The number of static links from the current scope out to scope */
+int levelOf(CompilerContext *ctx, Scope* scope);
+void layoutScope(Scope* scope);
+/* The scope and the frame offset of a variable, a parameter or the
+ * result of a function
+ */
+Scope* slotOf(Object* obj, int *offset);
+int isReferenceParameter(Object* obj);
+int isBuiltin(Object* obj, Atom name);
+
+/* Translate the checked AST of the program into stack machine code in
+ * ctx->code. The frames of the blocks are laid out first.
+ */
+void genCode(CompilerContext *ctx, Object* program);
+
+#endif
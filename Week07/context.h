@@ -0,0 +1,78 @@
+/* Compiler context
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#ifndef __CONTEXT_H__
+#define __CONTEXT_H__
+
+#include <stdio.h>
+#include <setjmp.h>
+#include "alloc.h"
+#include "atom.h"
+#include "token.h"
+#include "ast.h"
+
+struct SymTab_;
+struct Cache_;
+struct CodeBlock_;
+struct RegCode_;
+
+/* What stopped a compilation: an ErrorCode, or the TokenType that was
+ * missing, at a byte offset of the input
+ */
+typedef struct {
+  int missing;
+  int code;
+  int pos;
+} Diagnostic;
+
+/* All the state of one compilation. Contexts share nothing, so a process
+ * can run compilations back to back or on several threads at once.
+ */
+typedef struct CompilerContext_ {
+  /* the input, see reader.c */
+  FILE *inputStream;
+  const char *inputBuffer;
+  const char *inputPtr;
+  const char *inputEnd;
+  size_t inputSize;
+  int inputMapped;
+  int *lineStarts;
+  int lineCount;
+
+  /* the parser's two live tokens */
+  Token tokenRing[2];
+  Token *currentToken;
+  Token *lookAhead;
+
+  /* identifiers, and the symbol table with the region it lives in */
+  AtomTable atoms;
+  struct SymTab_ *symtab;
+  Region region;
+
+  /* the statements of the program, built by the parser, and the stack
+   * and register code generated from them when code or regCode is not
+   * NULL; x86-64 assembly is written to assembly when it is not NULL
+   */
+  Ast ast;
+  struct CodeBlock_ *code;
+  struct RegCode_ *regCode;
+  FILE *assembly;
+
+  /* diagnostics and the object tree are written to out; error() returns
+   * to the compile() call through errorJump
+   */
+  FILE *out;
+  jmp_buf errorJump;
+  Diagnostic diagnostic;
+
+  /* the result cache, if any, and the token offsets of the input */
+  struct Cache_ *cache;
+  int *tokenPos;
+  int tokenCount;
+  int tokenCapacity;
+} CompilerContext;
+
+#endif
@@ -7,95 +7,100 @@
 #include <stdio.h>
 #include "debug.h"
 
-void pad(int n) {
+void pad(CompilerContext *ctx, int n) {
   int i;
-  for (i = 0; i < n ; i++) printf(" ");
+  for (i = 0; i < n ; i++) fprintf(ctx->out, " ");
 }
 
-void printType(Type* type) {
+void printType(CompilerContext *ctx, Type* type) {
   switch (type->typeClass) {
   case TP_INT:
-    printf("Int");
+    fprintf(ctx->out, "Int");
     break;
   case TP_CHAR:
-    printf("Char");
+    fprintf(ctx->out, "Char");
     break;
   case TP_ARRAY:
-    printf("Arr(%d,",type->arraySize);
-    printType(type->elementType);
-    printf(")");
+    fprintf(ctx->out, "Arr(%d,",type->arraySize);
+    printType(ctx, type->elementType);
+    fprintf(ctx->out, ")");
     break;
   }
 }
 
-void printConstantValue(ConstantValue* value) {
+void printConstantValue(CompilerContext *ctx, ConstantValue* value) {
   switch (value->type) {
   case TP_INT:
-    printf("%d",value->intValue);
+    fprintf(ctx->out, "%d",value->intValue);
     break;
   case TP_CHAR:
-    printf("\'%c\'",value->charValue);
+    fprintf(ctx->out, "\'%c\'",value->charValue);
     break;
   default:
     break;
   }
 }
 
-void printObject(Object* obj, int indent) {
+void printObject(CompilerContext *ctx, Object* obj, int indent) {
   switch (obj->kind) {
   case OBJ_CONSTANT:
-    pad(indent);
-    printf("Const %s = ", obj->name);
-    printConstantValue(obj->constAttrs->value);
+    pad(ctx, indent);
+    fprintf(ctx->out, "Const %s = ", atomName(&ctx->atoms, obj->name));
+    printConstantValue(ctx, &(obj->constAttrs.value));
     break;
   case OBJ_TYPE:
-    pad(indent);
-    printf("Type %s = ", obj->name);
-    printType(obj->typeAttrs->actualType);
+    pad(ctx, indent);
+    fprintf(ctx->out, "Type %s = ", atomName(&ctx->atoms, obj->name));
+    printType(ctx, obj->typeAttrs.actualType);
     break;
   case OBJ_VARIABLE:
-    pad(indent);
-    printf("Var %s : ", obj->name);
-    printType(obj->varAttrs->type);
+    pad(ctx, indent);
+    fprintf(ctx->out, "Var %s : ", atomName(&ctx->atoms, obj->name));
+    printType(ctx, obj->varAttrs.type);
     break;
   case OBJ_PARAMETER:
-    pad(indent);
-    if (obj->paramAttrs->kind == PARAM_VALUE) 
-      printf("Param %s : ", obj->name);
+    pad(ctx, indent);
+    if (obj->paramAttrs.kind == PARAM_VALUE) 
+      fprintf(ctx->out, "Param %s : ", atomName(&ctx->atoms, obj->name));
     else
-      printf("Param VAR %s : ", obj->name);
-    printType(obj->paramAttrs->type);
+      fprintf(ctx->out, "Param VAR %s : ", atomName(&ctx->atoms, obj->name));
+    printType(ctx, obj->paramAttrs.type);
     break;
   case OBJ_FUNCTION:
-    pad(indent);
-    printf("Function %s : ",obj->name);
-    printType(obj->funcAttrs->returnType);
-    printf("\n");
-    printScope(obj->funcAttrs->scope, indent + 4);
+    pad(ctx, indent);
+    fprintf(ctx->out, "Function %s : ",atomName(&ctx->atoms, obj->name));
+    printType(ctx, obj->funcAttrs.returnType);
+    fprintf(ctx->out, "\n");
+    printScope(ctx, obj->funcAttrs.scope, indent + 4);
     break;
   case OBJ_PROCEDURE:
-    pad(indent);
-    printf("Procedure %s\n",obj->name);
-    printScope(obj->procAttrs->scope, indent + 4);
+    pad(ctx, indent);
+    fprintf(ctx->out, "Procedure %s\n",atomName(&ctx->atoms, obj->name));
+    printScope(ctx, obj->procAttrs.scope, indent + 4);
     break;
   case OBJ_PROGRAM:
-    pad(indent);
-    printf("Program %s\n",obj->name);
-    printScope(obj->progAttrs->scope, indent + 4);
+    pad(ctx, indent);
+    fprintf(ctx->out, "Program %s\n",atomName(&ctx->atoms, obj->name));
+    printScope(ctx, obj->progAttrs.scope, indent + 4);
     break;
   }
 }
 
-void printObjectList(ObjectNode* objList, int indent) {
+void printObjectList(CompilerContext *ctx, ObjectNode* objList, int indent) {
   ObjectNode *node = objList;
   while (node != NULL) {
-    printObject(node->object, indent);
-    printf("\n");
+    printObject(ctx, node->object, indent);
+    fprintf(ctx->out, "\n");
     node = node->next;
   }
 }
 
-void printScope(Scope* scope, int indent) {
-  printObjectList(scope->objList, indent);
+void printScope(CompilerContext *ctx, Scope* scope, int indent) {
+  int i;
+
+  for (i = 0; i < scope->objectCount; i++) {
+    printObject(ctx, scope->objects[i], indent);
+    fprintf(ctx->out, "\n");
+  }
 }
 
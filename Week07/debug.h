@@ -9,10 +9,10 @@
 
 #include "symtab.h"
 
-void printType(Type* type);
-void printConstantValue(ConstantValue* value);
-void printObject(Object* obj, int indent);
-void printObjectList(ObjectNode* objList, int indent);
-void printScope(Scope* scope, int indent);
+void printType(CompilerContext *ctx, Type* type);
+void printConstantValue(CompilerContext *ctx, ConstantValue* value);
+void printObject(CompilerContext *ctx, Object* obj, int indent);
+void printObjectList(CompilerContext *ctx, ObjectNode* objList, int indent);
+void printScope(CompilerContext *ctx, Scope* scope, int indent);
 
 #endif
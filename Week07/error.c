@@ -6,18 +6,18 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include "reader.h"
 #include "error.h"
 
-#define NUM_OF_ERRORS 29
+#define NUM_OF_ERRORS 28
 
 struct ErrorMessage {
   ErrorCode errorCode;
   char *message;
 };
 
-struct ErrorMessage errors[29] = {
+struct ErrorMessage errors[28] = {
   {ERR_END_OF_COMMENT, "End of comment expected."},
-  {ERR_IDENT_TOO_LONG, "Identifier too long."},
   {ERR_INVALID_CONSTANT_CHAR, "Invalid char constant."},
   {ERR_INVALID_SYMBOL, "Invalid symbol."},
   {ERR_INVALID_IDENT, "An identifier expected."},
@@ -47,20 +47,48 @@ struct ErrorMessage errors[29] = {
   {ERR_PARAMETERS_ARGUMENTS_INCONSISTENCY, "The number of arguments and the number of parameters are inconsistent."}
 };
 
-void error(ErrorCode err, int lineNo, int colNo) {
+/* error() and missingToken() only record the diagnostic and unwind;
+ * compile() prints it. A cached compilation replays it without parsing.
+ */
+void error(CompilerContext *ctx, ErrorCode err, int pos) {
+  ctx->diagnostic.missing = 0;
+  ctx->diagnostic.code = err;
+  ctx->diagnostic.pos = pos;
+  longjmp(ctx->errorJump, 1);
+}
+
+void missingToken(CompilerContext *ctx, TokenType tokenType, int pos) {
+  ctx->diagnostic.missing = 1;
+  ctx->diagnostic.code = tokenType;
+  ctx->diagnostic.pos = pos;
+  longjmp(ctx->errorJump, 1);
+}
+
+/* The text of the diagnostic, without its position */
+void diagnosticMessage(CompilerContext *ctx, char *buffer, int size) {
   int i;
+
+  if (ctx->diagnostic.missing) {
+    snprintf(buffer, size, "Missing %s", tokenToString(ctx->diagnostic.code));
+    return;
+  }
+  buffer[0] = '\0';
   for (i = 0 ; i < NUM_OF_ERRORS; i ++) 
-    if (errors[i].errorCode == err) {
-      printf("%d-%d:%s\n", lineNo, colNo, errors[i].message);
-      exit(0);
+    if (errors[i].errorCode == ctx->diagnostic.code) {
+      snprintf(buffer, size, "%s", errors[i].message);
+      break;
     }
 }
 
-void missingToken(TokenType tokenType, int lineNo, int colNo) {
-  printf("%d-%d:Missing %s\n", lineNo, colNo, tokenToString(tokenType));
-  exit(0);
+void printDiagnostic(CompilerContext *ctx) {
+  char message[DIAGNOSTIC_SIZE];
+  int lineNo, colNo;
+
+  positionOf(ctx, ctx->diagnostic.pos, &lineNo, &colNo);
+  diagnosticMessage(ctx, message, sizeof(message));
+  fprintf(ctx->out, "%d-%d:%s\n", lineNo, colNo, message);
 }
 
-void assert(char *msg) {
-  printf("%s\n", msg);
+void assert(CompilerContext *ctx, char *msg) {
+  fprintf(ctx->out, "%s\n", msg);
 }
@@ -7,10 +7,10 @@
 #ifndef __ERROR_H__
 #define __ERROR_H__
 #include "token.h"
+#include "context.h"
 
 typedef enum {
   ERR_END_OF_COMMENT,
-  ERR_IDENT_TOO_LONG,
   ERR_INVALID_CONSTANT_CHAR,
   ERR_INVALID_SYMBOL,
   ERR_INVALID_IDENT,
@@ -40,8 +40,13 @@ typedef enum {
   ERR_PARAMETERS_ARGUMENTS_INCONSISTENCY
 } ErrorCode;
 
-void error(ErrorCode err, int lineNo, int colNo);
-void missingToken(TokenType tokenType, int lineNo, int colNo);
-void assert(char *msg);
+void error(CompilerContext *ctx, ErrorCode err, int pos) __attribute__((noreturn));
+void missingToken(CompilerContext *ctx, TokenType tokenType, int pos) __attribute__((noreturn));
+
+#define DIAGNOSTIC_SIZE 128
+
+void diagnosticMessage(CompilerContext *ctx, char *buffer, int size);
+void printDiagnostic(CompilerContext *ctx);
+void assert(CompilerContext *ctx, char *msg);
 
 #endif
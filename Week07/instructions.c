@@ -0,0 +1,163 @@
+/* Stack machine instructions
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "alloc.h"
+#include "reader.h"
+#include "instructions.h"
+
+const unsigned char opOperands[OP_COUNT] = {
+  [OP_LA] = 2, [OP_LV] = 2, [OP_LC] = 1, [OP_INT] = 1, [OP_DCT] = 1,
+  [OP_J] = 1, [OP_FJ] = 1, [OP_CALL] = 2, [OP_IX] = 2
+};
+
+static const char *const opNames[OP_COUNT] = {
+  "LA", "LV", "LC", "LI", "INT", "DCT", "J", "FJ", "HL", "ST", "CALL",
+  "EP", "EF", "RC", "RI", "WRC", "WRI", "WLN", "AD", "SB", "ML", "DV",
+  "NEG", "CV", "IX", "EQ", "NE", "GT", "LT", "GE", "LE"
+};
+
+static unsigned char *reserve(CodeBlock *block, int length) {
+  unsigned char *at;
+
+  if (block->size + length > block->capacity) {
+    if (block->capacity == 0) block->capacity = 1024;
+    while (block->size + length > block->capacity) block->capacity *= 2;
+    block->code = (unsigned char*) memRealloc(block->code, block->capacity);
+  }
+  at = block->code + block->size;
+  block->size += length;
+  return at;
+}
+
+int emitOp(CodeBlock *block, OpCode op) {
+  *reserve(block, 1) = op;
+  return block->size - 1;
+}
+
+int emitOp1(CodeBlock *block, OpCode op, int q) {
+  unsigned char *at = reserve(block, 5);
+
+  at[0] = op;
+  memcpy(at + 1, &q, sizeof(int));
+  return block->size - 5;
+}
+
+int emitOp2(CodeBlock *block, OpCode op, int p, int q) {
+  unsigned char *at = reserve(block, 9);
+
+  at[0] = op;
+  memcpy(at + 1, &p, sizeof(int));
+  memcpy(at + 5, &q, sizeof(int));
+  return block->size - 9;
+}
+
+void patchOperand(CodeBlock *block, int address, int q) {
+  OpCode op = block->code[address];
+  memcpy(block->code + address + 1 + 4 * (opOperands[op] - 1), &q, sizeof(int));
+}
+
+const char *opName(OpCode op) {
+  return op < OP_COUNT ? opNames[op] : "?";
+}
+
+int decodeLength(CodeBlock *block, int address) {
+  OpCode op;
+
+  if (address < 0 || address >= block->size) return 0;
+  op = block->code[address];
+  if (op >= OP_COUNT || address + opLength(op) > block->size) return 0;
+  return opLength(op);
+}
+
+void printCode(CodeBlock *block, FILE *out) {
+  unsigned char *code;
+  int address, length, i;
+
+  for (address = 0; address < block->size; address += length) {
+    length = decodeLength(block, address);
+    if (length == 0) break;
+    code = block->code + address;
+    fprintf(out, "%6d:  %s", address, opName(code[0]));
+    for (i = 0; i < opOperands[code[0]]; i++)
+      fprintf(out, " %d", codeOperand(code, i));
+    fprintf(out, "\n");
+  }
+}
+
+/* A loaded program may come from anywhere: every byte must belong to an
+ * instruction and every jump must land on one, so that the machine can
+ * trust the stream it runs. The last instruction does not fall through,
+ * so the machine never runs off the end.
+ */
+static int verifyCode(CodeBlock *block) {
+  char *starts = (char*) memAlloc(block->size + 1);
+  unsigned char *code;
+  int address, length, target, last = 0, valid = 1;
+
+  memset(starts, 0, block->size + 1);
+  for (address = 0; address < block->size; address += length) {
+    length = decodeLength(block, address);
+    if (length == 0) {
+      memFree(starts);
+      return 0;
+    }
+    starts[address] = 1;
+    last = block->code[address];
+  }
+
+  for (address = 0; valid && address < block->size; address += opLength(code[0])) {
+    code = block->code + address;
+    if (code[0] == OP_J || code[0] == OP_FJ || code[0] == OP_CALL) {
+      target = codeOperand(code, opOperands[code[0]] - 1);
+      valid = target >= 0 && target < block->size && starts[target];
+    }
+  }
+  memFree(starts);
+  return valid && (last == OP_HL || last == OP_J || last == OP_EP || last == OP_EF);
+}
+
+int saveCode(CodeBlock *block, char *fileName) {
+  FILE *f = fopen(fileName, "wb");
+  int ok;
+
+  if (f == NULL) return IO_ERROR;
+  ok = fwrite(KBC_MAGIC, 1, 4, f) == 4
+    && fwrite(&block->size, sizeof(int), 1, f) == 1
+    && fwrite(block->code, 1, block->size, f) == (size_t) block->size;
+  if (fclose(f) != 0) ok = 0;
+  return ok ? IO_SUCCESS : IO_ERROR;
+}
+
+int loadCode(CodeBlock *block, char *fileName) {
+  FILE *f = fopen(fileName, "rb");
+  char magic[4];
+  int size;
+
+  if (f == NULL) return IO_ERROR;
+  if (fread(magic, 1, 4, f) != 4 || memcmp(magic, KBC_MAGIC, 4) != 0
+      || fread(&size, sizeof(int), 1, f) != 1 || size <= 0 || size > KBC_MAX_SIZE) {
+    fclose(f);
+    return IO_ERROR;
+  }
+
+  block->size = 0;
+  reserve(block, size);
+  if (fread(block->code, 1, size, f) != (size_t) size || !verifyCode(block)) {
+    fclose(f);
+    block->size = 0;
+    return IO_ERROR;
+  }
+  fclose(f);
+  return IO_SUCCESS;
+}
+
+void cleanCode(CodeBlock *block) {
+  memFree(block->code);
+  memset(block, 0, sizeof(CodeBlock));
+}
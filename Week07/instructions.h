@@ -0,0 +1,110 @@
+/* Stack machine instructions
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#ifndef __INSTRUCTIONS_H__
+#define __INSTRUCTIONS_H__
+
+#include <stdio.h>
+#include <string.h>
+
+/* The machine works on a stack of 32-bit words. b is the base of the
+ * running frame and t the top of the stack. A frame starts with four
+ * words, then the parameters and the variables of its block:
+ *
+ *   b+0  RV  the return value of a function
+ *   b+1  DL  the dynamic link, the base of the caller's frame
+ *   b+2  RA  the return address
+ *   b+3  SL  the static link, the base of the enclosing block's frame
+ *
+ * An instruction is an opcode byte followed by its operands, each a
+ * 32-bit word in the byte order of the machine. p is a static level: 0
+ * for the running frame, 1 for the one that encloses it and so on.
+ */
+#define RESERVED_WORDS 4
+#define FRAME_RV 0
+#define FRAME_DL 1
+#define FRAME_RA 2
+#define FRAME_SL 3
+
+typedef enum {
+  OP_LA,      /* LA p q: push the address q in frame p */
+  OP_LV,      /* LV p q: push the word at q in frame p */
+  OP_LC,      /* LC q: push q */
+  OP_LI,      /* replace an address by the word there */
+  OP_INT,     /* INT q: reserve q words */
+  OP_DCT,     /* DCT q: drop q words */
+  OP_J,       /* J q: jump to q */
+  OP_FJ,      /* FJ q: pop, jump to q if false */
+  OP_HL,      /* halt */
+  OP_ST,      /* pop a value and an address, store */
+  OP_CALL,    /* CALL p q: call the code at q, p the level of its block */
+  OP_EP,      /* return from a procedure */
+  OP_EF,      /* return from a function, leaving RV */
+  OP_RC,      /* push a character read */
+  OP_RI,      /* push an integer read */
+  OP_WRC,     /* pop and write a character */
+  OP_WRI,     /* pop and write an integer */
+  OP_WLN,     /* write a new line */
+  OP_AD,
+  OP_SB,
+  OP_ML,
+  OP_DV,
+  OP_NEG,
+  OP_CV,      /* copy the top */
+  OP_IX,      /* IX p q: pop an index, add its offset in an array of p
+               * elements of q words to the address below */
+  OP_EQ,
+  OP_NE,
+  OP_GT,
+  OP_LT,
+  OP_GE,
+  OP_LE,
+  OP_COUNT
+} OpCode;
+
+/* The code of a program, from address 0 */
+typedef struct CodeBlock_ {
+  unsigned char *code;
+  int size;
+  int capacity;
+} CodeBlock;
+
+/* The number of operands of each opcode */
+extern const unsigned char opOperands[OP_COUNT];
+
+#define opLength(op) (1 + 4 * opOperands[op])
+
+static inline int codeOperand(const unsigned char *code, int i) {
+  int word;
+  memcpy(&word, code + 1 + 4 * i, sizeof(int));
+  return word;
+}
+
+/* The emitters append an instruction and return its address */
+int emitOp(CodeBlock *block, OpCode op);
+int emitOp1(CodeBlock *block, OpCode op, int q);
+int emitOp2(CodeBlock *block, OpCode op, int p, int q);
+/* Set the last operand of the instruction at address, a jump target */
+void patchOperand(CodeBlock *block, int address, int q);
+
+const char *opName(OpCode op);
+/* Returns the length of the instruction at address, or 0 when the
+ * bytes there are not one
+ */
+int decodeLength(CodeBlock *block, int address);
+void printCode(CodeBlock *block, FILE *out);
+
+/* Compiled programs are saved as KBC_MAGIC, the size and the code.
+ * loadCode() returns IO_ERROR for a file that is not one.
+ */
+#define KBC_MAGIC "KBC1"
+#define KBC_MAX_SIZE (256 * 1024 * 1024)
+
+int saveCode(CodeBlock *block, char *fileName);
+int loadCode(CodeBlock *block, char *fileName);
+void cleanCode(CodeBlock *block);
+
+#endif
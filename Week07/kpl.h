@@ -0,0 +1,63 @@
+/* KPL compiler library
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#ifndef __KPL_H__
+#define __KPL_H__
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define KPL_API __attribute__((visibility("default")))
+
+/* kpl_compile_buffer() results */
+#define KPL_OK 0
+#define KPL_COMPILE_ERROR 1
+#define KPL_FAILED (-1)
+
+#define KPL_MESSAGE_SIZE 128
+
+typedef struct {
+  int line;
+  int column;
+  int offset;                   /* byte offset in the source */
+  int missingToken;             /* 1: a token was expected, 0: an error */
+  int code;                     /* the error code or the missing token */
+  char message[KPL_MESSAGE_SIZE];
+} kpl_diagnostic;
+
+typedef struct {
+  int dumpObjects;              /* return the object tree of the program */
+  const char *cacheDir;         /* share results through this cache, or NULL */
+  long cacheSize;               /* the bound of the cache in bytes, 0 for 64 MB */
+} kpl_options;
+
+typedef struct {
+  int status;
+  kpl_diagnostic *diagnostics;
+  int diagnosticCount;
+  char *objects;                /* NUL terminated, or NULL */
+  size_t objectsSize;
+} kpl_result;
+
+/* Compile size bytes of source. options may be NULL. The compiler state
+ * is kept per thread and reused by the next call on the same thread.
+ * Returns the status also stored in result.
+ */
+KPL_API int kpl_compile_buffer(const char *source, size_t size, const kpl_options *options, kpl_result *result);
+
+KPL_API void kpl_free_result(kpl_result *result);
+
+/* Release the state kept for the calling thread */
+KPL_API void kpl_thread_cleanup(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,52 @@
+/* Runtime of native KPL programs
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "kplrt.h"
+
+static const char *const errorMessages[] = {
+  "Array index out of range.",
+  "Division by zero.",
+  "Invalid input."
+};
+
+int kpl_readi(void) {
+  int value;
+
+  if (scanf("%d", &value) != 1) kpl_fail(KPL_INPUT_ERROR);
+  return value;
+}
+
+int kpl_readc(void) {
+  char c;
+
+  if (scanf(" %c", &c) != 1) kpl_fail(KPL_INPUT_ERROR);
+  return (unsigned char) c;
+}
+
+void kpl_writei(int value) {
+  printf("%d", value);
+}
+
+void kpl_writec(int c) {
+  putchar(c);
+}
+
+void kpl_writeln(void) {
+  putchar('\n');
+}
+
+void kpl_fail(KplError error) {
+  fflush(stdout);
+  fprintf(stderr, "Runtime error: %s\n", errorMessages[error]);
+  exit(1);
+}
+
+int main(void) {
+  kpl_main();
+  return 0;
+}
@@ -0,0 +1,31 @@
+/* Runtime of native KPL programs
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#ifndef __KPLRT_H__
+#define __KPLRT_H__
+
+/* The assembly kplc -S writes defines kpl_main, the program, and calls
+ * the functions below for the builtins and the runtime errors. Linked
+ * with kplrt.o, it makes a program that reads stdin and writes stdout
+ * as kplrun would.
+ */
+typedef enum {
+  KPL_INDEX_ERROR,
+  KPL_DIVISION_ERROR,
+  KPL_INPUT_ERROR
+} KplError;
+
+void kpl_main(void);
+
+int kpl_readi(void);
+int kpl_readc(void);
+void kpl_writei(int value);
+void kpl_writec(int c);
+void kpl_writeln(void);
+/* Report the error and exit */
+void kpl_fail(KplError error);
+
+#endif
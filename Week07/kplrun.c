@@ -0,0 +1,139 @@
+/* KPL program runner
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "alloc.h"
+#include "reader.h"
+#include "parser.h"
+#include "error.h"
+#include "instructions.h"
+#include "vm.h"
+#include "regvm.h"
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int endsWith(char *name, char *suffix) {
+  size_t n = strlen(name), m = strlen(suffix);
+  return n >= m && strcmp(name + n - m, suffix) == 0;
+}
+
+/* Compile a source file into stack code, or register code when regCode
+ * is not NULL. The diagnostic, if any, goes to stdout as kplc would
+ * print it; the object tree is not printed.
+ */
+static int compileProgramFile(char *fileName, CodeBlock *code, RegCode *regCode) {
+  CompilerContext ctx;
+  FILE *devnull = fopen("/dev/null", "w");
+  int result;
+
+  if (devnull == NULL) return IO_ERROR;
+  initContext(&ctx, devnull);
+  if (regCode != NULL) ctx.regCode = regCode;
+  else ctx.code = code;
+  if (openInputStream(&ctx, fileName) == IO_ERROR) {
+    fclose(devnull);
+    return IO_ERROR;
+  }
+
+  result = compileInput(&ctx);
+  if (result == COMPILE_ERROR) {
+    ctx.out = stdout;
+    printDiagnostic(&ctx);
+  }
+  closeInputStream(&ctx);
+  freeContext(&ctx);
+  fclose(devnull);
+  return result;
+}
+
+/* kplrun [--stats] [--dump] [--stack words] [--dispatch switch|threaded]
+ * [--registers] file runs a program: a .kpl source, compiled first, or
+ * the code kplc -o saved. --registers compiles the source for the
+ * register machine instead; it does not take --dispatch.
+ */
+int main(int argc, char *argv[]) {
+  CodeBlock code = { NULL, 0, 0 };
+  RegCode regCode = { NULL, 0, 0 };
+  Machine machine;
+  VMStatus status;
+  double start, elapsed;
+  int stats = 0, dump = 0, registers = 0, stackSize = VM_STACK_SIZE;
+  VMDispatch dispatch = VM_DISPATCH_BEST;
+  int first = 1;
+  int result;
+
+  while (argc > first + 1) {
+    if (strcmp(argv[first], "--stats") == 0) stats = 1;
+    else if (strcmp(argv[first], "--dump") == 0) dump = 1;
+    else if (strcmp(argv[first], "--registers") == 0) registers = 1;
+    else if (strcmp(argv[first], "--stack") == 0 && argc > first + 2) stackSize = atoi(argv[++first]);
+    else if (strcmp(argv[first], "--dispatch") == 0 && argc > first + 2) {
+      first ++;
+      if (strcmp(argv[first], "switch") == 0) dispatch = VM_DISPATCH_SWITCH;
+      else if (strcmp(argv[first], "threaded") == 0) dispatch = VM_DISPATCH_THREADED;
+      else stackSize = 0;
+    }
+    else break;
+    first ++;
+  }
+
+  /* the register machine has the one dispatch its build chose */
+  if (argc != first + 1 || stackSize <= 0
+      || (registers && (!endsWith(argv[first], ".kpl") || dispatch != VM_DISPATCH_BEST))) {
+    printf("usage: kplrun [--stats] [--dump] [--stack words] [--dispatch switch|threaded | --registers] <file>\n");
+    return -1;
+  }
+
+  if (endsWith(argv[first], ".kpl")) {
+    result = compileProgramFile(argv[first], &code, registers ? &regCode : NULL);
+    if (result == COMPILE_ERROR) {
+      cleanCode(&code);
+      cleanRegCode(&regCode);
+      return 1;
+    }
+  } else result = loadCode(&code, argv[first]);
+  if (result == IO_ERROR) {
+    printf("Can\'t read input file!\n");
+    cleanCode(&code);
+    return -1;
+  }
+
+  if (dump) {
+    if (registers) printRegCode(&regCode, stdout);
+    else printCode(&code, stdout);
+    cleanCode(&code);
+    cleanRegCode(&regCode);
+    return 0;
+  }
+
+  initMachine(&machine, stdin, stdout);
+  machine.stackSize = stackSize;
+  machine.dispatch = dispatch;
+  start = now();
+  if (registers) status = runRegisterMachine(&machine, &regCode);
+  else status = runMachine(&machine, &code);
+  elapsed = now() - start;
+
+  if (status != VM_HALTED)
+    fprintf(stderr, "Runtime error at %d: %s\n", machine.pc, vmStatusMessage(status));
+  /* --stats reports the speed of the machine */
+  if (stats)
+    fprintf(stderr, "%s: %lld instructions in %.3f s: %.1f M instructions/s (%s machine, %s dispatch)\n",
+	    argv[first], machine.instructions, elapsed, machine.instructions / elapsed * 1e-6,
+	    registers ? "register" : "stack", dispatchName(selectDispatch(registers ? VM_DISPATCH_BEST : dispatch)));
+
+  cleanCode(&code);
+  cleanRegCode(&regCode);
+  return status == VM_HALTED ? 0 : 1;
+}
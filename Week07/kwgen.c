@@ -0,0 +1,144 @@
+/* Keyword perfect hash generator
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ *
+ * Reads a keyword list (spelling and token type per line, '#' starts a
+ * comment) and writes a C header with a collision-free hash table.
+ * The hash only looks at the length, the first two characters and the
+ * last character of a word:
+ *
+ *   h = (len * D + s[0] * A + s[1] * B + s[len-1] * C) mod SIZE
+ *
+ * The generator searches for multipliers A, B, C, D and the smallest
+ * power-of-two SIZE for which no two keywords collide.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_KEYWORDS 256
+#define MAX_WORD_LEN 63
+#define MAX_MULTIPLIER 32
+#define MAX_TABLE_SIZE 1024
+
+struct {
+  char string[MAX_WORD_LEN + 1];
+  char tokenType[MAX_WORD_LEN + 1];
+  int length;
+} keywords[MAX_KEYWORDS];
+int keywordCount;
+
+int hash(int k, int a, int b, int c, int d, int size) {
+  const unsigned char *s = (const unsigned char *) keywords[k].string;
+  int len = keywords[k].length;
+  return (len * d + s[0] * a + s[1] * b + s[len - 1] * c) & (size - 1);
+}
+
+int collisionFree(int a, int b, int c, int d, int size) {
+  static int used[MAX_TABLE_SIZE];
+  int k, h;
+
+  memset(used, 0, sizeof(int) * size);
+  for (k = 0; k < keywordCount; k++) {
+    h = hash(k, a, b, c, d, size);
+    if (used[h]) return 0;
+    used[h] = 1;
+  }
+  return 1;
+}
+
+int readKeywords(FILE *f) {
+  char line[256];
+  int lineNo = 0;
+
+  while (fgets(line, sizeof(line), f) != NULL) {
+    char *p = line;
+    lineNo ++;
+    while (*p == ' ' || *p == '\t') p++;
+    if (*p == '#' || *p == '\n' || *p == '\0') continue;
+
+    if (keywordCount == MAX_KEYWORDS) {
+      fprintf(stderr, "kwgen: too many keywords\n");
+      return 0;
+    }
+    if (sscanf(p, "%63s %63s", keywords[keywordCount].string, keywords[keywordCount].tokenType) != 2) {
+      fprintf(stderr, "kwgen: line %d: expected <spelling> <token type>\n", lineNo);
+      return 0;
+    }
+    keywords[keywordCount].length = strlen(keywords[keywordCount].string);
+    if (keywords[keywordCount].length < 2) {
+      fprintf(stderr, "kwgen: line %d: keywords must have at least two characters\n", lineNo);
+      return 0;
+    }
+    keywordCount ++;
+  }
+  return 1;
+}
+
+void writeTable(FILE *f, char *source, int a, int b, int c, int d, int size) {
+  int slots[MAX_TABLE_SIZE];
+  int minLen = MAX_WORD_LEN, maxLen = 0;
+  int k, h;
+
+  for (h = 0; h < size; h++) slots[h] = -1;
+  for (k = 0; k < keywordCount; k++) {
+    slots[hash(k, a, b, c, d, size)] = k;
+    if (keywords[k].length < minLen) minLen = keywords[k].length;
+    if (keywords[k].length > maxLen) maxLen = keywords[k].length;
+  }
+
+  fprintf(f, "/* Generated by kwgen from %s. Do not edit. */\n\n", source);
+  fprintf(f, "#ifndef __KWTABLE_H__\n#define __KWTABLE_H__\n\n");
+  fprintf(f, "#define KEYWORDS_COUNT %d\n", keywordCount);
+  fprintf(f, "#define KW_MIN_LEN %d\n", minLen);
+  fprintf(f, "#define KW_MAX_LEN %d\n", maxLen);
+  fprintf(f, "#define KW_HASH_SIZE %d\n\n", size);
+  fprintf(f, "#define KW_HASH(s, len) \\\n");
+  fprintf(f, "  (((len) * %d + (s)[0] * %d + (s)[1] * %d + (s)[(len) - 1] * %d) & (KW_HASH_SIZE - 1))\n\n",
+	  d, a, b, c);
+  fprintf(f, "static const struct {\n  char string[KW_MAX_LEN + 1];\n  int length;\n  TokenType tokenType;\n");
+  fprintf(f, "} kwTable[KW_HASH_SIZE] = {\n");
+  for (h = 0; h < size; h++) {
+    if (slots[h] < 0)
+      fprintf(f, "  {\"\", 0, TK_NONE}");
+    else
+      fprintf(f, "  {\"%s\", %d, %s}", keywords[slots[h]].string,
+	      keywords[slots[h]].length, keywords[slots[h]].tokenType);
+    fprintf(f, h + 1 < size ? ",\n" : "\n");
+  }
+  fprintf(f, "};\n\n#endif\n");
+}
+
+int main(int argc, char *argv[]) {
+  FILE *f;
+  int a, b, c, d, size;
+
+  if (argc != 2) {
+    fprintf(stderr, "usage: kwgen <keywords.def>\n");
+    return 1;
+  }
+
+  f = fopen(argv[1], "r");
+  if (f == NULL) {
+    fprintf(stderr, "kwgen: can't read %s\n", argv[1]);
+    return 1;
+  }
+  if (!readKeywords(f)) return 1;
+  fclose(f);
+
+  for (size = 1; size < keywordCount; size *= 2);
+  for (; size <= MAX_TABLE_SIZE; size *= 2)
+    for (a = 1; a < MAX_MULTIPLIER; a++)
+      for (b = 0; b < MAX_MULTIPLIER; b++)
+	for (c = 0; c < MAX_MULTIPLIER; c++)
+	  for (d = 0; d < MAX_MULTIPLIER; d++)
+	    if (collisionFree(a, b, c, d, size)) {
+	      writeTable(stdout, argv[1], a, b, c, d, size);
+	      return 0;
+	    }
+
+  fprintf(stderr, "kwgen: no collision-free hash found\n");
+  return 1;
+}
@@ -0,0 +1,53 @@
+/* Generated by kwgen from keywords.def. Do not edit. */
+
+#ifndef __KWTABLE_H__
+#define __KWTABLE_H__
+
+#define KEYWORDS_COUNT 20
+#define KW_MIN_LEN 2
+#define KW_MAX_LEN 9
+#define KW_HASH_SIZE 32
+
+#define KW_HASH(s, len) \
+  (((len) * 2 + (s)[0] * 1 + (s)[1] * 2 + (s)[(len) - 1] * 5) & (KW_HASH_SIZE - 1))
+
+static const struct {
+  char string[KW_MAX_LEN + 1];
+  int length;
+  TokenType tokenType;
+} kwTable[KW_HASH_SIZE] = {
+  {"", 0, TK_NONE},
+  {"TO", 2, KW_TO},
+  {"", 0, TK_NONE},
+  {"PROGRAM", 7, KW_PROGRAM},
+  {"FOR", 3, KW_FOR},
+  {"", 0, TK_NONE},
+  {"FUNCTION", 8, KW_FUNCTION},
+  {"TYPE", 4, KW_TYPE},
+  {"", 0, TK_NONE},
+  {"CALL", 4, KW_CALL},
+  {"WHILE", 5, KW_WHILE},
+  {"", 0, TK_NONE},
+  {"ARRAY", 5, KW_ARRAY},
+  {"INTEGER", 7, KW_INTEGER},
+  {"", 0, TK_NONE},
+  {"CONST", 5, KW_CONST},
+  {"", 0, TK_NONE},
+  {"DO", 2, KW_DO},
+  {"THEN", 4, KW_THEN},
+  {"", 0, TK_NONE},
+  {"", 0, TK_NONE},
+  {"CHAR", 4, KW_CHAR},
+  {"", 0, TK_NONE},
+  {"IF", 2, KW_IF},
+  {"VAR", 3, KW_VAR},
+  {"", 0, TK_NONE},
+  {"", 0, TK_NONE},
+  {"END", 3, KW_END},
+  {"BEGIN", 5, KW_BEGIN},
+  {"OF", 2, KW_OF},
+  {"ELSE", 4, KW_ELSE},
+  {"PROCEDURE", 9, KW_PROCEDURE}
+};
+
+#endif
@@ -0,0 +1,120 @@
+/* KPL compiler library
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "alloc.h"
+#include "reader.h"
+#include "parser.h"
+#include "error.h"
+#include "cache.h"
+#include "kpl.h"
+
+#define KPL_CACHE_SIZE (64 * 1000000L)
+
+/* Every thread compiles in a context of its own, created on its first
+ * call and reused, so a service thread does not rebuild its tables for
+ * each request.
+ */
+static __thread CompilerContext *threadContext;
+
+/* Caches are opened once per directory and shared by all threads */
+typedef struct OpenCache_ {
+  char *dirName;
+  Cache *cache;
+  struct OpenCache_ *next;
+} OpenCache;
+
+static OpenCache *openCaches;
+static pthread_mutex_t openCachesLock = PTHREAD_MUTEX_INITIALIZER;
+
+static Cache *sharedCache(const char *dirName, long limit) {
+  OpenCache *c;
+  Cache *cache = NULL;
+
+  pthread_mutex_lock(&openCachesLock);
+  for (c = openCaches; c != NULL; c = c->next)
+    if (strcmp(c->dirName, dirName) == 0) {
+      cache = c->cache;
+      break;
+    }
+  if (c == NULL) {
+    c = (OpenCache*) memAlloc(sizeof(OpenCache));
+    c->dirName = (char*) memAlloc(strlen(dirName) + 1);
+    strcpy(c->dirName, dirName);
+    c->cache = cache = openCache(c->dirName, limit > 0 ? limit : KPL_CACHE_SIZE);
+    c->next = openCaches;
+    openCaches = c;
+  }
+  pthread_mutex_unlock(&openCachesLock);
+  return cache;
+}
+
+static void resultDiagnostic(CompilerContext *ctx, kpl_result *result) {
+  kpl_diagnostic *d = (kpl_diagnostic*) memAlloc(sizeof(kpl_diagnostic));
+
+  positionOf(ctx, ctx->diagnostic.pos, &d->line, &d->column);
+  d->offset = ctx->diagnostic.pos;
+  d->missingToken = ctx->diagnostic.missing;
+  d->code = ctx->diagnostic.code;
+  diagnosticMessage(ctx, d->message, sizeof(d->message));
+  result->diagnostics = d;
+  result->diagnosticCount = 1;
+}
+
+int kpl_compile_buffer(const char *source, size_t size, const kpl_options *options, kpl_result *result) {
+  CompilerContext *ctx = threadContext;
+  char *output = NULL;
+  size_t outputSize = 0;
+  int status;
+
+  memset(result, 0, sizeof(kpl_result));
+  if (source == NULL && size > 0) {
+    result->status = KPL_FAILED;
+    return KPL_FAILED;
+  }
+
+  if (ctx == NULL) {
+    ctx = threadContext = (CompilerContext*) memAlloc(sizeof(CompilerContext));
+    initContext(ctx, NULL);
+  }
+  ctx->cache = options != NULL && options->cacheDir != NULL
+    ? sharedCache(options->cacheDir, options->cacheSize) : NULL;
+
+  ctx->out = open_memstream(&output, &outputSize);
+  openInputBuffer(ctx, source, size);
+  status = ctx->cache != NULL ? compileCached(ctx) : compileInput(ctx);
+  fclose(ctx->out);
+  ctx->out = NULL;
+
+  if (status == COMPILE_ERROR) {
+    resultDiagnostic(ctx, result);
+    result->status = KPL_COMPILE_ERROR;
+  } else result->status = KPL_OK;
+  closeInputStream(ctx);
+  resetAtoms(&ctx->atoms);
+
+  if (status != COMPILE_ERROR && options != NULL && options->dumpObjects) {
+    result->objects = output;
+    result->objectsSize = outputSize;
+  } else free(output);
+  return result->status;
+}
+
+void kpl_free_result(kpl_result *result) {
+  memFree(result->diagnostics);
+  free(result->objects);
+  memset(result, 0, sizeof(kpl_result));
+}
+
+void kpl_thread_cleanup(void) {
+  if (threadContext == NULL) return;
+  freeContext(threadContext);
+  memFree(threadContext);
+  threadContext = NULL;
+}
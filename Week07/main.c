@@ -6,22 +6,219 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
+#include "alloc.h"
 #include "reader.h"
 #include "parser.h"
+#include "batch.h"
+#include "server.h"
+#include "cache.h"
+#include "instructions.h"
 
 /******************************************************************/
 
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int isDirectory(char *name) {
+  struct stat st;
+  return stat(name, &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+/* kplc [-j threads] file|directory ... compiles every file given or
+ * found in a directory on a pool of threads. The outputs come in the
+ * order of the arguments; the throughput goes to stderr.
+ */
+int batchMain(int argc, char *argv[], int threads, Cache *cache) {
+  char **fileNames = NULL;
+  char **dirFiles;
+  int fileCount = 0, capacity = 0, dirCount, failed;
+  double start, elapsed;
+  int i, j;
+
+  for (i = 0; i < argc; i++) {
+    if (isDirectory(argv[i])) {
+      dirFiles = listDirectory(argv[i], &dirCount);
+    } else {
+      dirFiles = (char**) memAlloc(sizeof(char*));
+      dirFiles[0] = (char*) memAlloc(strlen(argv[i]) + 1);
+      strcpy(dirFiles[0], argv[i]);
+      dirCount = 1;
+    }
+    if (fileCount + dirCount > capacity) {
+      capacity = fileCount + dirCount > 2 * capacity ? fileCount + dirCount : 2 * capacity;
+      fileNames = (char**) memRealloc(fileNames, capacity * sizeof(char*));
+    }
+    for (j = 0; j < dirCount; j++)
+      fileNames[fileCount++] = dirFiles[j];
+    memFree(dirFiles);
+  }
+
+  start = now();
+  failed = compileBatch(fileNames, fileCount, threads, cache, stdout);
+  fflush(stdout);
+  elapsed = now() - start;
+
+  fprintf(stderr, "%d files on %d threads in %.3f s: %.0f files/s\n",
+	  fileCount, threads, elapsed, fileCount / elapsed);
+  if (cache != NULL) printCacheStats(cache, stderr);
+  freeFileList(fileNames, fileCount);
+  /* an input that could not be read fails the batch, as it fails kplc */
+  return failed > 0 ? -1 : 0;
+}
+
+/* kplc --client socket file ... sends the files to a compile server
+ * and prints what it returns, as kplc would for each file.
+ */
+int clientMain(char *path, int argc, char *argv[]) {
+  char *source, *output;
+  size_t size, capacity, outputSize, n;
+  FILE *f;
+  int fd, i;
+
+  fd = connectServer(path);
+  if (fd < 0) {
+    printf("Can\'t connect to %s!\n", path);
+    return -1;
+  }
+
+  for (i = 0; i < argc; i++) {
+    if (argc > 1) printf("==> %s <==\n", argv[i]);
+    f = fopen(argv[i], "rb");
+    if (f == NULL) {
+      printf("Can\'t read input file!\n");
+      continue;
+    }
+    capacity = 4096;
+    size = 0;
+    source = (char*) memAlloc(capacity);
+    while ((n = fread(source + size, 1, capacity - size, f)) > 0) {
+      size += n;
+      if (size == capacity) {
+	capacity *= 2;
+	source = (char*) memRealloc(source, capacity);
+      }
+    }
+    fclose(f);
+
+    if (requestCompile(fd, source, size, &output, &outputSize) < 0) {
+      printf("Can\'t connect to %s!\n", path);
+      memFree(source);
+      close(fd);
+      return -1;
+    }
+    fwrite(output, 1, outputSize, stdout);
+    memFree(output);
+    memFree(source);
+  }
+
+  close(fd);
+  return 0;
+}
+
 int main(int argc, char *argv[]) {
-  if (argc <= 1) {
+  CompilerContext ctx;
+  char *server = NULL, *client = NULL, *cacheDir = NULL, *output = NULL, *assembly = NULL;
+  CodeBlock code = { NULL, 0, 0 };
+  long cacheSize = 64;
+  Cache *cache = NULL;
+  int threads = 0;
+  int stats = 0;
+  int first = 1;
+  int result;
+
+  while (argc > first + 1) {
+    if (strcmp(argv[first], "--stats") == 0) {
+      stats = 1;
+      first ++;
+      continue;
+    }
+    if (strcmp(argv[first], "-j") == 0) threads = atoi(argv[first + 1]);
+    else if (strcmp(argv[first], "--server") == 0) server = argv[first + 1];
+    else if (strcmp(argv[first], "--client") == 0) client = argv[first + 1];
+    else if (strcmp(argv[first], "--cache") == 0) cacheDir = argv[first + 1];
+    else if (strcmp(argv[first], "--cache-size") == 0) cacheSize = atol(argv[first + 1]);
+    else if (strcmp(argv[first], "-o") == 0) output = argv[first + 1];
+    else if (strcmp(argv[first], "-S") == 0) assembly = argv[first + 1];
+    else break;
+    first += 2;
+  }
+
+  /* --cache <dir> [--cache-size <MB>] keeps results across runs */
+  if (cacheDir != NULL && (cache = openCache(cacheDir, cacheSize * 1000000)) == NULL) {
+    printf("Can\'t open cache %s!\n", cacheDir);
+    return -1;
+  }
+
+  if (server != NULL) {
+    if (threads <= 0) threads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (runServer(server, threads, cache) == IO_ERROR) {
+      printf("Can\'t listen on %s!\n", server);
+      return -1;
+    }
+    return 0;
+  }
+
+  if (argc <= first) {
     printf("parser: no input file.\n");
     return -1;
   }
 
-  if (compile(argv[1]) == IO_ERROR) {
+  if (client != NULL)
+    return clientMain(client, argc - first, argv + first);
+
+  if (threads > 0 || argc - first > 1 || isDirectory(argv[first])) {
+    /* the code of a batch has nowhere to go */
+    if (output != NULL || assembly != NULL) {
+      printf("usage: kplc [-o file] [-S file] <file>: -o and -S take a single input file\n");
+      if (cache != NULL) closeCache(cache);
+      return -1;
+    }
+    if (threads <= 0) threads = sysconf(_SC_NPROCESSORS_ONLN);
+    result = batchMain(argc - first, argv + first, threads, cache);
+    if (cache != NULL) closeCache(cache);
+    return result;
+  }
+
+  initContext(&ctx, stdout);
+  ctx.cache = cache;
+  /* -o <file> also saves the code of the program for kplrun */
+  if (output != NULL) ctx.code = &code;
+  /* -S <file> writes x86-64 assembly to link with kplrt.o */
+  if (assembly != NULL && (ctx.assembly = fopen(assembly, "w")) == NULL) {
+    printf("Can\'t write output file!\n");
+    freeContext(&ctx);
+    if (cache != NULL) closeCache(cache);
+    return -1;
+  }
+  result = compile(&ctx, argv[first]);
+  if (ctx.assembly != NULL) {
+    fclose(ctx.assembly);
+    if (result != IO_SUCCESS) remove(assembly);
+  }
+  /* --stats reports the size of the tree the compilation built */
+  if (stats && result != IO_ERROR)
+    fprintf(stderr, "ast: %u nodes, %lu bytes\n",
+	    astNodeCount(&ctx.ast), (unsigned long) astBytes(&ctx.ast));
+  freeContext(&ctx);
+  if (cache != NULL) closeCache(cache);
+  if (result == IO_ERROR) {
     printf("Can\'t read input file!\n");
     return -1;
   }
-    
+  if (output != NULL && result == IO_SUCCESS && saveCode(&code, output) == IO_ERROR) {
+    printf("Can\'t write output file!\n");
+    cleanCode(&code);
+    return -1;
+  }
+  cleanCode(&code);
+
   return 0;
 }
@@ -5,397 +5,436 @@
  */
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "reader.h"
+#include "atom.h"
 #include "scanner.h"
 #include "parser.h"
 #include "semantics.h"
 #include "error.h"
 #include "debug.h"
+#include "cache.h"
+#include "codegen.h"
+#include "reggen.h"
+#include "x86gen.h"
+
+/* The parser owns the storage of its two live tokens, in the context.
+ * Each scan reads the next token into the slot that held the previous
+ * currentToken.
+ */
 
-Token *currentToken;
-Token *lookAhead;
-
-extern Type* intType;
-extern Type* charType;
-extern SymTab* symtab;
-
-void scan(void) {
-  Token* tmp = currentToken;
-  currentToken = lookAhead;
-  lookAhead = getValidToken();
-  free(tmp);
+void scan(CompilerContext *ctx) {
+  Token* tmp = ctx->currentToken;
+  ctx->currentToken = ctx->lookAhead;
+  ctx->lookAhead = getValidToken(ctx, tmp != NULL ? tmp : &ctx->tokenRing[1]);
 }
 
-void eat(TokenType tokenType) {
-  if (lookAhead->tokenType == tokenType) {
-    scan();
-  } else missingToken(tokenType, lookAhead->lineNo, lookAhead->colNo);
+void eat(CompilerContext *ctx, TokenType tokenType) {
+  if (ctx->lookAhead->tokenType == tokenType) {
+    scan(ctx);
+  } else missingToken(ctx, tokenType, ctx->lookAhead->pos);
 }
 
-void compileProgram(void) {
+void compileProgram(CompilerContext *ctx) {
   Object* program;
 
-  eat(KW_PROGRAM);
-  eat(TK_IDENT);
+  eat(ctx, KW_PROGRAM);
+  eat(ctx, TK_IDENT);
 
-  program = createProgramObject(currentToken->string);
-  enterBlock(program->progAttrs->scope);
+  program = createProgramObject(ctx, ctx->currentToken->value);
+  enterBlock(ctx, program->progAttrs.scope);
 
-  eat(SB_SEMICOLON);
+  eat(ctx, SB_SEMICOLON);
 
-  compileBlock();
-  eat(SB_PERIOD);
+  program->progAttrs.body = compileBlock(ctx);
+  eat(ctx, SB_PERIOD);
 
-  exitBlock();
+  exitBlock(ctx);
 }
 
-void compileBlock(void) {
+AstRef compileBlock(CompilerContext *ctx) {
   Object* constObj;
-  ConstantValue* constValue;
+  ConstantValue constValue;
 
-  if (lookAhead->tokenType == KW_CONST) {
-    eat(KW_CONST);
+  if (ctx->lookAhead->tokenType == KW_CONST) {
+    eat(ctx, KW_CONST);
 
     do {
-      eat(TK_IDENT);
+      eat(ctx, TK_IDENT);
       
-      checkFreshIdent(currentToken->string);
-      constObj = createConstantObject(currentToken->string);
+      checkFreshIdent(ctx, ctx->currentToken->value);
+      constObj = createConstantObject(ctx, ctx->currentToken->value);
       
-      eat(SB_EQ);
-      constValue = compileConstant();
+      eat(ctx, SB_EQ);
+      constValue = compileConstant(ctx);
       
-      constObj->constAttrs->value = constValue;
-      declareObject(constObj);
+      constObj->constAttrs.value = constValue;
+      declareObject(ctx, constObj);
       
-      eat(SB_SEMICOLON);
-    } while (lookAhead->tokenType == TK_IDENT);
+      eat(ctx, SB_SEMICOLON);
+    } while (ctx->lookAhead->tokenType == TK_IDENT);
 
-    compileBlock2();
+    return compileBlock2(ctx);
   } 
-  else compileBlock2();
+  else return compileBlock2(ctx);
 }
 
-void compileBlock2(void) {
+AstRef compileBlock2(CompilerContext *ctx) {
   Object* typeObj;
   Type* actualType;
 
-  if (lookAhead->tokenType == KW_TYPE) {
-    eat(KW_TYPE);
+  if (ctx->lookAhead->tokenType == KW_TYPE) {
+    eat(ctx, KW_TYPE);
 
     do {
-      eat(TK_IDENT);
+      eat(ctx, TK_IDENT);
       
-      checkFreshIdent(currentToken->string);
-      typeObj = createTypeObject(currentToken->string);
+      checkFreshIdent(ctx, ctx->currentToken->value);
+      typeObj = createTypeObject(ctx, ctx->currentToken->value);
       
-      eat(SB_EQ);
-      actualType = compileType();
+      eat(ctx, SB_EQ);
+      actualType = compileType(ctx);
       
-      typeObj->typeAttrs->actualType = actualType;
-      declareObject(typeObj);
+      typeObj->typeAttrs.actualType = actualType;
+      declareObject(ctx, typeObj);
       
-      eat(SB_SEMICOLON);
-    } while (lookAhead->tokenType == TK_IDENT);
+      eat(ctx, SB_SEMICOLON);
+    } while (ctx->lookAhead->tokenType == TK_IDENT);
 
-    compileBlock3();
+    return compileBlock3(ctx);
   } 
-  else compileBlock3();
+  else return compileBlock3(ctx);
 }
 
-void compileBlock3(void) {
+AstRef compileBlock3(CompilerContext *ctx) {
   Object* varObj;
   Type* varType;
 
-  if (lookAhead->tokenType == KW_VAR) {
-    eat(KW_VAR);
+  if (ctx->lookAhead->tokenType == KW_VAR) {
+    eat(ctx, KW_VAR);
 
     do {
-      eat(TK_IDENT);
+      eat(ctx, TK_IDENT);
       
-      checkFreshIdent(currentToken->string);
-      varObj = createVariableObject(currentToken->string);
+      checkFreshIdent(ctx, ctx->currentToken->value);
+      varObj = createVariableObject(ctx, ctx->currentToken->value);
 
-      eat(SB_COLON);
-      varType = compileType();
+      eat(ctx, SB_COLON);
+      varType = compileType(ctx);
       
-      varObj->varAttrs->type = varType;
-      declareObject(varObj);
+      varObj->varAttrs.type = varType;
+      declareObject(ctx, varObj);
       
-      eat(SB_SEMICOLON);
-    } while (lookAhead->tokenType == TK_IDENT);
+      eat(ctx, SB_SEMICOLON);
+    } while (ctx->lookAhead->tokenType == TK_IDENT);
 
-    compileBlock4();
+    return compileBlock4(ctx);
   } 
-  else compileBlock4();
+  else return compileBlock4(ctx);
 }
 
-void compileBlock4(void) {
-  compileSubDecls();
-  compileBlock5();
+AstRef compileBlock4(CompilerContext *ctx) {
+  compileSubDecls(ctx);
+  return compileBlock5(ctx);
 }
 
-void compileBlock5(void) {
-  eat(KW_BEGIN);
-  compileStatements();
-  eat(KW_END);
+AstRef compileBlock5(CompilerContext *ctx) {
+  AstRef statements;
+
+  eat(ctx, KW_BEGIN);
+  statements = compileStatements(ctx);
+  eat(ctx, KW_END);
+  return statements;
 }
 
-void compileSubDecls(void) {
-  while ((lookAhead->tokenType == KW_FUNCTION) || (lookAhead->tokenType == KW_PROCEDURE)) {
-    if (lookAhead->tokenType == KW_FUNCTION)
-      compileFuncDecl();
-    else compileProcDecl();
+void compileSubDecls(CompilerContext *ctx) {
+  while ((ctx->lookAhead->tokenType == KW_FUNCTION) || (ctx->lookAhead->tokenType == KW_PROCEDURE)) {
+    if (ctx->lookAhead->tokenType == KW_FUNCTION)
+      compileFuncDecl(ctx);
+    else compileProcDecl(ctx);
   }
 }
 
-void compileFuncDecl(void) {
+void compileFuncDecl(CompilerContext *ctx) {
   Object* funcObj;
   Type* returnType;
 
-  eat(KW_FUNCTION);
-  eat(TK_IDENT);
+  eat(ctx, KW_FUNCTION);
+  eat(ctx, TK_IDENT);
 
-  checkFreshIdent(currentToken->string);
-  funcObj = createFunctionObject(currentToken->string);
-  declareObject(funcObj);
+  checkFreshIdent(ctx, ctx->currentToken->value);
+  funcObj = createFunctionObject(ctx, ctx->currentToken->value);
+  declareObject(ctx, funcObj);
 
-  enterBlock(funcObj->funcAttrs->scope);
+  enterBlock(ctx, funcObj->funcAttrs.scope);
   
-  compileParams();
+  compileParams(ctx);
 
-  eat(SB_COLON);
-  returnType = compileBasicType();
-  funcObj->funcAttrs->returnType = returnType;
+  eat(ctx, SB_COLON);
+  returnType = compileBasicType(ctx);
+  funcObj->funcAttrs.returnType = returnType;
 
-  eat(SB_SEMICOLON);
-  compileBlock();
-  eat(SB_SEMICOLON);
+  eat(ctx, SB_SEMICOLON);
+  funcObj->funcAttrs.body = compileBlock(ctx);
+  eat(ctx, SB_SEMICOLON);
 
-  exitBlock();
+  exitBlock(ctx);
 }
 
-void compileProcDecl(void) {
+void compileProcDecl(CompilerContext *ctx) {
   Object* procObj;
 
-  eat(KW_PROCEDURE);
-  eat(TK_IDENT);
+  eat(ctx, KW_PROCEDURE);
+  eat(ctx, TK_IDENT);
 
-  checkFreshIdent(currentToken->string);
-  procObj = createProcedureObject(currentToken->string);
-  declareObject(procObj);
+  checkFreshIdent(ctx, ctx->currentToken->value);
+  procObj = createProcedureObject(ctx, ctx->currentToken->value);
+  declareObject(ctx, procObj);
 
-  enterBlock(procObj->procAttrs->scope);
+  enterBlock(ctx, procObj->procAttrs.scope);
 
-  compileParams();
+  compileParams(ctx);
 
-  eat(SB_SEMICOLON);
-  compileBlock();
-  eat(SB_SEMICOLON);
+  eat(ctx, SB_SEMICOLON);
+  procObj->procAttrs.body = compileBlock(ctx);
+  eat(ctx, SB_SEMICOLON);
 
-  exitBlock();
+  exitBlock(ctx);
 }
 
-ConstantValue* compileUnsignedConstant(void) {
-  ConstantValue* constValue;
+ConstantValue compileUnsignedConstant(CompilerContext *ctx) {
+  ConstantValue constValue;
   Object* obj;
 
-  switch (lookAhead->tokenType) {
+  switch (ctx->lookAhead->tokenType) {
   case TK_NUMBER:
-    eat(TK_NUMBER);
-    constValue = makeIntConstant(currentToken->value);
+    eat(ctx, TK_NUMBER);
+    constValue = makeIntConstant(ctx->currentToken->value);
     break;
   case TK_IDENT:
-    eat(TK_IDENT);
+    eat(ctx, TK_IDENT);
 
-    obj = checkDeclaredConstant(currentToken->string);
-    constValue = duplicateConstantValue(obj->constAttrs->value);
+    obj = checkDeclaredConstant(ctx, ctx->currentToken->value);
+    constValue = obj->constAttrs.value;
 
     break;
   case TK_CHAR:
-    eat(TK_CHAR);
-    constValue = makeCharConstant(currentToken->string[0]);
+    eat(ctx, TK_CHAR);
+    constValue = makeCharConstant(ctx->currentToken->value);
     break;
   default:
-    error(ERR_INVALID_CONSTANT, lookAhead->lineNo, lookAhead->colNo);
+    error(ctx, ERR_INVALID_CONSTANT, ctx->lookAhead->pos);
     break;
   }
   return constValue;
 }
 
-ConstantValue* compileConstant(void) {
-  ConstantValue* constValue;
+ConstantValue compileConstant(CompilerContext *ctx) {
+  ConstantValue constValue;
 
-  switch (lookAhead->tokenType) {
+  switch (ctx->lookAhead->tokenType) {
   case SB_PLUS:
-    eat(SB_PLUS);
-    constValue = compileConstant2();
+    eat(ctx, SB_PLUS);
+    constValue = compileConstant2(ctx);
     break;
   case SB_MINUS:
-    eat(SB_MINUS);
-    constValue = compileConstant2();
-    constValue->intValue = - constValue->intValue;
+    eat(ctx, SB_MINUS);
+    constValue = compileConstant2(ctx);
+    constValue.intValue = - constValue.intValue;
     break;
   case TK_CHAR:
-    eat(TK_CHAR);
-    constValue = makeCharConstant(currentToken->string[0]);
+    eat(ctx, TK_CHAR);
+    constValue = makeCharConstant(ctx->currentToken->value);
     break;
   default:
-    constValue = compileConstant2();
+    constValue = compileConstant2(ctx);
     break;
   }
   return constValue;
 }
 
-ConstantValue* compileConstant2(void) {
-  ConstantValue* constValue;
+ConstantValue compileConstant2(CompilerContext *ctx) {
+  ConstantValue constValue;
   Object* obj;
 
-  switch (lookAhead->tokenType) {
+  switch (ctx->lookAhead->tokenType) {
   case TK_NUMBER:
-    eat(TK_NUMBER);
-    constValue = makeIntConstant(currentToken->value);
+    eat(ctx, TK_NUMBER);
+    constValue = makeIntConstant(ctx->currentToken->value);
     break;
   case TK_IDENT:
-    eat(TK_IDENT);
-    obj = checkDeclaredConstant(currentToken->string);
-    if (obj->constAttrs->value->type == TP_INT)
-      constValue = duplicateConstantValue(obj->constAttrs->value);
+    eat(ctx, TK_IDENT);
+    obj = checkDeclaredConstant(ctx, ctx->currentToken->value);
+    if (obj->constAttrs.value.type == TP_INT)
+      constValue = obj->constAttrs.value;
     else
-      error(ERR_UNDECLARED_INT_CONSTANT,currentToken->lineNo, currentToken->colNo);
+      error(ctx, ERR_UNDECLARED_INT_CONSTANT,ctx->currentToken->pos);
     break;
   default:
-    error(ERR_INVALID_CONSTANT, lookAhead->lineNo, lookAhead->colNo);
+    error(ctx, ERR_INVALID_CONSTANT, ctx->lookAhead->pos);
     break;
   }
   return constValue;
 }
 
-Type* compileType(void) {
+Type* compileType(CompilerContext *ctx) {
   Type* type;
   Type* elementType;
   int arraySize;
   Object* obj;
 
-  switch (lookAhead->tokenType) {
+  switch (ctx->lookAhead->tokenType) {
   case KW_INTEGER: 
-    eat(KW_INTEGER);
+    eat(ctx, KW_INTEGER);
     type =  makeIntType();
     break;
   case KW_CHAR: 
-    eat(KW_CHAR); 
+    eat(ctx, KW_CHAR); 
     type = makeCharType();
     break;
   case KW_ARRAY:
-    eat(KW_ARRAY);
-    eat(SB_LSEL);
-    eat(TK_NUMBER);
+    eat(ctx, KW_ARRAY);
+    eat(ctx, SB_LSEL);
+    eat(ctx, TK_NUMBER);
 
-    arraySize = currentToken->value;
+    arraySize = ctx->currentToken->value;
 
-    eat(SB_RSEL);
-    eat(KW_OF);
-    elementType = compileType();
-    type = makeArrayType(arraySize, elementType);
+    eat(ctx, SB_RSEL);
+    eat(ctx, KW_OF);
+    elementType = compileType(ctx);
+    type = makeArrayType(ctx, arraySize, elementType);
     break;
   case TK_IDENT:
-    eat(TK_IDENT);
-    obj = checkDeclaredType(currentToken->string);
-    type = duplicateType(obj->typeAttrs->actualType);
+    eat(ctx, TK_IDENT);
+    obj = checkDeclaredType(ctx, ctx->currentToken->value);
+    type = obj->typeAttrs.actualType;
     break;
   default:
-    error(ERR_INVALID_TYPE, lookAhead->lineNo, lookAhead->colNo);
+    error(ctx, ERR_INVALID_TYPE, ctx->lookAhead->pos);
     break;
   }
   return type;
 }
 
-Type* compileBasicType(void) {
+Type* compileBasicType(CompilerContext *ctx) {
   Type* type;
 
-  switch (lookAhead->tokenType) {
+  switch (ctx->lookAhead->tokenType) {
   case KW_INTEGER: 
-    eat(KW_INTEGER); 
+    eat(ctx, KW_INTEGER); 
     type = makeIntType();
     break;
   case KW_CHAR: 
-    eat(KW_CHAR); 
+    eat(ctx, KW_CHAR); 
     type = makeCharType();
     break;
   default:
-    error(ERR_INVALID_BASICTYPE, lookAhead->lineNo, lookAhead->colNo);
+    error(ctx, ERR_INVALID_BASICTYPE, ctx->lookAhead->pos);
     break;
   }
   return type;
 }
 
-void compileParams(void) {
-  if (lookAhead->tokenType == SB_LPAR) {
-    eat(SB_LPAR);
-    compileParam();
-    while (lookAhead->tokenType == SB_SEMICOLON) {
-      eat(SB_SEMICOLON);
-      compileParam();
+void compileParams(CompilerContext *ctx) {
+  if (ctx->lookAhead->tokenType == SB_LPAR) {
+    eat(ctx, SB_LPAR);
+    compileParam(ctx);
+    while (ctx->lookAhead->tokenType == SB_SEMICOLON) {
+      eat(ctx, SB_SEMICOLON);
+      compileParam(ctx);
     }
-    eat(SB_RPAR);
+    eat(ctx, SB_RPAR);
   }
 }
 
-void compileParam(void) {
+void compileParam(CompilerContext *ctx) {
   Object* param;
   Type* type;
   enum ParamKind paramKind;
 
-  switch (lookAhead->tokenType) {
+  switch (ctx->lookAhead->tokenType) {
   case TK_IDENT:
     paramKind = PARAM_VALUE;
     break;
   case KW_VAR:
-    eat(KW_VAR);
+    eat(ctx, KW_VAR);
     paramKind = PARAM_REFERENCE;
     break;
   default:
-    error(ERR_INVALID_PARAMETER, lookAhead->lineNo, lookAhead->colNo);
+    error(ctx, ERR_INVALID_PARAMETER, ctx->lookAhead->pos);
     break;
   }
 
-  eat(TK_IDENT);
-  checkFreshIdent(currentToken->string);
-  param = createParameterObject(currentToken->string, paramKind, symtab->currentScope->owner);
-  eat(SB_COLON);
-  type = compileBasicType();
-  param->paramAttrs->type = type;
-  declareObject(param);
+  eat(ctx, TK_IDENT);
+  checkFreshIdent(ctx, ctx->currentToken->value);
+  param = createParameterObject(ctx, ctx->currentToken->value, paramKind, ctx->symtab->currentScope->owner);
+  eat(ctx, SB_COLON);
+  type = compileBasicType(ctx);
+  param->paramAttrs.type = type;
+  declareObject(ctx, param);
+}
+
+/* The statements and expressions are built into ctx->ast. Names are
+ * resolved and types checked here, where the one-pass compiler did, so
+ * that the first error in the source is the one reported.
+ */
+#define node(ref) astAt(&ctx->ast, (ref))
+
+static AstRef makeNode(CompilerContext *ctx, enum AstKind kind, int pos, AstRef child0, AstRef child1, AstRef child2) {
+  AstRef ref = newAstNode(&ctx->ast, kind, pos);
+  AstNode *n = node(ref);
+
+  n->child[0] = child0;
+  n->child[1] = child1;
+  n->child[2] = child2;
+  return ref;
+}
+
+static AstRef makeOperator(CompilerContext *ctx, enum AstKind kind, TokenType op, AstRef left, AstRef right) {
+  AstRef ref = makeNode(ctx, kind, ctx->currentToken->pos, left, right, NO_NODE);
+
+  node(ref)->op = op;
+  return ref;
 }
 
-void compileStatements(void) {
-  compileStatement();
-  while (lookAhead->tokenType == SB_SEMICOLON) {
-    eat(SB_SEMICOLON);
-    compileStatement();
+AstRef compileStatements(CompilerContext *ctx) {
+  AstRef first, last, statement;
+
+  first = last = compileStatement(ctx);
+  while (ctx->lookAhead->tokenType == SB_SEMICOLON) {
+    eat(ctx, SB_SEMICOLON);
+    statement = compileStatement(ctx);
+    /* empty statements leave no node */
+    if (statement == NO_NODE) continue;
+    if (last == NO_NODE) first = statement;
+    else node(last)->next = statement;
+    last = statement;
   }
+  return first;
 }
 
-void compileStatement(void) {
-  switch (lookAhead->tokenType) {
+AstRef compileStatement(CompilerContext *ctx) {
+  AstRef statement = NO_NODE;
+
+  switch (ctx->lookAhead->tokenType) {
   case TK_IDENT:
-    compileAssignSt();
+    statement = compileAssignSt(ctx);
     break;
   case KW_CALL:
-    compileCallSt();
+    statement = compileCallSt(ctx);
     break;
   case KW_BEGIN:
-    compileGroupSt();
+    statement = compileGroupSt(ctx);
     break;
   case KW_IF:
-    compileIfSt();
+    statement = compileIfSt(ctx);
     break;
   case KW_WHILE:
-    compileWhileSt();
+    statement = compileWhileSt(ctx);
     break;
   case KW_FOR:
-    compileForSt();
+    statement = compileForSt(ctx);
     break;
     // EmptySt needs to check FOLLOW tokens
   case SB_SEMICOLON:
@@ -404,189 +443,210 @@ void compileStatement(void) {
     break;
     // Error occurs
   default:
-    error(ERR_INVALID_STATEMENT, lookAhead->lineNo, lookAhead->colNo);
+    error(ctx, ERR_INVALID_STATEMENT, ctx->lookAhead->pos);
     break;
   }
+  return statement;
 }
 
-Type* compileLValue(void) {
+AstRef compileLValue(CompilerContext *ctx) {
   /* parse a lvalue (a variable, an array element, a parameter, the current function identifier)
-   * return the lvalue's type
+   * return the lvalue's node
    */
   Object* obj;
-  Type* type;
+  AstRef lvalue;
 
-  eat(TK_IDENT);
+  eat(ctx, TK_IDENT);
 
   /* check if the identifier is a function identifier, or a variable identifier, or a parameter */
-  obj = checkDeclaredLValueIdent(currentToken->string);
+  obj = checkDeclaredLValueIdent(ctx, ctx->currentToken->value);
 
   switch (obj->kind) {
   case OBJ_VARIABLE:
-    type = obj->varAttrs->type;
-    break;
   case OBJ_PARAMETER:
-    type = obj->paramAttrs->type;
-    break;
   case OBJ_FUNCTION:
     /* only the current function identifier can appear as an lvalue */
-    type = obj->funcAttrs->returnType;
     break;
   default:
-    error(ERR_INVALID_LVALUE, currentToken->lineNo, currentToken->colNo);
-    type = NULL;
+    error(ctx, ERR_INVALID_LVALUE, ctx->currentToken->pos);
     break;
   }
+  lvalue = newAstObjectNode(&ctx->ast, AST_VARIABLE, ctx->currentToken->pos, obj);
 
   /* array element */
-  if (lookAhead->tokenType == SB_LSEL) {
-    type = compileIndexes(type);
+  if (ctx->lookAhead->tokenType == SB_LSEL) {
+    lvalue = compileIndexes(ctx, lvalue);
   }
 
-  return type;
+  return lvalue;
 }
 
-void compileAssignSt(void) {
-  /* parse the assignment and check type consistency */
-  Type* lType;
-  Type* rType;
+AstRef compileAssignSt(CompilerContext *ctx) {
+  AstRef lvalue, expr;
 
-  lType = compileLValue();
-  eat(SB_ASSIGN);
-  rType = compileExpression();
+  lvalue = compileLValue(ctx);
+  eat(ctx, SB_ASSIGN);
+  expr = compileExpression(ctx);
 
   /* In this language, assignment is only allowed between basic types */
-  checkBasicType(lType);
-  checkBasicType(rType);
-  checkTypeEquality(lType, rType);
+  checkBasicType(ctx, expressionType(ctx, lvalue), ctx->currentToken->pos);
+  checkBasicType(ctx, expressionType(ctx, expr), ctx->currentToken->pos);
+  checkTypeEquality(ctx, expressionType(ctx, lvalue), expressionType(ctx, expr), ctx->currentToken->pos);
+
+  return makeNode(ctx, AST_ASSIGN, ctx->currentToken->pos, lvalue, expr, NO_NODE);
 }
 
-void compileCallSt(void) {
+AstRef compileCallSt(CompilerContext *ctx) {
   Object* proc;
+  AstRef call, args;
+  int pos;
 
-  eat(KW_CALL);
-  eat(TK_IDENT);
+  eat(ctx, KW_CALL);
+  eat(ctx, TK_IDENT);
 
-  proc = checkDeclaredProcedure(currentToken->string);
+  proc = checkDeclaredProcedure(ctx, ctx->currentToken->value);
+  pos = ctx->currentToken->pos;
 
-  compileArguments(proc->procAttrs->paramList);
+  args = compileArguments(ctx, proc->procAttrs.paramList);
+  call = newAstObjectNode(&ctx->ast, AST_CALL, pos, proc);
+  node(call)->child[0] = args;
+  return call;
 }
 
-void compileGroupSt(void) {
-  eat(KW_BEGIN);
-  compileStatements();
-  eat(KW_END);
+AstRef compileGroupSt(CompilerContext *ctx) {
+  AstRef statements;
+  int pos;
+
+  eat(ctx, KW_BEGIN);
+  pos = ctx->currentToken->pos;
+  statements = compileStatements(ctx);
+  eat(ctx, KW_END);
+  return makeNode(ctx, AST_GROUP, pos, statements, NO_NODE, NO_NODE);
 }
 
-void compileIfSt(void) {
-  eat(KW_IF);
-  compileCondition();
-  eat(KW_THEN);
-  compileStatement();
-  if (lookAhead->tokenType == KW_ELSE) 
-    compileElseSt();
+AstRef compileIfSt(CompilerContext *ctx) {
+  AstRef condition, thenSt, elseSt = NO_NODE;
+  int pos;
+
+  eat(ctx, KW_IF);
+  pos = ctx->currentToken->pos;
+  condition = compileCondition(ctx);
+  eat(ctx, KW_THEN);
+  thenSt = compileStatement(ctx);
+  if (ctx->lookAhead->tokenType == KW_ELSE)
+    elseSt = compileElseSt(ctx);
+  return makeNode(ctx, AST_IF, pos, condition, thenSt, elseSt);
 }
 
-void compileElseSt(void) {
-  eat(KW_ELSE);
-  compileStatement();
+AstRef compileElseSt(CompilerContext *ctx) {
+  eat(ctx, KW_ELSE);
+  return compileStatement(ctx);
 }
 
-void compileWhileSt(void) {
-  eat(KW_WHILE);
-  compileCondition();
-  eat(KW_DO);
-  compileStatement();
+AstRef compileWhileSt(CompilerContext *ctx) {
+  AstRef condition, body;
+  int pos;
+
+  eat(ctx, KW_WHILE);
+  pos = ctx->currentToken->pos;
+  condition = compileCondition(ctx);
+  eat(ctx, KW_DO);
+  body = compileStatement(ctx);
+  return makeNode(ctx, AST_WHILE, pos, condition, body, NO_NODE);
 }
 
-void compileForSt(void) {
-  /* Check type consistency of FOR's variable */
+AstRef compileForSt(CompilerContext *ctx) {
   Object* var;
-  Type* varType;
-  Type* type1;
-  Type* type2;
+  AstRef from, to, body, st;
+  int pos;
 
-  eat(KW_FOR);
-  eat(TK_IDENT);
+  eat(ctx, KW_FOR);
+  eat(ctx, TK_IDENT);
 
   // check if the identifier is a variable
-  var = checkDeclaredVariable(currentToken->string);
-  varType = var->varAttrs->type;
-  checkBasicType(varType);
+  var = checkDeclaredVariable(ctx, ctx->currentToken->value);
+  pos = ctx->currentToken->pos;
+  checkBasicType(ctx, var->varAttrs.type, ctx->currentToken->pos);
 
-  eat(SB_ASSIGN);
-  type1 = compileExpression();
-  checkBasicType(type1);
-  checkTypeEquality(varType, type1);
+  /* both bounds have the type of the variable */
+  eat(ctx, SB_ASSIGN);
+  from = compileExpression(ctx);
+  checkBasicType(ctx, expressionType(ctx, from), ctx->currentToken->pos);
+  checkTypeEquality(ctx, var->varAttrs.type, expressionType(ctx, from), ctx->currentToken->pos);
 
-  eat(KW_TO);
-  type2 = compileExpression();
-  checkBasicType(type2);
-  checkTypeEquality(varType, type2);
+  eat(ctx, KW_TO);
+  to = compileExpression(ctx);
+  checkBasicType(ctx, expressionType(ctx, to), ctx->currentToken->pos);
+  checkTypeEquality(ctx, var->varAttrs.type, expressionType(ctx, to), ctx->currentToken->pos);
 
-  eat(KW_DO);
-  compileStatement();
+  eat(ctx, KW_DO);
+  body = compileStatement(ctx);
+
+  st = newAstObjectNode(&ctx->ast, AST_FOR, pos, var);
+  node(st)->child[0] = from;
+  node(st)->child[1] = to;
+  node(st)->child[2] = body;
+  return st;
 }
 
-void compileArgument(Object* param) {
-  /* parse an argument, and check type consistency
+AstRef compileArgument(CompilerContext *ctx, Object* param) {
+  AstRef arg;
+
+  /* parse an argument
    * If the corresponding parameter is a reference, the argument must be a lvalue
    */
-  Type* argType;
-  Type* paramType;
-
   if (param == NULL || param->kind != OBJ_PARAMETER) {
-    error(ERR_PARAMETERS_ARGUMENTS_INCONSISTENCY, lookAhead->lineNo, lookAhead->colNo);
-    return;
+    error(ctx, ERR_PARAMETERS_ARGUMENTS_INCONSISTENCY, ctx->lookAhead->pos);
+    return NO_NODE;
   }
 
-  paramType = param->paramAttrs->type;
+  if (param->paramAttrs.kind == PARAM_REFERENCE)
+    arg = compileLValue(ctx);
+  else arg = compileExpression(ctx);
 
-  if (param->paramAttrs->kind == PARAM_REFERENCE) {
-    argType = compileLValue();
-  } else {
-    argType = compileExpression();
-  }
-
-  checkTypeEquality(paramType, argType);
+  checkTypeEquality(ctx, param->paramAttrs.type, expressionType(ctx, arg), ctx->currentToken->pos);
+  return arg;
 }
 
-void compileArguments(ObjectNode* paramList) {
-  /* parse a list of arguments, check the consistency of the arguments and the given parameters */
+AstRef compileArguments(CompilerContext *ctx, ObjectNode* paramList) {
+  /* parse a list of arguments, check the number of the arguments against the given parameters */
   ObjectNode* curParam = paramList;
+  AstRef first = NO_NODE, last = NO_NODE, arg;
 
-  switch (lookAhead->tokenType) {
+  switch (ctx->lookAhead->tokenType) {
   case SB_LPAR:
-    eat(SB_LPAR);
+    eat(ctx, SB_LPAR);
 
     /* At least one argument appears, so we must have at least one parameter */
     if (curParam == NULL) {
-      error(ERR_PARAMETERS_ARGUMENTS_INCONSISTENCY, lookAhead->lineNo, lookAhead->colNo);
+      error(ctx, ERR_PARAMETERS_ARGUMENTS_INCONSISTENCY, ctx->lookAhead->pos);
     } else {
-      compileArgument(curParam->object);
+      first = last = compileArgument(ctx, curParam->object);
       curParam = curParam->next;
     }
 
-    while (lookAhead->tokenType == SB_COMMA) {
-      eat(SB_COMMA);
+    while (ctx->lookAhead->tokenType == SB_COMMA) {
+      eat(ctx, SB_COMMA);
       if (curParam == NULL) {
-        error(ERR_PARAMETERS_ARGUMENTS_INCONSISTENCY, lookAhead->lineNo, lookAhead->colNo);
+        error(ctx, ERR_PARAMETERS_ARGUMENTS_INCONSISTENCY, ctx->lookAhead->pos);
         /* still parse to recover */
-        compileExpression();
+        compileExpression(ctx);
       } else {
-        compileArgument(curParam->object);
+        arg = compileArgument(ctx, curParam->object);
+        node(last)->next = arg;
+        last = arg;
         curParam = curParam->next;
       }
     }
-    
-    eat(SB_RPAR);
+
+    eat(ctx, SB_RPAR);
 
     /* Too few arguments */
     if (curParam != NULL) {
-      error(ERR_PARAMETERS_ARGUMENTS_INCONSISTENCY, lookAhead->lineNo, lookAhead->colNo);
+      error(ctx, ERR_PARAMETERS_ARGUMENTS_INCONSISTENCY, ctx->lookAhead->pos);
     }
     break;
-    // Check FOLLOW set 
+    // Check FOLLOW set
   case SB_TIMES:
   case SB_SLASH:
   case SB_PLUS:
@@ -610,103 +670,84 @@ void compileArguments(ObjectNode* paramList) {
      * If the procedure/function expects parameters, it's an inconsistency.
      */
     if (paramList != NULL) {
-      error(ERR_PARAMETERS_ARGUMENTS_INCONSISTENCY, lookAhead->lineNo, lookAhead->colNo);
+      error(ctx, ERR_PARAMETERS_ARGUMENTS_INCONSISTENCY, ctx->lookAhead->pos);
     }
     break;
   default:
-    error(ERR_INVALID_ARGUMENTS, lookAhead->lineNo, lookAhead->colNo);
+    error(ctx, ERR_INVALID_ARGUMENTS, ctx->lookAhead->pos);
   }
+  return first;
 }
 
-void compileCondition(void) {
-  /* check the type consistency of LHS and RHS, check the basic type */
-  Type* type1;
-  Type* type2;
+AstRef compileCondition(CompilerContext *ctx) {
+  AstRef expr1, expr2;
+  TokenType op;
 
-  type1 = compileExpression();
+  expr1 = compileExpression(ctx);
 
-  switch (lookAhead->tokenType) {
+  op = ctx->lookAhead->tokenType;
+  switch (op) {
   case SB_EQ:
-    eat(SB_EQ);
-    break;
   case SB_NEQ:
-    eat(SB_NEQ);
-    break;
   case SB_LE:
-    eat(SB_LE);
-    break;
   case SB_LT:
-    eat(SB_LT);
-    break;
   case SB_GE:
-    eat(SB_GE);
-    break;
   case SB_GT:
-    eat(SB_GT);
+    eat(ctx, op);
     break;
   default:
-    error(ERR_INVALID_COMPARATOR, lookAhead->lineNo, lookAhead->colNo);
+    error(ctx, ERR_INVALID_COMPARATOR, ctx->lookAhead->pos);
   }
 
-  type2 = compileExpression();
+  expr2 = compileExpression(ctx);
 
-  checkBasicType(type1);
-  checkBasicType(type2);
-  checkTypeEquality(type1, type2);
+  checkBasicType(ctx, expressionType(ctx, expr1), ctx->currentToken->pos);
+  checkBasicType(ctx, expressionType(ctx, expr2), ctx->currentToken->pos);
+  checkTypeEquality(ctx, expressionType(ctx, expr1), expressionType(ctx, expr2), ctx->currentToken->pos);
+  return makeOperator(ctx, AST_COMPARE, op, expr1, expr2);
 }
 
-Type* compileExpression(void) {
-  Type* type;
-  
-  switch (lookAhead->tokenType) {
+AstRef compileExpression(CompilerContext *ctx) {
+  AstRef expr;
+  TokenType op = ctx->lookAhead->tokenType;
+
+  switch (op) {
   case SB_PLUS:
-    eat(SB_PLUS);
-    type = compileExpression2();
-    checkIntType(type);
-    break;
   case SB_MINUS:
-    eat(SB_MINUS);
-    type = compileExpression2();
-    checkIntType(type);
+    eat(ctx, op);
+    expr = compileExpression2(ctx);
+    checkIntType(ctx, expressionType(ctx, expr), ctx->currentToken->pos);
+    expr = makeOperator(ctx, AST_UNARY, op, expr, NO_NODE);
     break;
   default:
-    type = compileExpression2();
+    expr = compileExpression2(ctx);
   }
-  return type;
+  return expr;
 }
 
-Type* compileExpression2(void) {
-  Type* type;
+AstRef compileExpression2(CompilerContext *ctx) {
+  AstRef term;
 
-  type = compileTerm();
+  term = compileTerm(ctx);
 
   /* If there is + or - after the first term, it's an integer expression */
-  if (lookAhead->tokenType == SB_PLUS || lookAhead->tokenType == SB_MINUS) {
-    checkIntType(type);
-    compileExpression3();
-    return intType;
-  }
-
-  compileExpression3();
-  return type;
+  if (ctx->lookAhead->tokenType == SB_PLUS || ctx->lookAhead->tokenType == SB_MINUS)
+    checkIntType(ctx, expressionType(ctx, term), ctx->currentToken->pos);
+  return compileExpression3(ctx, term);
 }
 
-void compileExpression3(void) {
-  Type* type;
+AstRef compileExpression3(CompilerContext *ctx, AstRef left) {
+  /* the operators are left associative: left is the expression so far */
+  AstRef term;
+  TokenType op = ctx->lookAhead->tokenType;
 
-  switch (lookAhead->tokenType) {
+  switch (op) {
   case SB_PLUS:
-    eat(SB_PLUS);
-    type = compileTerm();
-    checkIntType(type);
-    compileExpression3();
-    break;
   case SB_MINUS:
-    eat(SB_MINUS);
-    type = compileTerm();
-    checkIntType(type);
-    compileExpression3();
-    break;
+    eat(ctx, op);
+    term = compileTerm(ctx);
+    checkIntType(ctx, expressionType(ctx, term), ctx->currentToken->pos);
+    return compileExpression3(ctx, makeOperator(ctx, AST_BINARY, op, left, term));
     // check the FOLLOW set
   case KW_TO:
   case KW_DO:
@@ -725,42 +766,33 @@ void compileExpression3(void) {
   case KW_THEN:
     break;
   default:
-    error(ERR_INVALID_EXPRESSION, lookAhead->lineNo, lookAhead->colNo);
+    error(ctx, ERR_INVALID_EXPRESSION, ctx->lookAhead->pos);
   }
+  return left;
 }
 
-Type* compileTerm(void) {
-  Type* type;
+AstRef compileTerm(CompilerContext *ctx) {
+  AstRef factor;
 
-  type = compileFactor();
+  factor = compileFactor(ctx);
 
   /* If there is * or / after the first factor, it's an integer term */
-  if (lookAhead->tokenType == SB_TIMES || lookAhead->tokenType == SB_SLASH) {
-    checkIntType(type);
-    compileTerm2();
-    return intType;
-  }
-
-  compileTerm2();
-  return type;
+  if (ctx->lookAhead->tokenType == SB_TIMES || ctx->lookAhead->tokenType == SB_SLASH)
+    checkIntType(ctx, expressionType(ctx, factor), ctx->currentToken->pos);
+  return compileTerm2(ctx, factor);
 }
 
-void compileTerm2(void) {
-  Type* type;
+AstRef compileTerm2(CompilerContext *ctx, AstRef left) {
+  AstRef factor;
+  TokenType op = ctx->lookAhead->tokenType;
 
-  switch (lookAhead->tokenType) {
+  switch (op) {
   case SB_TIMES:
-    eat(SB_TIMES);
-    type = compileFactor();
-    checkIntType(type);
-    compileTerm2();
-    break;
   case SB_SLASH:
-    eat(SB_SLASH);
-    type = compileFactor();
-    checkIntType(type);
-    compileTerm2();
-    break;
+    eat(ctx, op);
+    factor = compileFactor(ctx);
+    checkIntType(ctx, expressionType(ctx, factor), ctx->currentToken->pos);
+    return compileTerm2(ctx, makeOperator(ctx, AST_BINARY, op, left, factor));
     // check the FOLLOW set
   case SB_PLUS:
   case SB_MINUS:
@@ -781,101 +813,155 @@ void compileTerm2(void) {
   case KW_THEN:
     break;
   default:
-    error(ERR_INVALID_TERM, lookAhead->lineNo, lookAhead->colNo);
+    error(ctx, ERR_INVALID_TERM, ctx->lookAhead->pos);
   }
+  return left;
 }
 
-Type* compileFactor(void) {
-  /* parse a factor and return the factor's type */
+AstRef compileFactor(CompilerContext *ctx) {
+  /* parse a factor and return the factor's node */
   Object* obj;
-  Type* type;
+  AstRef factor = NO_NODE, args;
 
-  switch (lookAhead->tokenType) {
+  switch (ctx->lookAhead->tokenType) {
   case TK_NUMBER:
-    eat(TK_NUMBER);
-    type = intType;
+    eat(ctx, TK_NUMBER);
+    factor = newAstNode(&ctx->ast, AST_NUMBER, ctx->currentToken->pos);
+    node(factor)->value = ctx->currentToken->value;
     break;
   case TK_CHAR:
-    eat(TK_CHAR);
-    type = charType;
+    eat(ctx, TK_CHAR);
+    factor = newAstNode(&ctx->ast, AST_CHAR, ctx->currentToken->pos);
+    node(factor)->value = ctx->currentToken->value;
     break;
   case TK_IDENT:
-    eat(TK_IDENT);
+    eat(ctx, TK_IDENT);
     // check if the identifier is declared
-    obj = checkDeclaredIdent(currentToken->string);
+    obj = checkDeclaredIdent(ctx, ctx->currentToken->value);
 
     switch (obj->kind) {
     case OBJ_CONSTANT:
-      if (obj->constAttrs->value->type == TP_INT)
-        type = intType;
-      else
-        type = charType;
+      /* constants are replaced by their value */
+      if (obj->constAttrs.value.type == TP_INT) {
+        factor = newAstNode(&ctx->ast, AST_NUMBER, ctx->currentToken->pos);
+        node(factor)->value = obj->constAttrs.value.intValue;
+      } else {
+        factor = newAstNode(&ctx->ast, AST_CHAR, ctx->currentToken->pos);
+        node(factor)->value = obj->constAttrs.value.charValue;
+      }
       break;
     case OBJ_VARIABLE:
-      type = obj->varAttrs->type;
-      if (lookAhead->tokenType == SB_LSEL) {
-        type = compileIndexes(type);
+      factor = newAstObjectNode(&ctx->ast, AST_VARIABLE, ctx->currentToken->pos, obj);
+      if (ctx->lookAhead->tokenType == SB_LSEL) {
+        factor = compileIndexes(ctx, factor);
       }
       break;
     case OBJ_PARAMETER:
-      type = obj->paramAttrs->type;
+      factor = newAstObjectNode(&ctx->ast, AST_VARIABLE, ctx->currentToken->pos, obj);
       break;
     case OBJ_FUNCTION:
-      compileArguments(obj->funcAttrs->paramList);
-      type = obj->funcAttrs->returnType;
+      args = compileArguments(ctx, obj->funcAttrs.paramList);
+      factor = newAstObjectNode(&ctx->ast, AST_FCALL, ctx->currentToken->pos, obj);
+      node(factor)->child[0] = args;
       break;
-    default: 
-      error(ERR_INVALID_FACTOR,currentToken->lineNo, currentToken->colNo);
-      type = NULL;
+    default:
+      error(ctx, ERR_INVALID_FACTOR,ctx->currentToken->pos);
       break;
     }
     break;
   default:
-    error(ERR_INVALID_FACTOR, lookAhead->lineNo, lookAhead->colNo);
-    type = NULL;
+    error(ctx, ERR_INVALID_FACTOR, ctx->lookAhead->pos);
   }
-  
-  return type;
+
+  return factor;
 }
 
-Type* compileIndexes(Type* arrayType) {
-  /* parse a sequence of indexes, check the consistency to the arrayType,
-   * and return the element type
-   */
-  Type* idxType;
-  Type* curType = arrayType;
+AstRef compileIndexes(CompilerContext *ctx, AstRef array) {
+  /* parse a sequence of indexes and return the element's node */
+  AstRef index;
 
-  while (lookAhead->tokenType == SB_LSEL) {
-    checkArrayType(curType);
+  while (ctx->lookAhead->tokenType == SB_LSEL) {
+    checkArrayType(ctx, expressionType(ctx, array), ctx->currentToken->pos);
 
-    eat(SB_LSEL);
-    idxType = compileExpression();
-    checkIntType(idxType);
-    eat(SB_RSEL);
+    eat(ctx, SB_LSEL);
+    index = compileExpression(ctx);
+    checkIntType(ctx, expressionType(ctx, index), ctx->currentToken->pos);
+    eat(ctx, SB_RSEL);
 
-    curType = curType->elementType;
+    array = makeNode(ctx, AST_INDEX, ctx->currentToken->pos, array, index, NO_NODE);
   }
 
-  return curType;
+  return array;
 }
 
-int compile(char *fileName) {
-  if (openInputStream(fileName) == IO_ERROR)
-    return IO_ERROR;
+void initContext(CompilerContext *ctx, FILE *out) {
+  memset(ctx, 0, sizeof(CompilerContext));
+  ctx->out = out;
+}
+
+/* Release the memory a context keeps between compilations */
+void freeContext(CompilerContext *ctx) {
+  regionRelease(&ctx->region);
+  cleanAtoms(&ctx->atoms);
+  cleanAst(&ctx->ast);
+  memFree(ctx->tokenPos);
+  ctx->tokenPos = NULL;
+  ctx->tokenCapacity = 0;
+}
+
+/* Compile the open input. A diagnostic unwinds back here and is
+ * written to ctx->out, so the context is reusable whatever the outcome.
+ */
+int compileInput(CompilerContext *ctx) {
+  volatile int result = IO_SUCCESS;
 
-  currentToken = NULL;
-  lookAhead = getValidToken();
+  initSymTab(ctx);
+  resetAst(&ctx->ast);
 
-  initSymTab();
+  if (setjmp(ctx->errorJump) == 0) {
+    ctx->currentToken = NULL;
+    ctx->lookAhead = getValidToken(ctx, &ctx->tokenRing[0]);
 
-  compileProgram();
+    compileProgram(ctx);
+    if (ctx->code != NULL)
+      genCode(ctx, ctx->symtab->program);
+    if (ctx->regCode != NULL)
+      genRegCode(ctx, ctx->symtab->program);
+    if (ctx->assembly != NULL)
+      genAssembly(ctx, ctx->symtab->program);
 
-  printObject(symtab->program,0);
+    printObject(ctx, ctx->symtab->program,0);
+  } else {
+    printDiagnostic(ctx);
+    result = COMPILE_ERROR;
+  }
 
-  cleanSymTab();
+  cleanSymTab(ctx);
+  return result;
+}
+
+/* The region and the atom table of the context are kept for the next
+ * compilation. The cache holds no code, so generating code bypasses it.
+ */
+static int compileOpenInput(CompilerContext *ctx) {
+  int result;
+
+  if (ctx->cache != NULL && ctx->code == NULL && ctx->regCode == NULL && ctx->assembly == NULL)
+    result = compileCached(ctx);
+  else result = compileInput(ctx);
+
+  closeInputStream(ctx);
+  resetAtoms(&ctx->atoms);
+  return result;
+}
+
+int compile(CompilerContext *ctx, char *fileName) {
+  if (openInputStream(ctx, fileName) == IO_ERROR)
+    return IO_ERROR;
+  return compileOpenInput(ctx);
+}
 
-  free(currentToken);
-  free(lookAhead);
-  closeInputStream();
-  return IO_SUCCESS;
+int compileBuffer(CompilerContext *ctx, const char *buffer, size_t size) {
+  openInputBuffer(ctx, buffer, size);
+  return compileOpenInput(ctx);
 }
@@ -8,52 +8,59 @@
 #include "token.h"
 #include "symtab.h"
 
-void scan(void);
-void eat(TokenType tokenType);
+void scan(CompilerContext *ctx);
+void eat(CompilerContext *ctx, TokenType tokenType);
 
-void compileProgram(void);
-void compileBlock(void);
-void compileBlock2(void);
-void compileBlock3(void);
-void compileBlock4(void);
-void compileBlock5(void);
-void compileConstDecls(void);
-void compileConstDecl(void);
-void compileTypeDecls(void);
-void compileTypeDecl(void);
-void compileVarDecls(void);
-void compileVarDecl(void);
-void compileSubDecls(void);
-void compileFuncDecl(void);
-void compileProcDecl(void);
-ConstantValue* compileUnsignedConstant(void);
-ConstantValue* compileConstant(void);
-ConstantValue* compileConstant2(void);
-Type* compileType(void);
-Type* compileBasicType(void);
-void compileParams(void);
-void compileParam(void);
-void compileStatements(void);
-void compileStatement(void);
-Type* compileLValue(void);
-void compileAssignSt(void);
-void compileCallSt(void);
-void compileGroupSt(void);
-void compileIfSt(void);
-void compileElseSt(void);
-void compileWhileSt(void);
-void compileForSt(void);
-void compileArgument(Object* param);
-void compileArguments(ObjectNode* paramList);
-void compileCondition(void);
-Type* compileExpression(void);
-Type* compileExpression2(void);
-void compileExpression3(void);
-Type* compileTerm(void);
-void compileTerm2(void);
-Type* compileFactor(void);
-Type* compileIndexes(Type* arrayType);
+void compileProgram(CompilerContext *ctx);
+AstRef compileBlock(CompilerContext *ctx);
+AstRef compileBlock2(CompilerContext *ctx);
+AstRef compileBlock3(CompilerContext *ctx);
+AstRef compileBlock4(CompilerContext *ctx);
+AstRef compileBlock5(CompilerContext *ctx);
+void compileConstDecls(CompilerContext *ctx);
+void compileConstDecl(CompilerContext *ctx);
+void compileTypeDecls(CompilerContext *ctx);
+void compileTypeDecl(CompilerContext *ctx);
+void compileVarDecls(CompilerContext *ctx);
+void compileVarDecl(CompilerContext *ctx);
+void compileSubDecls(CompilerContext *ctx);
+void compileFuncDecl(CompilerContext *ctx);
+void compileProcDecl(CompilerContext *ctx);
+ConstantValue compileUnsignedConstant(CompilerContext *ctx);
+ConstantValue compileConstant(CompilerContext *ctx);
+ConstantValue compileConstant2(CompilerContext *ctx);
+Type* compileType(CompilerContext *ctx);
+Type* compileBasicType(CompilerContext *ctx);
+void compileParams(CompilerContext *ctx);
+void compileParam(CompilerContext *ctx);
+AstRef compileStatements(CompilerContext *ctx);
+AstRef compileStatement(CompilerContext *ctx);
+AstRef compileLValue(CompilerContext *ctx);
+AstRef compileAssignSt(CompilerContext *ctx);
+AstRef compileCallSt(CompilerContext *ctx);
+AstRef compileGroupSt(CompilerContext *ctx);
+AstRef compileIfSt(CompilerContext *ctx);
+AstRef compileElseSt(CompilerContext *ctx);
+AstRef compileWhileSt(CompilerContext *ctx);
+AstRef compileForSt(CompilerContext *ctx);
+AstRef compileArgument(CompilerContext *ctx, Object* param);
+AstRef compileArguments(CompilerContext *ctx, ObjectNode* paramList);
+AstRef compileCondition(CompilerContext *ctx);
+AstRef compileExpression(CompilerContext *ctx);
+AstRef compileExpression2(CompilerContext *ctx);
+AstRef compileExpression3(CompilerContext *ctx, AstRef left);
+AstRef compileTerm(CompilerContext *ctx);
+AstRef compileTerm2(CompilerContext *ctx, AstRef left);
+AstRef compileFactor(CompilerContext *ctx);
+AstRef compileIndexes(CompilerContext *ctx, AstRef array);
 
-int compile(char *fileName);
+/* compile() returns IO_SUCCESS, IO_ERROR or COMPILE_ERROR */
+#define COMPILE_ERROR 2
+
+void initContext(CompilerContext *ctx, FILE *out);
+void freeContext(CompilerContext *ctx);
+int compileInput(CompilerContext *ctx);
+int compile(CompilerContext *ctx, char *fileName);
+int compileBuffer(CompilerContext *ctx, const char *buffer, size_t size);
 
 #endif
@@ -1,37 +1,146 @@
-/* 
+/*
  * @copyright (c) 2008, Hedspi, Hanoi University of Technology
  * @author Huu-Duc Nguyen
  * @version 1.0
  */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "alloc.h"
 #include "reader.h"
 
-FILE *inputStream;
-int lineNo, colNo;
-int currentChar;
+/* The whole input is kept in memory. A regular file is mapped; anything
+ * else (pipes, terminals, empty files) is read from inputStream into a
+ * heap buffer. The scanner walks inputPtr over the buffer and a token
+ * position is just the byte offset of its first character. The line
+ * start table is built on the first position query.
+ */
+
+static int mapInputStream(CompilerContext *ctx) {
+  struct stat st;
+  void *addr;
+
+  if (fstat(fileno(ctx->inputStream), &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0)
+    return IO_ERROR;
+
+  addr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fileno(ctx->inputStream), 0);
+  if (addr == MAP_FAILED)
+    return IO_ERROR;
+  madvise(addr, st.st_size, MADV_SEQUENTIAL);
+
+  ctx->inputSize = st.st_size;
+  ctx->inputBuffer = (const char*) addr;
+  ctx->inputMapped = 1;
+  return IO_SUCCESS;
+}
+
+static int slurpInputStream(CompilerContext *ctx) {
+  size_t capacity = 4096;
+  size_t n;
+  char *buffer = (char*) memAlloc(capacity);
 
-int readChar(void) {
-  currentChar = getc(inputStream);
-  colNo ++;
-  if (currentChar == '\n') {
-    lineNo ++;
-    colNo = 0;
+  ctx->inputSize = 0;
+  while ((n = fread(buffer + ctx->inputSize, 1, capacity - ctx->inputSize, ctx->inputStream)) > 0) {
+    ctx->inputSize += n;
+    if (ctx->inputSize == capacity) {
+      capacity *= 2;
+      buffer = (char*) memRealloc(buffer, capacity);
+    }
   }
-  return currentChar;
+
+  ctx->inputBuffer = buffer;
+  ctx->inputMapped = 0;
+  return IO_SUCCESS;
 }
 
-int openInputStream(char *fileName) {
-  inputStream = fopen(fileName, "rt");
-  if (inputStream == NULL)
+int openInputStreamMode(CompilerContext *ctx, char *fileName, int mode) {
+  ctx->inputStream = fopen(fileName, "rt");
+  if (ctx->inputStream == NULL)
     return IO_ERROR;
-  lineNo = 1;
-  colNo = 0;
-  readChar();
+
+  if (mode != INPUT_MODE_MMAP || mapInputStream(ctx) == IO_ERROR)
+    slurpInputStream(ctx);
+
+  ctx->inputPtr = ctx->inputBuffer;
+  ctx->inputEnd = ctx->inputBuffer + ctx->inputSize;
+  ctx->lineStarts = NULL;
+  ctx->lineCount = 0;
+  return IO_SUCCESS;
+}
+
+/* Compile from a buffer owned by the caller, which must stay unchanged
+ * until closeInputStream(); there is no stream then.
+ */
+int openInputBuffer(CompilerContext *ctx, const char *buffer, size_t size) {
+  ctx->inputStream = NULL;
+  ctx->inputBuffer = buffer;
+  ctx->inputSize = size;
+  ctx->inputMapped = 0;
+
+  ctx->inputPtr = ctx->inputBuffer;
+  ctx->inputEnd = ctx->inputBuffer + ctx->inputSize;
+  ctx->lineStarts = NULL;
+  ctx->lineCount = 0;
   return IO_SUCCESS;
 }
 
-void closeInputStream() {
-  fclose(inputStream);
+int openInputStream(CompilerContext *ctx, char *fileName) {
+  return openInputStreamMode(ctx, fileName, INPUT_MODE_MMAP);
+}
+
+void closeInputStream(CompilerContext *ctx) {
+  if (ctx->inputMapped)
+    munmap((void*) ctx->inputBuffer, ctx->inputSize);
+  else if (ctx->inputStream != NULL)
+    memFree((void*) ctx->inputBuffer);
+  ctx->inputBuffer = NULL;
+  memFree(ctx->lineStarts);
+  ctx->lineStarts = NULL;
+  if (ctx->inputStream != NULL)
+    fclose(ctx->inputStream);
+}
+
+/******************************************************************/
+
+/* One pass over the buffer; memchr does the vectorized newline search. */
+static void buildLineStarts(CompilerContext *ctx) {
+  int capacity = 256;
+  const char *p = ctx->inputBuffer;
+  const char *nl;
+
+  ctx->lineStarts = (int*) memAlloc(capacity * sizeof(int));
+  ctx->lineStarts[0] = 0;
+  ctx->lineCount = 1;
+
+  while ((nl = memchr(p, '\n', ctx->inputEnd - p)) != NULL) {
+    if (ctx->lineCount == capacity) {
+      capacity *= 2;
+      ctx->lineStarts = (int*) memRealloc(ctx->lineStarts, capacity * sizeof(int));
+    }
+    p = nl + 1;
+    ctx->lineStarts[ctx->lineCount++] = p - ctx->inputBuffer;
+  }
 }
 
+void positionOf(CompilerContext *ctx, int pos, int *lineNo, int *colNo) {
+  int lo = 0, hi, mid;
+
+  if (ctx->lineStarts == NULL)
+    buildLineStarts(ctx);
+
+  /* the last line starting at or before pos */
+  hi = ctx->lineCount - 1;
+  while (lo < hi) {
+    mid = (lo + hi + 1) / 2;
+    if (ctx->lineStarts[mid] <= pos) lo = mid;
+    else hi = mid - 1;
+  }
+
+  *lineNo = lo + 1;
+  *colNo = pos - ctx->lineStarts[lo] + 1;
+}
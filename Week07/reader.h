@@ -1,4 +1,4 @@
-/* 
+/*
  * @copyright (c) 2008, Hedspi, Hanoi University of Technology
  * @author Huu-Duc Nguyen
  * @version 1.0
@@ -7,11 +7,19 @@
 #ifndef __READER_H__
 #define __READER_H__
 
+#include "context.h"
+
 #define IO_ERROR 0
 #define IO_SUCCESS 1
 
-int readChar(void);
-int openInputStream(char *fileName);
-void closeInputStream(void);
+#define INPUT_MODE_MMAP 0
+#define INPUT_MODE_STREAM 1
+
+int openInputStream(CompilerContext *ctx, char *fileName);
+int openInputBuffer(CompilerContext *ctx, const char *buffer, size_t size);
+int openInputStreamMode(CompilerContext *ctx, char *fileName, int mode);
+void closeInputStream(CompilerContext *ctx);
+
+void positionOf(CompilerContext *ctx, int pos, int *lineNo, int *colNo);
 
 #endif
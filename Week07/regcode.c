@@ -0,0 +1,80 @@
+/* Register machine instructions
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "alloc.h"
+#include "regcode.h"
+
+const unsigned char regOperands[REG_COUNT] = {
+  [REG_MOV] = 2, [REG_LDC] = 2, [REG_ADD] = 3, [REG_ADDK] = 3, [REG_SUB] = 3,
+  [REG_MUL] = 3, [REG_DIV] = 3, [REG_NEG] = 2, [REG_LDU] = 3, [REG_STU] = 3,
+  [REG_LEA] = 3, [REG_LDI] = 2, [REG_STI] = 2, [REG_CHK] = 2, [REG_IXA] = 3,
+  [REG_J] = 1, [REG_JEQ] = 3, [REG_JNE] = 3, [REG_JLT] = 3, [REG_JLE] = 3,
+  [REG_JGT] = 3, [REG_JGE] = 3, [REG_CALL] = 3, [REG_ENTER] = 1,
+  [REG_RC] = 1, [REG_RI] = 1, [REG_WRC] = 1, [REG_WRI] = 1
+};
+
+static const char *const regOpNames[REG_COUNT] = {
+  "MOV", "LDC", "ADD", "ADDK", "SUB", "MUL", "DIV", "NEG", "LDU", "STU",
+  "LEA", "LDI", "STI", "CHK", "IXA", "J", "JEQ", "JNE", "JLT", "JLE",
+  "JGT", "JGE", "CALL", "ENTER", "RET", "HL", "RC", "RI", "WRC", "WRI", "WLN"
+};
+
+int emitReg(RegCode *block, RegOpCode op, int a, int b, int c) {
+  RegInstruction *at;
+
+  if (block->size == block->capacity) {
+    block->capacity = block->capacity == 0 ? 256 : block->capacity * 2;
+    block->code = (RegInstruction*) memRealloc(block->code, block->capacity * sizeof(RegInstruction));
+  }
+  at = block->code + block->size;
+  at->op = op;
+  at->a = a;
+  at->b = b;
+  at->c = c;
+  return block->size++;
+}
+
+void patchReg(RegCode *block, int index, int q) {
+  RegInstruction *at = block->code + index;
+
+  switch (regOperands[at->op]) {
+  case 1:
+    at->a = q;
+    break;
+  case 2:
+    at->b = q;
+    break;
+  default:
+    at->c = q;
+    break;
+  }
+}
+
+const char *regOpName(RegOpCode op) {
+  return op < REG_COUNT ? regOpNames[op] : "?";
+}
+
+void printRegCode(RegCode *block, FILE *out) {
+  RegInstruction *at;
+  int i;
+
+  for (i = 0; i < block->size; i++) {
+    at = block->code + i;
+    fprintf(out, "%6d:  %s", i, regOpName(at->op));
+    if (regOperands[at->op] >= 1) fprintf(out, " %d", at->a);
+    if (regOperands[at->op] >= 2) fprintf(out, " %d", at->b);
+    if (regOperands[at->op] >= 3) fprintf(out, " %d", at->c);
+    fprintf(out, "\n");
+  }
+}
+
+void cleanRegCode(RegCode *block) {
+  memFree(block->code);
+  memset(block, 0, sizeof(RegCode));
+}
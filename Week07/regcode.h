@@ -0,0 +1,86 @@
+/* Register machine instructions
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#ifndef __REGCODE_H__
+#define __REGCODE_H__
+
+#include <stdio.h>
+#include "instructions.h"
+
+/* The register machine keeps its frames on a stack of words laid out
+ * like those of the stack machine, RV, DL, RA and SL first, but it has
+ * no evaluation stack: register r is the word b+r of the running frame,
+ * and the instructions name their operands. The parameters and the
+ * variables of a block are registers, and the temporaries of its
+ * expressions are the registers after them.
+ *
+ * An instruction has up to three operands a, b and c; r[x] stands for
+ * register x. p is a static level, as for the stack machine, and a jump
+ * target is the index of an instruction.
+ */
+typedef enum {
+  REG_MOV,    /* MOV a b: r[a] = r[b] */
+  REG_LDC,    /* LDC a k: r[a] = k */
+  REG_ADD,    /* ADD a b c: r[a] = r[b] + r[c] */
+  REG_ADDK,   /* ADDK a b k: r[a] = r[b] + k */
+  REG_SUB,
+  REG_MUL,
+  REG_DIV,
+  REG_NEG,    /* NEG a b: r[a] = -r[b] */
+  REG_LDU,    /* LDU a p q: r[a] = the word at q in frame p */
+  REG_STU,    /* STU a p q: the word at q in frame p = r[a] */
+  REG_LEA,    /* LEA a p q: r[a] = the address of q in frame p */
+  REG_LDI,    /* LDI a b: r[a] = the word at the address r[b] */
+  REG_STI,    /* STI a b: the word at the address r[a] = r[b] */
+  REG_CHK,    /* CHK a n: check that 1 <= r[a] <= n */
+  REG_IXA,    /* IXA a b q: r[a] += (r[b] - 1) * q */
+  REG_J,      /* J q: jump to q */
+  REG_JEQ,    /* JEQ a b q: jump to q if r[a] = r[b] */
+  REG_JNE,
+  REG_JLT,
+  REG_JLE,
+  REG_JGT,
+  REG_JGE,
+  REG_CALL,   /* CALL a p q: call the code at q with its frame at
+               * register a, p the level of its block */
+  REG_ENTER,  /* ENTER n: the running block uses n registers */
+  REG_RET,    /* return, the result of a function in its RV */
+  REG_HL,     /* halt */
+  REG_RC,     /* RC a: r[a] = a character read */
+  REG_RI,     /* RI a: r[a] = an integer read */
+  REG_WRC,    /* WRC a: write r[a] as a character */
+  REG_WRI,    /* WRI a: write r[a] */
+  REG_WLN,    /* write a new line */
+  REG_COUNT
+} RegOpCode;
+
+typedef struct {
+  int op;
+  int a, b, c;
+} RegInstruction;
+
+/* The code of a program, from instruction 0 */
+typedef struct RegCode_ {
+  RegInstruction *code;
+  int size;
+  int capacity;
+} RegCode;
+
+/* The number of operands of each opcode */
+extern const unsigned char regOperands[REG_COUNT];
+
+/* Append an instruction and return its index */
+int emitReg(RegCode *block, RegOpCode op, int a, int b, int c);
+/* Set the last operand of the instruction at index, a jump target or
+ * the size of a frame
+ */
+void patchReg(RegCode *block, int index, int q);
+
+const char *regOpName(RegOpCode op);
+void printRegCode(RegCode *block, FILE *out);
+void cleanRegCode(RegCode *block);
+
+#endif
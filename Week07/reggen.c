@@ -0,0 +1,437 @@
+/* Register code generation
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#include <stdlib.h>
+#include "codegen.h"
+#include "reggen.h"
+
+/* A scalar variable or value parameter of the running block is its own
+ * register. Words of other frames are reached by LDU and STU, array
+ * elements and the arguments of reference parameters by address. The
+ * temporaries of a statement are taken above the variables, like a
+ * stack, and all given back at its end.
+ */
+typedef struct {
+  CompilerContext *ctx;
+  RegCode *code;
+  int top;                      /* the first free register */
+  int frameSize;                /* the registers the block needs */
+} RegGen;
+
+/* Where a scalar is */
+typedef enum {
+  LOC_REGISTER,                 /* in register reg */
+  LOC_FRAME,                    /* at offset in the frame level out */
+  LOC_ADDRESS                   /* at the address in register reg */
+} LocationKind;
+
+typedef struct {
+  LocationKind kind;
+  int reg;
+  int level;
+  int offset;
+} Location;
+
+#define node(ref) astAt(&g->ctx->ast, (ref))
+#define emit(op, a, b, c) emitReg(g->code, (op), (a), (b), (c))
+
+static void genInto(RegGen *g, AstRef expr, int target);
+static void genStatements(RegGen *g, AstRef statement);
+
+static int newRegister(RegGen *g) {
+  if (++g->top > g->frameSize) g->frameSize = g->top;
+  return g->top - 1;
+}
+
+static void locate(RegGen *g, Object* obj, Location *loc) {
+  Scope* scope = slotOf(obj, &loc->offset);
+
+  loc->level = levelOf(g->ctx, scope);
+  if (isReferenceParameter(obj)) {
+    loc->kind = LOC_ADDRESS;
+    if (loc->level == 0) loc->reg = loc->offset;
+    else {
+      loc->reg = newRegister(g);
+      emit(REG_LDU, loc->reg, loc->level, loc->offset);
+    }
+  } else if (loc->level == 0) {
+    loc->kind = LOC_REGISTER;
+    loc->reg = loc->offset;
+  } else loc->kind = LOC_FRAME;
+}
+
+static void load(RegGen *g, Location *loc, int target) {
+  switch (loc->kind) {
+  case LOC_REGISTER:
+    if (loc->reg != target) emit(REG_MOV, target, loc->reg, 0);
+    break;
+  case LOC_FRAME:
+    emit(REG_LDU, target, loc->level, loc->offset);
+    break;
+  default:
+    emit(REG_LDI, target, loc->reg, 0);
+    break;
+  }
+}
+
+static void store(RegGen *g, Location *loc, int value) {
+  switch (loc->kind) {
+  case LOC_REGISTER:
+    if (loc->reg != value) emit(REG_MOV, loc->reg, value, 0);
+    break;
+  case LOC_FRAME:
+    emit(REG_STU, value, loc->level, loc->offset);
+    break;
+  default:
+    emit(REG_STI, loc->reg, value, 0);
+    break;
+  }
+}
+
+/* Whether evaluating expr may call a function, which may assign the
+ * variables of the blocks around it
+ */
+static int hasCall(RegGen *g, AstRef expr) {
+  AstNode *n;
+
+  if (expr == NO_NODE) return 0;
+  n = node(expr);
+  switch (n->kind) {
+  case AST_FCALL:
+    return astObjectAt(&g->ctx->ast, n)->funcAttrs.scope != NULL;
+  case AST_INDEX:
+  case AST_UNARY:
+  case AST_BINARY:
+    return hasCall(g, n->child[0]) || hasCall(g, n->child[1]);
+  default:
+    return 0;
+  }
+}
+
+/* A register holding the value of expr: the variable itself when it is
+ * a register, unless evaluating later could change it first
+ */
+static int genOperand(RegGen *g, AstRef expr, AstRef later) {
+  AstNode *n = node(expr);
+  Object* obj;
+  int offset, reg;
+
+  if (n->kind == AST_VARIABLE && !hasCall(g, later)) {
+    obj = astObjectAt(&g->ctx->ast, n);
+    if (!isReferenceParameter(obj) && levelOf(g->ctx, slotOf(obj, &offset)) == 0)
+      return offset;
+  }
+  reg = newRegister(g);
+  genInto(g, expr, reg);
+  return reg;
+}
+
+/* Put the address of an lvalue in target and return its type */
+static Type* genAddress(RegGen *g, AstRef lvalue, int target) {
+  AstNode *n = node(lvalue);
+  Object* obj;
+  Type* type;
+  int offset, level, index, top = g->top;
+
+  if (n->kind == AST_INDEX) {
+    /* the indexes of an array of n elements run from 1 to n */
+    type = genAddress(g, n->child[0], target);
+    index = genOperand(g, n->child[1], NO_NODE);
+    emit(REG_CHK, index, type->arraySize, 0);
+    emit(REG_IXA, target, index, sizeOfType(type->elementType));
+    g->top = top;
+    return type->elementType;
+  }
+
+  obj = astObjectAt(&g->ctx->ast, n);
+  level = levelOf(g->ctx, slotOf(obj, &offset));
+  if (!isReferenceParameter(obj))
+    emit(REG_LEA, target, level, offset);
+  else if (level == 0)
+    emit(REG_MOV, target, offset, 0);
+  else emit(REG_LDU, target, level, offset);
+
+  switch (obj->kind) {
+  case OBJ_VARIABLE:
+    return obj->varAttrs.type;
+  case OBJ_PARAMETER:
+    return obj->paramAttrs.type;
+  default:
+    return obj->funcAttrs.returnType;
+  }
+}
+
+/* The arguments go to the registers after the reserved words of the
+ * callee's frame, which starts at the first free register. Returns that
+ * register, where a function leaves its result.
+ */
+static int genCall(RegGen *g, Scope* scope, int codeAddress, ObjectNode* paramList, AstRef arg) {
+  int base = g->top, reg = base + RESERVED_WORDS;
+
+  for (; arg != NO_NODE; arg = node(arg)->next, paramList = paramList->next, reg++) {
+    g->top = reg;
+    newRegister(g);
+    if (paramList->object->paramAttrs.kind == PARAM_REFERENCE)
+      genAddress(g, arg, reg);
+    else genInto(g, arg, reg);
+  }
+  g->top = reg;
+  if (g->top > g->frameSize) g->frameSize = g->top;
+  emit(REG_CALL, base, levelOf(g->ctx, scope->outer), codeAddress);
+  g->top = base + 1;
+  return base;
+}
+
+/* Compute expr into target, which is written last, so that target may
+ * be a variable the expression reads
+ */
+static void genInto(RegGen *g, AstRef expr, int target) {
+  AstNode *n = node(expr);
+  Object* obj;
+  Location loc;
+  int top = g->top, left, right, address;
+
+  switch (n->kind) {
+  case AST_NUMBER:
+  case AST_CHAR:
+    emit(REG_LDC, target, n->value, 0);
+    break;
+  case AST_VARIABLE:
+    locate(g, astObjectAt(&g->ctx->ast, n), &loc);
+    load(g, &loc, target);
+    break;
+  case AST_INDEX:
+    address = newRegister(g);
+    genAddress(g, expr, address);
+    emit(REG_LDI, target, address, 0);
+    break;
+  case AST_FCALL:
+    obj = astObjectAt(&g->ctx->ast, n);
+    if (isBuiltin(obj, ATOM_READI))
+      emit(REG_RI, target, 0, 0);
+    else if (isBuiltin(obj, ATOM_READC))
+      emit(REG_RC, target, 0, 0);
+    else emit(REG_MOV, target, genCall(g, obj->funcAttrs.scope, obj->funcAttrs.codeAddress,
+                                       obj->funcAttrs.paramList, n->child[0]), 0);
+    break;
+  case AST_UNARY:
+    if (n->op == SB_MINUS)
+      emit(REG_NEG, target, genOperand(g, n->child[0], NO_NODE), 0);
+    else genInto(g, n->child[0], target);
+    break;
+  case AST_BINARY:
+    left = genOperand(g, n->child[0], n->child[1]);
+    if ((n->op == SB_PLUS || n->op == SB_MINUS) && node(n->child[1])->kind == AST_NUMBER) {
+      right = node(n->child[1])->value;
+      emit(REG_ADDK, target, left, n->op == SB_PLUS ? right : (int) (0u - (unsigned) right));
+      break;
+    }
+    right = genOperand(g, n->child[1], NO_NODE);
+    switch (n->op) {
+    case SB_PLUS:
+      emit(REG_ADD, target, left, right);
+      break;
+    case SB_MINUS:
+      emit(REG_SUB, target, left, right);
+      break;
+    case SB_TIMES:
+      emit(REG_MUL, target, left, right);
+      break;
+    default:
+      emit(REG_DIV, target, left, right);
+      break;
+    }
+    break;
+  default:
+    break;
+  }
+  g->top = top;
+}
+
+/* Jump when the condition is false; returns the jump to patch */
+static int genCondition(RegGen *g, AstRef condition) {
+  AstNode *n = node(condition);
+  int top = g->top, left, right, jump;
+  RegOpCode op;
+
+  left = genOperand(g, n->child[0], n->child[1]);
+  right = genOperand(g, n->child[1], NO_NODE);
+  switch (n->op) {
+  case SB_EQ:
+    op = REG_JNE;
+    break;
+  case SB_NEQ:
+    op = REG_JEQ;
+    break;
+  case SB_LE:
+    op = REG_JGT;
+    break;
+  case SB_LT:
+    op = REG_JGE;
+    break;
+  case SB_GE:
+    op = REG_JLT;
+    break;
+  default:
+    op = REG_JLE;
+    break;
+  }
+  jump = emit(op, left, right, 0);
+  g->top = top;
+  return jump;
+}
+
+static void genAssign(RegGen *g, AstRef lvalue, AstRef expr) {
+  Location loc;
+  int address, value;
+
+  if (node(lvalue)->kind == AST_INDEX) {
+    address = newRegister(g);
+    genAddress(g, lvalue, address);
+    value = genOperand(g, expr, NO_NODE);
+    emit(REG_STI, address, value, 0);
+    return;
+  }
+
+  locate(g, astObjectAt(&g->ctx->ast, node(lvalue)), &loc);
+  if (loc.kind == LOC_REGISTER)
+    genInto(g, expr, loc.reg);
+  else store(g, &loc, genOperand(g, expr, NO_NODE));
+}
+
+static void genFor(RegGen *g, AstNode *n) {
+  Location loc;
+  int loop, jump, value, limit, top;
+
+  locate(g, astObjectAt(&g->ctx->ast, n), &loc);
+  top = g->top;
+  if (loc.kind == LOC_REGISTER)
+    genInto(g, n->child[0], loc.reg);
+  else store(g, &loc, genOperand(g, n->child[0], NO_NODE));
+
+  loop = g->code->size;
+  if (loc.kind == LOC_REGISTER && !hasCall(g, n->child[1]))
+    value = loc.reg;
+  else {
+    value = newRegister(g);
+    load(g, &loc, value);
+  }
+  limit = genOperand(g, n->child[1], NO_NODE);
+  jump = emit(REG_JGT, value, limit, 0);
+  g->top = top;
+
+  genStatements(g, n->child[2]);
+
+  if (loc.kind == LOC_REGISTER)
+    emit(REG_ADDK, loc.reg, loc.reg, 1);
+  else {
+    value = newRegister(g);
+    load(g, &loc, value);
+    emit(REG_ADDK, value, value, 1);
+    store(g, &loc, value);
+  }
+  emit(REG_J, loop, 0, 0);
+  patchReg(g->code, jump, g->code->size);
+}
+
+static void genStatements(RegGen *g, AstRef statement) {
+  AstNode *n;
+  Object* obj;
+  int top = g->top, jump, loop;
+
+  for (; statement != NO_NODE; statement = n->next) {
+    n = node(statement);
+    switch (n->kind) {
+    case AST_ASSIGN:
+      genAssign(g, n->child[0], n->child[1]);
+      break;
+    case AST_CALL:
+      obj = astObjectAt(&g->ctx->ast, n);
+      if (isBuiltin(obj, ATOM_WRITEI))
+        emit(REG_WRI, genOperand(g, n->child[0], NO_NODE), 0, 0);
+      else if (isBuiltin(obj, ATOM_WRITEC))
+        emit(REG_WRC, genOperand(g, n->child[0], NO_NODE), 0, 0);
+      else if (isBuiltin(obj, ATOM_WRITELN))
+        emit(REG_WLN, 0, 0, 0);
+      else genCall(g, obj->procAttrs.scope, obj->procAttrs.codeAddress, obj->procAttrs.paramList, n->child[0]);
+      break;
+    case AST_GROUP:
+      genStatements(g, n->child[0]);
+      break;
+    case AST_IF:
+      jump = genCondition(g, n->child[0]);
+      genStatements(g, n->child[1]);
+      if (n->child[2] != NO_NODE) {
+        loop = emit(REG_J, 0, 0, 0);
+        patchReg(g->code, jump, g->code->size);
+        genStatements(g, n->child[2]);
+        patchReg(g->code, loop, g->code->size);
+      } else patchReg(g->code, jump, g->code->size);
+      break;
+    case AST_WHILE:
+      loop = g->code->size;
+      jump = genCondition(g, n->child[0]);
+      genStatements(g, n->child[1]);
+      emit(REG_J, loop, 0, 0);
+      patchReg(g->code, jump, g->code->size);
+      break;
+    case AST_FOR:
+      genFor(g, n);
+      break;
+    }
+    g->top = top;
+  }
+}
+
+/* As for the stack machine, a block starts with a jump to its body.
+ * ENTER is patched with the size of the frame once the body is done.
+ */
+static void genRegBlock(CompilerContext *ctx, Object* owner) {
+  Scope* scope = ownerScope(owner);
+  Scope* outer = ctx->symtab->currentScope;
+  RegGen block;
+  RegGen *g = &block;
+  int entry, enter, i;
+
+  layoutScope(scope);
+  block.ctx = ctx;
+  block.code = ctx->regCode;
+  block.top = block.frameSize = scope->frameSize;
+
+  entry = emit(REG_J, 0, 0, 0);
+  if (owner->kind == OBJ_FUNCTION) owner->funcAttrs.codeAddress = entry;
+  else if (owner->kind == OBJ_PROCEDURE) owner->procAttrs.codeAddress = entry;
+
+  for (i = 0; i < scope->objectCount; i++)
+    if (scope->objects[i]->kind == OBJ_FUNCTION || scope->objects[i]->kind == OBJ_PROCEDURE)
+      genRegBlock(ctx, scope->objects[i]);
+
+  patchReg(g->code, entry, g->code->size);
+  ctx->symtab->currentScope = scope;
+  enter = emit(REG_ENTER, 0, 0, 0);
+
+  switch (owner->kind) {
+  case OBJ_FUNCTION:
+    genStatements(g, owner->funcAttrs.body);
+    emit(REG_RET, 0, 0, 0);
+    break;
+  case OBJ_PROCEDURE:
+    genStatements(g, owner->procAttrs.body);
+    emit(REG_RET, 0, 0, 0);
+    break;
+  default:
+    genStatements(g, owner->progAttrs.body);
+    emit(REG_HL, 0, 0, 0);
+    break;
+  }
+  patchReg(g->code, enter, block.frameSize);
+  ctx->symtab->currentScope = outer;
+}
+
+void genRegCode(CompilerContext *ctx, Object* program) {
+  ctx->regCode->size = 0;
+  genRegBlock(ctx, program);
+}
@@ -0,0 +1,18 @@
+/* Register code generation
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#ifndef __REGGEN_H__
+#define __REGGEN_H__
+
+#include "symtab.h"
+#include "regcode.h"
+
+/* Translate the checked AST of the program into register machine code
+ * in ctx->regCode. The frames are laid out as for the stack machine.
+ */
+void genRegCode(CompilerContext *ctx, Object* program);
+
+#endif
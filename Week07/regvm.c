@@ -0,0 +1,229 @@
+/* Register machine
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "alloc.h"
+#include "regvm.h"
+
+#if defined(__GNUC__) && !defined(VM_SWITCH_ONLY)
+#define HAVE_THREADED_DISPATCH 1
+#endif
+
+#define FAIL(st) do { status = (st); goto stop; } while (0)
+#define CHECK_ADDRESS(x) if ((unsigned) (x) >= (unsigned) size) FAIL(VM_BAD_ADDRESS)
+
+/* Arithmetic wraps around like the machine words it models */
+#define WRAP(x) ((int) (unsigned int) (x))
+
+#define R(x) s[b + (x)]
+
+/* f = the base of the frame p static links out */
+#define FRAME(p, f) do {                                        \
+    int level_ = (p);                                           \
+    f = b;                                                      \
+    while (level_-- > 0) {                                      \
+      CHECK_ADDRESS(f + FRAME_SL);                              \
+      f = s[f + FRAME_SL];                                      \
+    }                                                           \
+    CHECK_ADDRESS(f);                                           \
+  } while (0)
+
+/* Each handler is a label the previous one jumps to through the table,
+ * or a case of the switch in the portable build.
+ */
+#ifdef HAVE_THREADED_DISPATCH
+#define TARGET(op) do_##op
+#define NEXT do { count ++; goto *handlers[pc->op]; } while (0)
+#else
+#define TARGET(op) case REG_##op
+#define NEXT goto next
+#endif
+
+VMStatus runRegisterMachine(Machine *machine, RegCode *block) {
+#ifdef HAVE_THREADED_DISPATCH
+  static const void *const handlers[REG_COUNT] = {
+    [REG_MOV] = &&do_MOV, [REG_LDC] = &&do_LDC, [REG_ADD] = &&do_ADD, [REG_ADDK] = &&do_ADDK,
+    [REG_SUB] = &&do_SUB, [REG_MUL] = &&do_MUL, [REG_DIV] = &&do_DIV, [REG_NEG] = &&do_NEG,
+    [REG_LDU] = &&do_LDU, [REG_STU] = &&do_STU, [REG_LEA] = &&do_LEA, [REG_LDI] = &&do_LDI,
+    [REG_STI] = &&do_STI, [REG_CHK] = &&do_CHK, [REG_IXA] = &&do_IXA, [REG_J] = &&do_J,
+    [REG_JEQ] = &&do_JEQ, [REG_JNE] = &&do_JNE, [REG_JLT] = &&do_JLT, [REG_JLE] = &&do_JLE,
+    [REG_JGT] = &&do_JGT, [REG_JGE] = &&do_JGE, [REG_CALL] = &&do_CALL, [REG_ENTER] = &&do_ENTER,
+    [REG_RET] = &&do_RET, [REG_HL] = &&do_HL, [REG_RC] = &&do_RC, [REG_RI] = &&do_RI,
+    [REG_WRC] = &&do_WRC, [REG_WRI] = &&do_WRI, [REG_WLN] = &&do_WLN
+  };
+#endif
+  const RegInstruction *code = block->code;
+  const RegInstruction *pc = code;
+  FILE *in = machine->in, *out = machine->out;
+  int size = machine->stackSize;
+  int *s = (int*) memAlloc(size * sizeof(int));
+  int b = 0, f, v;
+  char c;
+  long long count = 0;
+  VMStatus status = VM_HALTED;
+
+  memset(s, 0, size * sizeof(int));
+
+#ifdef HAVE_THREADED_DISPATCH
+  NEXT;
+#else
+ next:
+  count ++;
+  switch (pc->op) {
+#endif
+
+  TARGET(MOV):
+    R(pc->a) = R(pc->b);
+    pc ++;
+    NEXT;
+  TARGET(LDC):
+    R(pc->a) = pc->b;
+    pc ++;
+    NEXT;
+  TARGET(ADD):
+    R(pc->a) = WRAP((unsigned) R(pc->b) + (unsigned) R(pc->c));
+    pc ++;
+    NEXT;
+  TARGET(ADDK):
+    R(pc->a) = WRAP((unsigned) R(pc->b) + (unsigned) pc->c);
+    pc ++;
+    NEXT;
+  TARGET(SUB):
+    R(pc->a) = WRAP((unsigned) R(pc->b) - (unsigned) R(pc->c));
+    pc ++;
+    NEXT;
+  TARGET(MUL):
+    R(pc->a) = WRAP((unsigned) R(pc->b) * (unsigned) R(pc->c));
+    pc ++;
+    NEXT;
+  TARGET(DIV):
+    v = R(pc->c);
+    if (v == 0) FAIL(VM_DIVISION_BY_ZERO);
+    R(pc->a) = v == -1 ? WRAP(0u - (unsigned) R(pc->b)) : R(pc->b) / v;
+    pc ++;
+    NEXT;
+  TARGET(NEG):
+    R(pc->a) = WRAP(0u - (unsigned) R(pc->b));
+    pc ++;
+    NEXT;
+  TARGET(LDU):
+    FRAME(pc->b, f);
+    CHECK_ADDRESS(f + pc->c);
+    R(pc->a) = s[f + pc->c];
+    pc ++;
+    NEXT;
+  TARGET(STU):
+    FRAME(pc->b, f);
+    CHECK_ADDRESS(f + pc->c);
+    s[f + pc->c] = R(pc->a);
+    pc ++;
+    NEXT;
+  TARGET(LEA):
+    FRAME(pc->b, f);
+    R(pc->a) = f + pc->c;
+    pc ++;
+    NEXT;
+  TARGET(LDI):
+    v = R(pc->b);
+    CHECK_ADDRESS(v);
+    R(pc->a) = s[v];
+    pc ++;
+    NEXT;
+  TARGET(STI):
+    v = R(pc->a);
+    CHECK_ADDRESS(v);
+    s[v] = R(pc->b);
+    pc ++;
+    NEXT;
+  TARGET(CHK):
+    v = R(pc->a);
+    if (v < 1 || v > pc->b) FAIL(VM_INDEX_OUT_OF_RANGE);
+    pc ++;
+    NEXT;
+  TARGET(IXA):
+    R(pc->a) = WRAP(R(pc->a) + (unsigned) (R(pc->b) - 1) * (unsigned) pc->c);
+    pc ++;
+    NEXT;
+  TARGET(J):
+    pc = code + pc->a;
+    NEXT;
+  TARGET(JEQ):
+    pc = R(pc->a) == R(pc->b) ? code + pc->c : pc + 1;
+    NEXT;
+  TARGET(JNE):
+    pc = R(pc->a) != R(pc->b) ? code + pc->c : pc + 1;
+    NEXT;
+  TARGET(JLT):
+    pc = R(pc->a) < R(pc->b) ? code + pc->c : pc + 1;
+    NEXT;
+  TARGET(JLE):
+    pc = R(pc->a) <= R(pc->b) ? code + pc->c : pc + 1;
+    NEXT;
+  TARGET(JGT):
+    pc = R(pc->a) > R(pc->b) ? code + pc->c : pc + 1;
+    NEXT;
+  TARGET(JGE):
+    pc = R(pc->a) >= R(pc->b) ? code + pc->c : pc + 1;
+    NEXT;
+  TARGET(CALL):
+    /* the caller's frame covers the reserved words of the new one */
+    FRAME(pc->b, f);
+    R(pc->a + FRAME_DL) = b;
+    R(pc->a + FRAME_RA) = pc + 1 - code;
+    R(pc->a + FRAME_SL) = f;
+    b += pc->a;
+    pc = code + pc->c;
+    NEXT;
+  TARGET(ENTER):
+    if (pc->a > size - b) FAIL(VM_STACK_OVERFLOW);
+    pc ++;
+    NEXT;
+  TARGET(RET):
+    v = R(FRAME_RA);
+    if (v < 0 || v >= block->size) FAIL(VM_BAD_ADDRESS);
+    b = R(FRAME_DL);
+    pc = code + v;
+    NEXT;
+  TARGET(HL):
+    goto stop;
+  TARGET(RC):
+    if (fscanf(in, " %c", &c) != 1) FAIL(VM_BAD_INPUT);
+    R(pc->a) = (unsigned char) c;
+    pc ++;
+    NEXT;
+  TARGET(RI):
+    if (fscanf(in, "%d", &v) != 1) FAIL(VM_BAD_INPUT);
+    R(pc->a) = v;
+    pc ++;
+    NEXT;
+  TARGET(WRC):
+    putc(R(pc->a), out);
+    pc ++;
+    NEXT;
+  TARGET(WRI):
+    fprintf(out, "%d", R(pc->a));
+    pc ++;
+    NEXT;
+  TARGET(WLN):
+    putc('\n', out);
+    pc ++;
+    NEXT;
+
+#ifndef HAVE_THREADED_DISPATCH
+  default:
+    FAIL(VM_BAD_INSTRUCTION);
+  }
+#endif
+
+ stop:
+  machine->instructions = count;
+  machine->pc = pc - code;
+  memFree(s);
+  fflush(machine->out);
+  return status;
+}
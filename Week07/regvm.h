@@ -0,0 +1,20 @@
+/* Register machine
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#ifndef __REGVM_H__
+#define __REGVM_H__
+
+#include "vm.h"
+#include "regcode.h"
+
+/* Run register code on a machine set up by initMachine(). The code
+ * comes from the generator, so only the values it computes are checked.
+ * The dispatch of the machine is chosen when it is built: threaded
+ * where the compiler has labels as values, a switch otherwise.
+ */
+VMStatus runRegisterMachine(Machine *machine, RegCode *block);
+
+#endif
@@ -0,0 +1,538 @@
+/* Scanner generator
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ *
+ * Reads a token specification (see kpl.tokens) and writes the tables of
+ * a minimized DFA as a C header:
+ *
+ *   1. every rule is compiled into a Thompson NFA over byte sets,
+ *   2. the bytes are grouped into classes that no edge distinguishes,
+ *   3. the subset construction gives a DFA over those classes,
+ *   4. Moore's partition refinement minimizes it.
+ *
+ * The character classes letter, digit and space come from charCodes[],
+ * so the generated scanner agrees with the rest of the compiler.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "charcode.h"
+
+extern CharCode charCodes[];
+
+#define MAX_RULES 128
+#define MAX_NAME_LEN 63
+#define MAX_NFA_STATES 4096
+#define MAX_DFA_STATES 256
+#define MAX_SETS 512
+#define NO_RULE -1
+
+typedef struct {
+  unsigned char bytes[256];
+} ByteSet;
+
+typedef struct {
+  int eps[2];           /* epsilon edges, -1 if unused */
+  int set;              /* labelled edge: byte set, -1 if unused */
+  int target;
+  int rule;             /* the rule this state belongs to */
+  int accept;           /* accepted rule, NO_RULE if none */
+} NfaState;
+
+typedef struct {
+  int start, end;
+} Fragment;
+
+struct {
+  char tokenType[MAX_NAME_LEN + 1];
+  char action[MAX_NAME_LEN + 1];
+  char error[MAX_NAME_LEN + 1];
+} rules[MAX_RULES];
+int ruleCount;
+char defaultError[MAX_NAME_LEN + 1] = "ERR_INVALID_SYMBOL";
+
+NfaState nfa[MAX_NFA_STATES];
+int nfaCount;
+ByteSet sets[MAX_SETS];
+int setCount;
+int nfaStart;
+
+int byteClass[256];
+int classCount;
+int classByte[256];     /* a representative byte of each class */
+
+unsigned char *dfaSets[MAX_DFA_STATES];
+int dfaTrans[MAX_DFA_STATES][256];
+int dfaRule[MAX_DFA_STATES];
+int dfaError[MAX_DFA_STATES];   /* index of the rule whose error applies, NO_RULE for default */
+int dfaCount;
+
+char *specName;
+int specLine;
+
+void fail(char *msg) {
+  fprintf(stderr, "scangen: %s:%d: %s\n", specName, specLine, msg);
+  exit(1);
+}
+
+/******************* NFA construction ******************************/
+
+int newState(int rule) {
+  NfaState *s;
+  if (nfaCount == MAX_NFA_STATES) fail("too many NFA states");
+  s = &nfa[nfaCount];
+  s->eps[0] = s->eps[1] = -1;
+  s->set = -1;
+  s->target = -1;
+  s->rule = rule;
+  s->accept = NO_RULE;
+  return nfaCount++;
+}
+
+void addEpsilon(int from, int to) {
+  if (nfa[from].eps[0] < 0) nfa[from].eps[0] = to;
+  else if (nfa[from].eps[1] < 0) nfa[from].eps[1] = to;
+  else fail("internal error: too many epsilon edges");
+}
+
+int newSet(void) {
+  if (setCount == MAX_SETS) fail("too many character sets");
+  memset(&sets[setCount], 0, sizeof(ByteSet));
+  return setCount++;
+}
+
+/* Add the named class to the set; returns 0 if the name is unknown */
+int addClass(ByteSet *set, char *name) {
+  int c;
+
+  for (c = 0; c < 256; c++) {
+    if (strcmp(name, "any") == 0) set->bytes[c] = 1;
+    else if (strcmp(name, "letter") == 0) set->bytes[c] |= (charCodes[c] == CHAR_LETTER);
+    else if (strcmp(name, "digit") == 0) set->bytes[c] |= (charCodes[c] == CHAR_DIGIT);
+    else if (strcmp(name, "space") == 0) set->bytes[c] |= (charCodes[c] == CHAR_SPACE);
+    else return 0;
+  }
+  return 1;
+}
+
+Fragment edge(int set, int rule) {
+  Fragment f;
+  f.start = newState(rule);
+  f.end = newState(rule);
+  nfa[f.start].set = set;
+  nfa[f.start].target = f.end;
+  return f;
+}
+
+Fragment concat(Fragment a, Fragment b) {
+  Fragment f;
+  addEpsilon(a.end, b.start);
+  f.start = a.start;
+  f.end = b.end;
+  return f;
+}
+
+Fragment repeat(Fragment a, int atLeastOnce, int rule) {
+  Fragment f;
+  f.start = newState(rule);
+  f.end = newState(rule);
+  addEpsilon(f.start, a.start);
+  if (!atLeastOnce) addEpsilon(f.start, f.end);
+  addEpsilon(a.end, a.start);
+  addEpsilon(a.end, f.end);
+  return f;
+}
+
+char *skipSpaces(char *p) {
+  while (*p == ' ' || *p == '\t') p++;
+  return p;
+}
+
+char *readWord(char *p, char *word) {
+  int n = 0;
+  while (isalnum((unsigned char) *p) || *p == '_') {
+    if (n == MAX_NAME_LEN) fail("name too long");
+    word[n++] = *p++;
+  }
+  word[n] = '\0';
+  return p;
+}
+
+/* Parse one item of a pattern into an NFA fragment */
+char *parseItem(char *p, int rule, Fragment *result) {
+  char word[MAX_NAME_LEN + 1];
+  Fragment f;
+  int set, first = 1;
+
+  if (*p == '"') {
+    p++;
+    if (*p == '"') fail("empty literal");
+    while (*p != '"') {
+      if (*p == '\0' || *p == '\n') fail("unterminated literal");
+      set = newSet();
+      sets[set].bytes[(unsigned char) *p] = 1;
+      if (first) f = edge(set, rule);
+      else f = concat(f, edge(set, rule));
+      first = 0;
+      p++;
+    }
+    p++;
+  } else if (*p == '[') {
+    set = newSet();
+    p = skipSpaces(p + 1);
+    while (*p != ']') {
+      if (*p == '"') {
+	p++;
+	while (*p != '"') {
+	  if (*p == '\0' || *p == '\n') fail("unterminated literal");
+	  sets[set].bytes[(unsigned char) *p++] = 1;
+	}
+	p++;
+      } else {
+	p = readWord(p, word);
+	if (word[0] == '\0' || !addClass(&sets[set], word)) fail("unknown character class");
+      }
+      p = skipSpaces(p);
+      if (*p == '\0' || *p == '\n') fail("missing ]");
+    }
+    p++;
+    f = edge(set, rule);
+  } else {
+    p = readWord(p, word);
+    set = newSet();
+    if (word[0] == '\0' || !addClass(&sets[set], word)) fail("unknown character class");
+    f = edge(set, rule);
+  }
+
+  if (*p == '*') {
+    f = repeat(f, 0, rule);
+    p++;
+  } else if (*p == '+') {
+    f = repeat(f, 1, rule);
+    p++;
+  }
+
+  *result = f;
+  return p;
+}
+
+int validAction(char *action) {
+  return strcmp(action, "token") == 0 || strcmp(action, "ident") == 0 ||
+    strcmp(action, "number") == 0 || strcmp(action, "char") == 0 ||
+    strcmp(action, "skip") == 0 || strcmp(action, "comment") == 0;
+}
+
+void readSpec(FILE *f) {
+  char line[1024];
+  char directive[MAX_NAME_LEN + 1];
+  char *p;
+  Fragment pattern, item;
+  int rule, alt;
+
+  /* the start state branches to every rule through a chain of states */
+  nfaStart = alt = newState(NO_RULE);
+
+  while (fgets(line, sizeof(line), f) != NULL) {
+    specLine ++;
+    p = skipSpaces(line);
+    if (*p == '#' || *p == '\n' || *p == '\0') continue;
+
+    if (*p == '%') {
+      p = readWord(p + 1, directive);
+      if (strcmp(directive, "error") != 0) fail("unknown directive");
+      p = readWord(skipSpaces(p), defaultError);
+      if (defaultError[0] == '\0') fail("error code expected");
+      continue;
+    }
+
+    if (ruleCount == MAX_RULES) fail("too many rules");
+    rule = ruleCount++;
+
+    p = readWord(p, rules[rule].tokenType);
+    if (rules[rule].tokenType[0] == '\0') fail("token type expected");
+    p = readWord(skipSpaces(p), rules[rule].action);
+    if (!validAction(rules[rule].action)) fail("unknown action");
+    rules[rule].error[0] = '\0';
+
+    p = skipSpaces(p);
+    if (*p == '\n' || *p == '\0' || *p == '!') fail("pattern expected");
+    p = parseItem(p, rule, &pattern);
+    p = skipSpaces(p);
+    while (*p != '\n' && *p != '\0' && *p != '!' && *p != '#') {
+      p = parseItem(p, rule, &item);
+      pattern = concat(pattern, item);
+      p = skipSpaces(p);
+    }
+    if (*p == '!') {
+      p = readWord(skipSpaces(p + 1), rules[rule].error);
+      if (rules[rule].error[0] == '\0') fail("error code expected");
+    }
+
+    addEpsilon(alt, pattern.start);
+    addEpsilon(alt, newState(NO_RULE));
+    alt = nfa[alt].eps[1];
+    nfa[pattern.end].accept = rule;
+  }
+
+  if (ruleCount == 0) fail("no rules");
+}
+
+/******************* Byte classes ******************************/
+
+void computeClasses(void) {
+  int split[256];
+  int c, s, k, n;
+
+  for (c = 0; c < 256; c++) byteClass[c] = 0;
+  classCount = 1;
+
+  /* refine the partition by every set used on an edge */
+  for (s = 0; s < setCount; s++) {
+    for (k = 0; k < classCount; k++) split[k] = -1;
+    n = classCount;
+    for (c = 0; c < 256; c++) {
+      if (!sets[s].bytes[c]) continue;
+      k = byteClass[c];
+      if (split[k] < 0) split[k] = n++;
+      byteClass[c] = split[k];
+    }
+    /* the classes entirely inside the set keep a fresh number; renumber densely */
+    {
+      int map[512];
+      for (k = 0; k < n; k++) map[k] = -1;
+      classCount = 0;
+      for (c = 0; c < 256; c++) {
+	if (map[byteClass[c]] < 0) map[byteClass[c]] = classCount++;
+	byteClass[c] = map[byteClass[c]];
+      }
+    }
+  }
+
+  for (c = 255; c >= 0; c--) classByte[byteClass[c]] = c;
+}
+
+/******************* Subset construction ******************************/
+
+void closure(unsigned char *set) {
+  int stack[MAX_NFA_STATES];
+  int top = 0, s, i;
+
+  for (s = 0; s < nfaCount; s++)
+    if (set[s]) stack[top++] = s;
+  while (top > 0) {
+    s = stack[--top];
+    for (i = 0; i < 2; i++) {
+      int t = nfa[s].eps[i];
+      if (t >= 0 && !set[t]) {
+	set[t] = 1;
+	stack[top++] = t;
+      }
+    }
+  }
+}
+
+int isEmpty(unsigned char *set) {
+  int s;
+  for (s = 0; s < nfaCount; s++)
+    if (set[s]) return 0;
+  return 1;
+}
+
+int findOrAddDfaState(unsigned char *set) {
+  int d, s;
+
+  for (d = 0; d < dfaCount; d++)
+    if (memcmp(dfaSets[d], set, nfaCount) == 0) return d;
+
+  if (dfaCount == MAX_DFA_STATES) fail("too many DFA states");
+  d = dfaCount++;
+  dfaSets[d] = (unsigned char *) malloc(nfaCount);
+  memcpy(dfaSets[d], set, nfaCount);
+
+  dfaRule[d] = NO_RULE;
+  dfaError[d] = NO_RULE;
+  for (s = 0; s < nfaCount; s++) {
+    if (!set[s]) continue;
+    if (nfa[s].accept != NO_RULE && (dfaRule[d] == NO_RULE || nfa[s].accept < dfaRule[d]))
+      dfaRule[d] = nfa[s].accept;
+    if (d > 1 && nfa[s].rule != NO_RULE && rules[nfa[s].rule].error[0] != '\0' &&
+	(dfaError[d] == NO_RULE || nfa[s].rule < dfaError[d]))
+      dfaError[d] = nfa[s].rule;
+  }
+  return d;
+}
+
+void buildDfa(void) {
+  unsigned char *set = (unsigned char *) malloc(nfaCount);
+  int d, c, s;
+
+  /* state 0 is the dead state, state 1 the start state */
+  memset(set, 0, nfaCount);
+  findOrAddDfaState(set);
+  set[nfaStart] = 1;
+  closure(set);
+  findOrAddDfaState(set);
+
+  for (d = 0; d < dfaCount; d++) {
+    for (c = 0; c < classCount; c++) {
+      memset(set, 0, nfaCount);
+      for (s = 0; s < nfaCount; s++)
+	if (dfaSets[d][s] && nfa[s].set >= 0 && sets[nfa[s].set].bytes[classByte[c]])
+	  set[nfa[s].target] = 1;
+      closure(set);
+      dfaTrans[d][c] = isEmpty(set) ? 0 : findOrAddDfaState(set);
+    }
+  }
+  free(set);
+}
+
+/******************* Minimization ******************************/
+
+int block[MAX_DFA_STATES];
+int blockCount;
+
+void minimize(void) {
+  int newBlock[MAX_DFA_STATES];
+  int d, e, c, n, same;
+
+  /* initial partition: by accepted rule and error; dead and start apart */
+  blockCount = 0;
+  for (d = 0; d < dfaCount; d++) {
+    block[d] = -1;
+    for (e = 0; e < d && block[d] < 0; e++)
+      if (e > 1 && d > 1 && dfaRule[e] == dfaRule[d] && dfaError[e] == dfaError[d])
+	block[d] = block[e];
+    if (block[d] < 0) block[d] = blockCount++;
+  }
+
+  do {
+    n = 0;
+    for (d = 0; d < dfaCount; d++) {
+      newBlock[d] = -1;
+      for (e = 0; e < d && newBlock[d] < 0; e++) {
+	if (block[e] != block[d]) continue;
+	same = 1;
+	for (c = 0; c < classCount && same; c++)
+	  same = (block[dfaTrans[e][c]] == block[dfaTrans[d][c]]);
+	if (same) newBlock[d] = newBlock[e];
+      }
+      if (newBlock[d] < 0) newBlock[d] = n++;
+    }
+    same = (n == blockCount);
+    memcpy(block, newBlock, sizeof(int) * dfaCount);
+    blockCount = n;
+  } while (!same);
+}
+
+/******************* Output ******************************/
+
+void upper(char *dst, char *src) {
+  while (*src) *dst++ = toupper((unsigned char) *src++);
+  *dst = '\0';
+}
+
+/* Name the run a state loops on, if its self loop is exactly one of
+ * the classes the vectorized kernels know.
+ */
+char *runKind(int d, int b) {
+  int space = 1, alnum = 1, digit = 1;
+  int c, loops;
+
+  if (b == block[0]) return "SCAN_RUN_NONE";
+  for (c = 0; c < 256; c++) {
+    loops = (block[dfaTrans[d][byteClass[c]]] == b);
+    if (loops != (charCodes[c] == CHAR_SPACE)) space = 0;
+    if (loops != (charCodes[c] == CHAR_LETTER || charCodes[c] == CHAR_DIGIT)) alnum = 0;
+    if (loops != (charCodes[c] == CHAR_DIGIT)) digit = 0;
+  }
+  if (space) return "SCAN_RUN_SPACE";
+  if (alnum) return "SCAN_RUN_ALNUM";
+  if (digit) return "SCAN_RUN_DIGIT";
+  return "SCAN_RUN_NONE";
+}
+
+void writeTables(FILE *f) {
+  int rep[MAX_DFA_STATES];
+  char name[MAX_NAME_LEN + 1];
+  int b, c, r;
+
+  for (b = 0; b < blockCount; b++) rep[b] = -1;
+  for (b = 0; b < dfaCount; b++)
+    if (rep[block[b]] < 0) rep[block[b]] = b;
+
+  fprintf(f, "/* Generated by scangen from %s. Do not edit. */\n\n", specName);
+  fprintf(f, "#ifndef __SCANTABLE_H__\n#define __SCANTABLE_H__\n\n");
+  fprintf(f, "#define SCAN_STATES %d\n", blockCount);
+  fprintf(f, "#define SCAN_CLASSES %d\n", classCount);
+  fprintf(f, "#define SCAN_RULES %d\n", ruleCount);
+  fprintf(f, "#define SCAN_DEAD %d\n", block[0]);
+  fprintf(f, "#define SCAN_START %d\n\n", block[1]);
+
+  fprintf(f, "static const ScanRule scanRules[SCAN_RULES] = {\n");
+  for (r = 0; r < ruleCount; r++) {
+    upper(name, rules[r].action);
+    fprintf(f, "  {%s, SCAN_%s}%s\n", rules[r].tokenType, name, r + 1 < ruleCount ? "," : "");
+  }
+  fprintf(f, "};\n\n");
+
+  fprintf(f, "static const unsigned char scanCharClass[256] = {");
+  for (c = 0; c < 256; c++)
+    fprintf(f, "%s%d%s", c % 16 == 0 ? "\n  " : "", byteClass[c], c < 255 ? ", " : "\n");
+  fprintf(f, "};\n\n");
+
+  fprintf(f, "static const unsigned char scanTransitions[SCAN_STATES][SCAN_CLASSES] = {\n");
+  for (b = 0; b < blockCount; b++) {
+    fprintf(f, "  {");
+    for (c = 0; c < classCount; c++)
+      fprintf(f, "%d%s", block[dfaTrans[rep[b]][c]], c + 1 < classCount ? ", " : "");
+    fprintf(f, "}%s\n", b + 1 < blockCount ? "," : "");
+  }
+  fprintf(f, "};\n\n");
+
+  /* accepted rule of each state, SCAN_RULES if none */
+  fprintf(f, "static const unsigned char scanAccept[SCAN_STATES] = {\n  ");
+  for (b = 0; b < blockCount; b++)
+    fprintf(f, "%d%s", dfaRule[rep[b]] == NO_RULE ? ruleCount : dfaRule[rep[b]],
+	    b + 1 < blockCount ? ", " : "\n");
+  fprintf(f, "};\n\n");
+
+  /* states that loop on a whole character class can skip the run at once */
+  fprintf(f, "static const unsigned char scanRun[SCAN_STATES] = {");
+  for (b = 0; b < blockCount; b++)
+    fprintf(f, "%s%s%s", b % 4 == 0 ? "\n  " : "", runKind(rep[b], b), b + 1 < blockCount ? ", " : "\n");
+  fprintf(f, "};\n\n");
+
+  fprintf(f, "static const ErrorCode scanError[SCAN_STATES] = {\n");
+  for (b = 0; b < blockCount; b++)
+    fprintf(f, "  %s%s\n", dfaError[rep[b]] == NO_RULE ? defaultError : rules[dfaError[rep[b]]].error,
+	    b + 1 < blockCount ? "," : "");
+  fprintf(f, "};\n\n#endif\n");
+}
+
+int main(int argc, char *argv[]) {
+  FILE *f;
+
+  if (argc != 2) {
+    fprintf(stderr, "usage: scangen <spec.tokens>\n");
+    return 1;
+  }
+
+  specName = argv[1];
+  f = fopen(specName, "r");
+  if (f == NULL) {
+    fprintf(stderr, "scangen: can't read %s\n", specName);
+    return 1;
+  }
+  readSpec(f);
+  fclose(f);
+
+  computeClasses();
+  buildDfa();
+  minimize();
+  writeTables(stdout);
+  return 0;
+}
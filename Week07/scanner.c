@@ -9,294 +9,197 @@
 #include <ctype.h>
 
 #include "reader.h"
-#include "charcode.h"
+#include "atom.h"
+#include "simd.h"
 #include "token.h"
 #include "error.h"
 #include "scanner.h"
 
+/* Actions attached to the rules of the token specification */
+typedef enum {
+  SCAN_TOKEN,
+  SCAN_IDENT,
+  SCAN_NUMBER,
+  SCAN_CHAR,
+  SCAN_SKIP,
+  SCAN_COMMENT
+} ScanAction;
 
-extern int lineNo;
-extern int colNo;
-extern int currentChar;
+typedef struct {
+  TokenType tokenType;
+  ScanAction action;
+} ScanRule;
 
-extern CharCode charCodes[];
+/* DFA tables generated by scangen from kpl.tokens */
+#include "scantable.h"
 
 /***************************************************************/
 
-void skipBlank() {
-  while ((currentChar != EOF) && (charCodes[currentChar] == CHAR_SPACE))
-    readChar();
-}
+/* Skip the rest of a comment; inputPtr is just after the opening (* */
+void skipComment(CompilerContext *ctx) {
+  const char *p = findCommentEnd(ctx->inputPtr, ctx->inputEnd);
 
-void skipComment() {
-  int state = 0;
-  while ((currentChar != EOF) && (state < 2)) {
-    switch (charCodes[currentChar]) {
-    case CHAR_TIMES:
-      state = 1;
-      break;
-    case CHAR_RPAR:
-      if (state == 1) state = 2;
-      else state = 0;
-      break;
-    default:
-      state = 0;
-    }
-    readChar();
+  if (p == NULL) {
+    ctx->inputPtr = ctx->inputEnd;
+    error(ctx, ERR_END_OF_COMMENT, ctx->inputEnd - ctx->inputBuffer);
   }
-  if (state != 2) 
-    error(ERR_END_OF_COMMENT, lineNo, colNo);
+  ctx->inputPtr = p + 2;
 }
 
-Token* readIdentKeyword(void) {
-  Token *token = makeToken(TK_NONE, lineNo, colNo);
-  int count = 1;
-
-  token->string[0] = toupper((char)currentChar);
-  readChar();
-
-  while ((currentChar != EOF) && 
-	 ((charCodes[currentChar] == CHAR_LETTER) || (charCodes[currentChar] == CHAR_DIGIT))) {
-    if (count <= MAX_IDENT_LEN) token->string[count++] = toupper((char)currentChar);
-    readChar();
-  }
-
-  if (count > MAX_IDENT_LEN) {
-    error(ERR_IDENT_TOO_LONG, token->lineNo, token->colNo);
-    return token;
-  }
-
-  token->string[count] = '\0';
-  token->tokenType = checkKeyword(token->string);
-
-  if (token->tokenType == TK_NONE)
+Token* readIdentKeyword(CompilerContext *ctx, Token *token, const char *text, int length) {
+  token->length = length;
+  token->tokenType = checkKeyword(text, length);
+  if (token->tokenType == TK_NONE) {
     token->tokenType = TK_IDENT;
+    token->value = internName(&ctx->atoms, text, length);
+  }
 
   return token;
 }
 
-Token* readNumber(void) {
-  Token *token = makeToken(TK_NUMBER, lineNo, colNo);
-  int count = 0;
-
-  while ((currentChar != EOF) && (charCodes[currentChar] == CHAR_DIGIT)) {
-    token->string[count++] = (char)currentChar;
-    readChar();
-  }
+Token* readNumber(Token *token, const char *text, int length) {
+  unsigned int value = 0;
+  int i;
 
-  token->string[count] = '\0';
-  token->value = atoi(token->string);
+  for (i = 0; i < length; i++)
+    value = value * 10 + (text[i] - '0');
+  token->length = length;
+  token->value = (int) value;
   return token;
 }
 
-Token* readConstChar(void) {
-  Token *token = makeToken(TK_CHAR, lineNo, colNo);
-
-  readChar();
-  if (currentChar == EOF) {
-    token->tokenType = TK_NONE;
-    error(ERR_INVALID_CONSTANT_CHAR, token->lineNo, token->colNo);
-    return token;
-  }
-    
-  token->string[0] = currentChar;
-  token->string[1] = '\0';
-
-  readChar();
-  if (currentChar == EOF) {
-    token->tokenType = TK_NONE;
-    error(ERR_INVALID_CONSTANT_CHAR, token->lineNo, token->colNo);
-    return token;
-  }
-
-  if (charCodes[currentChar] == CHAR_SINGLEQUOTE) {
-    readChar();
-    return token;
-  } else {
-    token->tokenType = TK_NONE;
-    error(ERR_INVALID_CONSTANT_CHAR, token->lineNo, token->colNo);
-    return token;
-  }
+Token* readConstChar(Token *token, const char *text) {
+  token->length = 3;
+  token->value = (unsigned char) text[1];
+  return token;
 }
 
-Token* getToken(void) {
-  Token *token;
-  int ln, cn;
 
-  if (currentChar == EOF) 
-    return makeToken(TK_EOF, lineNo, colNo);
-
-  switch (charCodes[currentChar]) {
-  case CHAR_SPACE: skipBlank(); return getToken();
-  case CHAR_LETTER: return readIdentKeyword();
-  case CHAR_DIGIT: return readNumber();
-  case CHAR_PLUS: 
-    token = makeToken(SB_PLUS, lineNo, colNo);
-    readChar(); 
-    return token;
-  case CHAR_MINUS:
-    token = makeToken(SB_MINUS, lineNo, colNo);
-    readChar(); 
-    return token;
-  case CHAR_TIMES:
-    token = makeToken(SB_TIMES, lineNo, colNo);
-    readChar(); 
-    return token;
-  case CHAR_SLASH:
-    token = makeToken(SB_SLASH, lineNo, colNo);
-    readChar(); 
-    return token;
-  case CHAR_LT:
-    ln = lineNo;
-    cn = colNo;
-    readChar();
-    if ((currentChar != EOF) && (charCodes[currentChar] == CHAR_EQ)) {
-      readChar();
-      return makeToken(SB_LE, ln, cn);
-    } else return makeToken(SB_LT, ln, cn);
-  case CHAR_GT:
-    ln = lineNo;
-    cn = colNo;
-    readChar();
-    if ((currentChar != EOF) && (charCodes[currentChar] == CHAR_EQ)) {
-      readChar();
-      return makeToken(SB_GE, ln, cn);
-    } else return makeToken(SB_GT, ln, cn);
-  case CHAR_EQ: 
-    token = makeToken(SB_EQ, lineNo, colNo);
-    readChar(); 
-    return token;
-  case CHAR_EXCLAIMATION:
-    ln = lineNo;
-    cn = colNo;
-    readChar();
-    if ((currentChar != EOF) && (charCodes[currentChar] == CHAR_EQ)) {
-      readChar();
-      return makeToken(SB_NEQ, ln, cn);
-    } else {
-      token = makeToken(TK_NONE, ln, cn);
-      error(ERR_INVALID_SYMBOL, ln, cn);
-      return token;
+/* Run the DFA from inputPtr and keep the longest match. States that
+ * loop on blanks, identifier characters or digits skip the whole run
+ * with a vectorized kernel. Blanks and comments only restart the loop,
+ * so the stack depth does not depend on how many of them there are.
+ */
+Token* getToken(CompilerContext *ctx, Token *token) {
+  const unsigned char *end = (const unsigned char *) ctx->inputEnd;
+  const unsigned char *p;
+  const unsigned char *accepted;
+  int state, next, rule, pos;
+
+  for (;;) {
+    p = (const unsigned char *) ctx->inputPtr;
+    accepted = p;
+    state = SCAN_START;
+    rule = SCAN_RULES;
+    pos = ctx->inputPtr - ctx->inputBuffer;
+
+    if (p == end)
+      return makeToken(token, TK_EOF, pos);
+
+    for (; p < end; p++) {
+      next = scanTransitions[state][scanCharClass[*p]];
+      if (next == SCAN_DEAD) break;
+      state = next;
+      if (scanRun[state] != SCAN_RUN_NONE)
+	p = (const unsigned char *) skipRun[scanRun[state]]((const char *) p + 1, ctx->inputEnd) - 1;
+      if (scanAccept[state] != SCAN_RULES) {
+	rule = scanAccept[state];
+	accepted = p + 1;
+      }
     }
-  case CHAR_COMMA:
-    token = makeToken(SB_COMMA, lineNo, colNo);
-    readChar(); 
-    return token;
-  case CHAR_PERIOD:
-    ln = lineNo;
-    cn = colNo;
-    readChar();
-    if ((currentChar != EOF) && (charCodes[currentChar] == CHAR_RPAR)) {
-      readChar();
-      return makeToken(SB_RSEL, ln, cn);
-    } else return makeToken(SB_PERIOD, ln, cn);
-  case CHAR_SEMICOLON:
-    token = makeToken(SB_SEMICOLON, lineNo, colNo);
-    readChar(); 
-    return token;
-  case CHAR_COLON:
-    ln = lineNo;
-    cn = colNo;
-    readChar();
-    if ((currentChar != EOF) && (charCodes[currentChar] == CHAR_EQ)) {
-      readChar();
-      return makeToken(SB_ASSIGN, ln, cn);
-    } else return makeToken(SB_COLON, ln, cn);
-  case CHAR_SINGLEQUOTE: return readConstChar();
-  case CHAR_LPAR:
-    ln = lineNo;
-    cn = colNo;
-    readChar();
 
-    if (currentChar == EOF) 
-      return makeToken(SB_LPAR, ln, cn);
+    if (rule == SCAN_RULES) {
+      makeToken(token, TK_NONE, pos);
+      error(ctx, scanError[state], pos);
+    }
 
-    switch (charCodes[currentChar]) {
-    case CHAR_PERIOD:
-      readChar();
-      return makeToken(SB_LSEL, ln, cn);
-    case CHAR_TIMES:
-      readChar();
-      skipComment();
-      return getToken();
+    ctx->inputPtr = (const char *) accepted;
+
+    switch (scanRules[rule].action) {
+    case SCAN_SKIP:
+      continue;
+    case SCAN_COMMENT:
+      skipComment(ctx);
+      continue;
+    case SCAN_IDENT:
+      makeToken(token, scanRules[rule].tokenType, pos);
+      return readIdentKeyword(ctx, token, ctx->inputBuffer + pos, ctx->inputPtr - ctx->inputBuffer - pos);
+    case SCAN_NUMBER:
+      makeToken(token, scanRules[rule].tokenType, pos);
+      return readNumber(token, ctx->inputBuffer + pos, ctx->inputPtr - ctx->inputBuffer - pos);
+    case SCAN_CHAR:
+      makeToken(token, scanRules[rule].tokenType, pos);
+      return readConstChar(token, ctx->inputBuffer + pos);
+    case SCAN_TOKEN:
     default:
-      return makeToken(SB_LPAR, ln, cn);
+      return makeToken(token, scanRules[rule].tokenType, pos);
     }
-  case CHAR_RPAR:
-    token = makeToken(SB_RPAR, lineNo, colNo);
-    readChar(); 
-    return token;
-  default:
-    token = makeToken(TK_NONE, lineNo, colNo);
-    error(ERR_INVALID_SYMBOL, lineNo, colNo);
-    readChar(); 
-    return token;
   }
 }
 
-Token* getValidToken(void) {
-  Token *token = getToken();
-  while (token->tokenType == TK_NONE) {
-    free(token);
-    token = getToken();
-  }
+Token* getValidToken(CompilerContext *ctx, Token *token) {
+  do {
+    getToken(ctx, token);
+  } while (token->tokenType == TK_NONE);
   return token;
 }
 
 
 /******************************************************************/
 
-void printToken(Token *token) {
+void printToken(CompilerContext *ctx, Token *token) {
+  int lineNo, colNo;
 
-  printf("%d-%d:", token->lineNo, token->colNo);
+  positionOf(ctx, token->pos, &lineNo, &colNo);
+  fprintf(ctx->out, "%d-%d:", lineNo, colNo);
 
   switch (token->tokenType) {
-  case TK_NONE: printf("TK_NONE\n"); break;
-  case TK_IDENT: printf("TK_IDENT(%s)\n", token->string); break;
-  case TK_NUMBER: printf("TK_NUMBER(%s)\n", token->string); break;
-  case TK_CHAR: printf("TK_CHAR(\'%s\')\n", token->string); break;
-  case TK_EOF: printf("TK_EOF\n"); break;
-
-  case KW_PROGRAM: printf("KW_PROGRAM\n"); break;
-  case KW_CONST: printf("KW_CONST\n"); break;
-  case KW_TYPE: printf("KW_TYPE\n"); break;
-  case KW_VAR: printf("KW_VAR\n"); break;
-  case KW_INTEGER: printf("KW_INTEGER\n"); break;
-  case KW_CHAR: printf("KW_CHAR\n"); break;
-  case KW_ARRAY: printf("KW_ARRAY\n"); break;
-  case KW_OF: printf("KW_OF\n"); break;
-  case KW_FUNCTION: printf("KW_FUNCTION\n"); break;
-  case KW_PROCEDURE: printf("KW_PROCEDURE\n"); break;
-  case KW_BEGIN: printf("KW_BEGIN\n"); break;
-  case KW_END: printf("KW_END\n"); break;
-  case KW_CALL: printf("KW_CALL\n"); break;
-  case KW_IF: printf("KW_IF\n"); break;
-  case KW_THEN: printf("KW_THEN\n"); break;
-  case KW_ELSE: printf("KW_ELSE\n"); break;
-  case KW_WHILE: printf("KW_WHILE\n"); break;
-  case KW_DO: printf("KW_DO\n"); break;
-  case KW_FOR: printf("KW_FOR\n"); break;
-  case KW_TO: printf("KW_TO\n"); break;
-
-  case SB_SEMICOLON: printf("SB_SEMICOLON\n"); break;
-  case SB_COLON: printf("SB_COLON\n"); break;
-  case SB_PERIOD: printf("SB_PERIOD\n"); break;
-  case SB_COMMA: printf("SB_COMMA\n"); break;
-  case SB_ASSIGN: printf("SB_ASSIGN\n"); break;
-  case SB_EQ: printf("SB_EQ\n"); break;
-  case SB_NEQ: printf("SB_NEQ\n"); break;
-  case SB_LT: printf("SB_LT\n"); break;
-  case SB_LE: printf("SB_LE\n"); break;
-  case SB_GT: printf("SB_GT\n"); break;
-  case SB_GE: printf("SB_GE\n"); break;
-  case SB_PLUS: printf("SB_PLUS\n"); break;
-  case SB_MINUS: printf("SB_MINUS\n"); break;
-  case SB_TIMES: printf("SB_TIMES\n"); break;
-  case SB_SLASH: printf("SB_SLASH\n"); break;
-  case SB_LPAR: printf("SB_LPAR\n"); break;
-  case SB_RPAR: printf("SB_RPAR\n"); break;
-  case SB_LSEL: printf("SB_LSEL\n"); break;
-  case SB_RSEL: printf("SB_RSEL\n"); break;
+  case TK_NONE: fprintf(ctx->out, "TK_NONE\n"); break;
+  case TK_IDENT: fprintf(ctx->out, "TK_IDENT(%s)\n", atomName(&ctx->atoms, token->value)); break;
+  case TK_NUMBER: fprintf(ctx->out, "TK_NUMBER(%.*s)\n", token->length, ctx->inputBuffer + token->pos); break;
+  case TK_CHAR: fprintf(ctx->out, "TK_CHAR(\'%c\')\n", token->value); break;
+  case TK_EOF: fprintf(ctx->out, "TK_EOF\n"); break;
+
+  case KW_PROGRAM: fprintf(ctx->out, "KW_PROGRAM\n"); break;
+  case KW_CONST: fprintf(ctx->out, "KW_CONST\n"); break;
+  case KW_TYPE: fprintf(ctx->out, "KW_TYPE\n"); break;
+  case KW_VAR: fprintf(ctx->out, "KW_VAR\n"); break;
+  case KW_INTEGER: fprintf(ctx->out, "KW_INTEGER\n"); break;
+  case KW_CHAR: fprintf(ctx->out, "KW_CHAR\n"); break;
+  case KW_ARRAY: fprintf(ctx->out, "KW_ARRAY\n"); break;
+  case KW_OF: fprintf(ctx->out, "KW_OF\n"); break;
+  case KW_FUNCTION: fprintf(ctx->out, "KW_FUNCTION\n"); break;
+  case KW_PROCEDURE: fprintf(ctx->out, "KW_PROCEDURE\n"); break;
+  case KW_BEGIN: fprintf(ctx->out, "KW_BEGIN\n"); break;
+  case KW_END: fprintf(ctx->out, "KW_END\n"); break;
+  case KW_CALL: fprintf(ctx->out, "KW_CALL\n"); break;
+  case KW_IF: fprintf(ctx->out, "KW_IF\n"); break;
+  case KW_THEN: fprintf(ctx->out, "KW_THEN\n"); break;
+  case KW_ELSE: fprintf(ctx->out, "KW_ELSE\n"); break;
+  case KW_WHILE: fprintf(ctx->out, "KW_WHILE\n"); break;
+  case KW_DO: fprintf(ctx->out, "KW_DO\n"); break;
+  case KW_FOR: fprintf(ctx->out, "KW_FOR\n"); break;
+  case KW_TO: fprintf(ctx->out, "KW_TO\n"); break;
+
+  case SB_SEMICOLON: fprintf(ctx->out, "SB_SEMICOLON\n"); break;
+  case SB_COLON: fprintf(ctx->out, "SB_COLON\n"); break;
+  case SB_PERIOD: fprintf(ctx->out, "SB_PERIOD\n"); break;
+  case SB_COMMA: fprintf(ctx->out, "SB_COMMA\n"); break;
+  case SB_ASSIGN: fprintf(ctx->out, "SB_ASSIGN\n"); break;
+  case SB_EQ: fprintf(ctx->out, "SB_EQ\n"); break;
+  case SB_NEQ: fprintf(ctx->out, "SB_NEQ\n"); break;
+  case SB_LT: fprintf(ctx->out, "SB_LT\n"); break;
+  case SB_LE: fprintf(ctx->out, "SB_LE\n"); break;
+  case SB_GT: fprintf(ctx->out, "SB_GT\n"); break;
+  case SB_GE: fprintf(ctx->out, "SB_GE\n"); break;
+  case SB_PLUS: fprintf(ctx->out, "SB_PLUS\n"); break;
+  case SB_MINUS: fprintf(ctx->out, "SB_MINUS\n"); break;
+  case SB_TIMES: fprintf(ctx->out, "SB_TIMES\n"); break;
+  case SB_SLASH: fprintf(ctx->out, "SB_SLASH\n"); break;
+  case SB_LPAR: fprintf(ctx->out, "SB_LPAR\n"); break;
+  case SB_RPAR: fprintf(ctx->out, "SB_RPAR\n"); break;
+  case SB_LSEL: fprintf(ctx->out, "SB_LSEL\n"); break;
+  case SB_RSEL: fprintf(ctx->out, "SB_RSEL\n"); break;
   }
 }
 
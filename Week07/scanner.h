@@ -8,9 +8,10 @@
 #define __SCANNER_H__
 
 #include "token.h"
+#include "context.h"
 
-Token* getToken(void);
-Token* getValidToken(void);
-void printToken(Token *token);
+Token* getToken(CompilerContext *ctx, Token *token);
+Token* getValidToken(CompilerContext *ctx, Token *token);
+void printToken(CompilerContext *ctx, Token *token);
 
 #endif
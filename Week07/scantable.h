@@ -0,0 +1,137 @@
+/* Generated by scangen from kpl.tokens. Do not edit. */
+
+#ifndef __SCANTABLE_H__
+#define __SCANTABLE_H__
+
+#define SCAN_STATES 29
+#define SCAN_CLASSES 19
+#define SCAN_RULES 24
+#define SCAN_DEAD 0
+#define SCAN_START 1
+
+static const ScanRule scanRules[SCAN_RULES] = {
+  {TK_NONE, SCAN_SKIP},
+  {TK_NONE, SCAN_COMMENT},
+  {TK_IDENT, SCAN_IDENT},
+  {TK_NUMBER, SCAN_NUMBER},
+  {TK_CHAR, SCAN_CHAR},
+  {SB_PLUS, SCAN_TOKEN},
+  {SB_MINUS, SCAN_TOKEN},
+  {SB_TIMES, SCAN_TOKEN},
+  {SB_SLASH, SCAN_TOKEN},
+  {SB_EQ, SCAN_TOKEN},
+  {SB_NEQ, SCAN_TOKEN},
+  {SB_LT, SCAN_TOKEN},
+  {SB_LE, SCAN_TOKEN},
+  {SB_GT, SCAN_TOKEN},
+  {SB_GE, SCAN_TOKEN},
+  {SB_COMMA, SCAN_TOKEN},
+  {SB_SEMICOLON, SCAN_TOKEN},
+  {SB_COLON, SCAN_TOKEN},
+  {SB_ASSIGN, SCAN_TOKEN},
+  {SB_PERIOD, SCAN_TOKEN},
+  {SB_RSEL, SCAN_TOKEN},
+  {SB_LPAR, SCAN_TOKEN},
+  {SB_LSEL, SCAN_TOKEN},
+  {SB_RPAR, SCAN_TOKEN}
+};
+
+static const unsigned char scanCharClass[256] = {
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 0, 0, 
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 
+  1, 2, 0, 0, 0, 0, 0, 3, 4, 5, 6, 7, 8, 9, 10, 11, 
+  12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 13, 14, 15, 16, 17, 0, 
+  0, 18, 18, 18, 18, 18, 18, 18, 18, 18, 18, 18, 18, 18, 18, 18, 
+  18, 18, 18, 18, 18, 18, 18, 18, 18, 18, 18, 0, 0, 0, 0, 0, 
+  0, 18, 18, 18, 18, 18, 18, 18, 18, 18, 18, 18, 18, 18, 18, 18, 
+  18, 18, 18, 18, 18, 18, 18, 18, 18, 18, 18, 0, 0, 0, 0, 0, 
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+};
+
+static const unsigned char scanTransitions[SCAN_STATES][SCAN_CLASSES] = {
+  {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+  {0, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19},
+  {0, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+  {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 20, 0, 0},
+  {21, 21, 21, 21, 21, 21, 21, 21, 21, 21, 21, 21, 21, 21, 21, 21, 21, 21, 21},
+  {0, 0, 0, 0, 0, 0, 22, 0, 0, 0, 23, 0, 0, 0, 0, 0, 0, 0, 0},
+  {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+  {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+  {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+  {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+  {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+  {0, 0, 0, 0, 0, 24, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+  {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+  {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 13, 0, 0, 0, 0, 0, 0},
+  {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 25, 0, 0},
+  {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+  {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 26, 0, 0},
+  {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+  {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 27, 0, 0},
+  {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 19, 0, 0, 0, 0, 0, 19},
+  {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+  {0, 0, 0, 28, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+  {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+  {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+  {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+  {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+  {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+  {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+  {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}
+};
+
+static const unsigned char scanAccept[SCAN_STATES] = {
+  24, 24, 0, 24, 24, 21, 23, 7, 5, 15, 6, 19, 8, 3, 17, 16, 11, 9, 13, 2, 10, 24, 1, 22, 20, 18, 12, 14, 4
+};
+
+static const unsigned char scanRun[SCAN_STATES] = {
+  SCAN_RUN_NONE, SCAN_RUN_NONE, SCAN_RUN_SPACE, SCAN_RUN_NONE, 
+  SCAN_RUN_NONE, SCAN_RUN_NONE, SCAN_RUN_NONE, SCAN_RUN_NONE, 
+  SCAN_RUN_NONE, SCAN_RUN_NONE, SCAN_RUN_NONE, SCAN_RUN_NONE, 
+  SCAN_RUN_NONE, SCAN_RUN_DIGIT, SCAN_RUN_NONE, SCAN_RUN_NONE, 
+  SCAN_RUN_NONE, SCAN_RUN_NONE, SCAN_RUN_NONE, SCAN_RUN_ALNUM, 
+  SCAN_RUN_NONE, SCAN_RUN_NONE, SCAN_RUN_NONE, SCAN_RUN_NONE, 
+  SCAN_RUN_NONE, SCAN_RUN_NONE, SCAN_RUN_NONE, SCAN_RUN_NONE, 
+  SCAN_RUN_NONE
+};
+
+static const ErrorCode scanError[SCAN_STATES] = {
+  ERR_INVALID_SYMBOL,
+  ERR_INVALID_SYMBOL,
+  ERR_INVALID_SYMBOL,
+  ERR_INVALID_SYMBOL,
+  ERR_INVALID_CONSTANT_CHAR,
+  ERR_INVALID_SYMBOL,
+  ERR_INVALID_SYMBOL,
+  ERR_INVALID_SYMBOL,
+  ERR_INVALID_SYMBOL,
+  ERR_INVALID_SYMBOL,
+  ERR_INVALID_SYMBOL,
+  ERR_INVALID_SYMBOL,
+  ERR_INVALID_SYMBOL,
+  ERR_INVALID_SYMBOL,
+  ERR_INVALID_SYMBOL,
+  ERR_INVALID_SYMBOL,
+  ERR_INVALID_SYMBOL,
+  ERR_INVALID_SYMBOL,
+  ERR_INVALID_SYMBOL,
+  ERR_INVALID_SYMBOL,
+  ERR_INVALID_SYMBOL,
+  ERR_INVALID_CONSTANT_CHAR,
+  ERR_INVALID_SYMBOL,
+  ERR_INVALID_SYMBOL,
+  ERR_INVALID_SYMBOL,
+  ERR_INVALID_SYMBOL,
+  ERR_INVALID_SYMBOL,
+  ERR_INVALID_SYMBOL,
+  ERR_INVALID_CONSTANT_CHAR
+};
+
+#endif
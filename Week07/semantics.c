@@ -9,139 +9,151 @@
 #include "semantics.h"
 #include "error.h"
 
-extern SymTab* symtab;
-extern Token* currentToken;
+extern Type* intType;
+extern Type* charType;
 
-Object* lookupObject(char *name) {
-  Scope* scope = symtab->currentScope;
-  Object* obj;
-
-  while (scope != NULL) {
-    obj = findObject(scope->objList, name);
-    if (obj != NULL) return obj;
-    scope = scope->outer;
-  }
-  obj = findObject(symtab->globalObjectList, name);
-  if (obj != NULL) return obj;
-  return NULL;
+void checkFreshIdent(CompilerContext *ctx, Atom name) {
+  if (findLocalObject(ctx, name) != NULL)
+    error(ctx, ERR_DUPLICATE_IDENT, ctx->currentToken->pos);
 }
 
-void checkFreshIdent(char *name) {
-  if (findObject(symtab->currentScope->objList, name) != NULL)
-    error(ERR_DUPLICATE_IDENT, currentToken->lineNo, currentToken->colNo);
-}
-
-Object* checkDeclaredIdent(char* name) {
-  Object* obj = lookupObject(name);
+Object* checkDeclaredIdent(CompilerContext *ctx, Atom name) {
+  Object* obj = lookupObject(ctx, name);
   if (obj == NULL) {
-    error(ERR_UNDECLARED_IDENT,currentToken->lineNo, currentToken->colNo);
+    error(ctx, ERR_UNDECLARED_IDENT,ctx->currentToken->pos);
   }
   return obj;
 }
 
-Object* checkDeclaredConstant(char* name) {
-  Object* obj = lookupObject(name);
+Object* checkDeclaredConstant(CompilerContext *ctx, Atom name) {
+  Object* obj = lookupObject(ctx, name);
   if (obj == NULL)
-    error(ERR_UNDECLARED_CONSTANT,currentToken->lineNo, currentToken->colNo);
+    error(ctx, ERR_UNDECLARED_CONSTANT,ctx->currentToken->pos);
   if (obj->kind != OBJ_CONSTANT)
-    error(ERR_INVALID_CONSTANT,currentToken->lineNo, currentToken->colNo);
+    error(ctx, ERR_INVALID_CONSTANT,ctx->currentToken->pos);
 
   return obj;
 }
 
-Object* checkDeclaredType(char* name) {
-  Object* obj = lookupObject(name);
+Object* checkDeclaredType(CompilerContext *ctx, Atom name) {
+  Object* obj = lookupObject(ctx, name);
   if (obj == NULL)
-    error(ERR_UNDECLARED_TYPE,currentToken->lineNo, currentToken->colNo);
+    error(ctx, ERR_UNDECLARED_TYPE,ctx->currentToken->pos);
   if (obj->kind != OBJ_TYPE)
-    error(ERR_INVALID_TYPE,currentToken->lineNo, currentToken->colNo);
+    error(ctx, ERR_INVALID_TYPE,ctx->currentToken->pos);
 
   return obj;
 }
 
-Object* checkDeclaredVariable(char* name) {
-  Object* obj = lookupObject(name);
+Object* checkDeclaredVariable(CompilerContext *ctx, Atom name) {
+  Object* obj = lookupObject(ctx, name);
   if (obj == NULL)
-    error(ERR_UNDECLARED_VARIABLE,currentToken->lineNo, currentToken->colNo);
+    error(ctx, ERR_UNDECLARED_VARIABLE,ctx->currentToken->pos);
   if (obj->kind != OBJ_VARIABLE)
-    error(ERR_INVALID_VARIABLE,currentToken->lineNo, currentToken->colNo);
+    error(ctx, ERR_INVALID_VARIABLE,ctx->currentToken->pos);
 
   return obj;
 }
 
-Object* checkDeclaredFunction(char* name) {
-  Object* obj = lookupObject(name);
+Object* checkDeclaredFunction(CompilerContext *ctx, Atom name) {
+  Object* obj = lookupObject(ctx, name);
   if (obj == NULL)
-    error(ERR_UNDECLARED_FUNCTION,currentToken->lineNo, currentToken->colNo);
+    error(ctx, ERR_UNDECLARED_FUNCTION,ctx->currentToken->pos);
   if (obj->kind != OBJ_FUNCTION)
-    error(ERR_INVALID_FUNCTION,currentToken->lineNo, currentToken->colNo);
+    error(ctx, ERR_INVALID_FUNCTION,ctx->currentToken->pos);
 
   return obj;
 }
 
-Object* checkDeclaredProcedure(char* name) {
-  Object* obj = lookupObject(name);
+Object* checkDeclaredProcedure(CompilerContext *ctx, Atom name) {
+  Object* obj = lookupObject(ctx, name);
   if (obj == NULL)
-    error(ERR_UNDECLARED_PROCEDURE,currentToken->lineNo, currentToken->colNo);
+    error(ctx, ERR_UNDECLARED_PROCEDURE,ctx->currentToken->pos);
   if (obj->kind != OBJ_PROCEDURE)
-    error(ERR_INVALID_PROCEDURE,currentToken->lineNo, currentToken->colNo);
+    error(ctx, ERR_INVALID_PROCEDURE,ctx->currentToken->pos);
 
   return obj;
 }
 
-Object* checkDeclaredLValueIdent(char* name) {
-  Object* obj = lookupObject(name);
+Object* checkDeclaredLValueIdent(CompilerContext *ctx, Atom name) {
+  Object* obj = lookupObject(ctx, name);
   if (obj == NULL)
-    error(ERR_UNDECLARED_IDENT,currentToken->lineNo, currentToken->colNo);
+    error(ctx, ERR_UNDECLARED_IDENT,ctx->currentToken->pos);
 
   switch (obj->kind) {
   case OBJ_VARIABLE:
   case OBJ_PARAMETER:
     break;
   case OBJ_FUNCTION:
-    if (obj != symtab->currentScope->owner) 
-      error(ERR_INVALID_IDENT,currentToken->lineNo, currentToken->colNo);
+    if (obj != ctx->symtab->currentScope->owner) 
+      error(ctx, ERR_INVALID_IDENT,ctx->currentToken->pos);
     break;
   default:
-    error(ERR_INVALID_IDENT,currentToken->lineNo, currentToken->colNo);
+    error(ctx, ERR_INVALID_IDENT,ctx->currentToken->pos);
   }
 
   return obj;
 }
 
 
-void checkIntType(Type* type) {
+void checkIntType(CompilerContext *ctx, Type* type, int pos) {
   if (type == NULL || type->typeClass != TP_INT)
-    error(ERR_TYPE_INCONSISTENCY, currentToken->lineNo, currentToken->colNo);
+    error(ctx, ERR_TYPE_INCONSISTENCY, pos);
 }
 
-void checkCharType(Type* type) {
+void checkCharType(CompilerContext *ctx, Type* type, int pos) {
   if (type == NULL || type->typeClass != TP_CHAR)
-    error(ERR_TYPE_INCONSISTENCY, currentToken->lineNo, currentToken->colNo);
+    error(ctx, ERR_TYPE_INCONSISTENCY, pos);
 }
 
-void checkBasicType(Type* type) {
+void checkBasicType(CompilerContext *ctx, Type* type, int pos) {
   if (type == NULL ||
       (type->typeClass != TP_INT && type->typeClass != TP_CHAR))
-    error(ERR_TYPE_INCONSISTENCY, currentToken->lineNo, currentToken->colNo);
+    error(ctx, ERR_TYPE_INCONSISTENCY, pos);
 }
 
-void checkArrayType(Type* type) {
+void checkArrayType(CompilerContext *ctx, Type* type, int pos) {
   if (type == NULL || type->typeClass != TP_ARRAY)
-    error(ERR_TYPE_INCONSISTENCY, currentToken->lineNo, currentToken->colNo);
+    error(ctx, ERR_TYPE_INCONSISTENCY, pos);
 }
 
-void checkTypeEquality(Type* type1, Type* type2) {
-  if (type1 == NULL || type2 == NULL)
-    error(ERR_TYPE_INCONSISTENCY, currentToken->lineNo, currentToken->colNo);
-  if (type1->typeClass != type2->typeClass)
-    error(ERR_TYPE_INCONSISTENCY, currentToken->lineNo, currentToken->colNo);
-  if (type1->typeClass == TP_ARRAY) {
-    if (type1->arraySize != type2->arraySize)
-      error(ERR_TYPE_INCONSISTENCY, currentToken->lineNo, currentToken->colNo);
+void checkTypeEquality(CompilerContext *ctx, Type* type1, Type* type2, int pos) {
+  if (type1 == NULL || type1 != type2)
+    error(ctx, ERR_TYPE_INCONSISTENCY, pos);
+}
 
-    checkTypeEquality(type1->elementType, type2->elementType);
+/* The parser checks the types of an expression as it builds it, as the
+ * one-pass compiler did, so the first error in the source is the one
+ * reported. The type of a node it has built is read off the node: its
+ * operands were checked when they were parsed.
+ */
+#define node(ref) astAt(&ctx->ast, (ref))
+
+Type* expressionType(CompilerContext *ctx, AstRef expr) {
+  AstNode *n = node(expr);
+  Object *obj;
+  Type* type;
+
+  switch (n->kind) {
+  case AST_NUMBER:
+    return intType;
+  case AST_CHAR:
+    return charType;
+  case AST_VARIABLE:
+    obj = astObjectAt(&ctx->ast, n);
+    if (obj->kind == OBJ_VARIABLE) return obj->varAttrs.type;
+    if (obj->kind == OBJ_PARAMETER) return obj->paramAttrs.type;
+    return obj->funcAttrs.returnType;
+  case AST_INDEX:
+    type = expressionType(ctx, n->child[0]);
+    return type == NULL ? NULL : type->elementType;
+  case AST_FCALL:
+    return astObjectAt(&ctx->ast, n)->funcAttrs.returnType;
+  case AST_UNARY:
+    return expressionType(ctx, n->child[0]);
+  case AST_BINARY:
+    return intType;
+  default:
+    return NULL;
   }
 }
-
-
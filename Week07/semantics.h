@@ -9,19 +9,23 @@
 
 #include "symtab.h"
 
-void checkFreshIdent(char *name);
-Object* checkDeclaredIdent(char *name);
-Object* checkDeclaredConstant(char *name);
-Object* checkDeclaredType(char *name);
-Object* checkDeclaredVariable(char *name);
-Object* checkDeclaredFunction(char *name);
-Object* checkDeclaredProcedure(char *name);
-Object* checkDeclaredLValueIdent(char *name);
+void checkFreshIdent(CompilerContext *ctx, Atom name);
+Object* checkDeclaredIdent(CompilerContext *ctx, Atom name);
+Object* checkDeclaredConstant(CompilerContext *ctx, Atom name);
+Object* checkDeclaredType(CompilerContext *ctx, Atom name);
+Object* checkDeclaredVariable(CompilerContext *ctx, Atom name);
+Object* checkDeclaredFunction(CompilerContext *ctx, Atom name);
+Object* checkDeclaredProcedure(CompilerContext *ctx, Atom name);
+Object* checkDeclaredLValueIdent(CompilerContext *ctx, Atom name);
 
-void checkIntType(Type* type);
-void checkCharType(Type* type);
-void checkArrayType(Type* type);
-void checkBasicType(Type* type);
-void checkTypeEquality(Type* type1, Type* type2);
+/* The type checks report at pos */
+void checkIntType(CompilerContext *ctx, Type* type, int pos);
+void checkCharType(CompilerContext *ctx, Type* type, int pos);
+void checkArrayType(CompilerContext *ctx, Type* type, int pos);
+void checkBasicType(CompilerContext *ctx, Type* type, int pos);
+void checkTypeEquality(CompilerContext *ctx, Type* type1, Type* type2, int pos);
+
+/* The type of an expression the parser has built and checked */
+Type* expressionType(CompilerContext *ctx, AstRef expr);
 
 #endif
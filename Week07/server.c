@@ -0,0 +1,195 @@
+/* Compile server
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "alloc.h"
+#include "reader.h"
+#include "parser.h"
+#include "server.h"
+
+static int readFull(int fd, void *buffer, size_t size) {
+  char *p = (char*) buffer;
+  ssize_t n;
+
+  while (size > 0) {
+    n = read(fd, p, size);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return -1;
+    p += n;
+    size -= n;
+  }
+  return 0;
+}
+
+static int writeFull(int fd, const void *buffer, size_t size) {
+  const char *p = (const char*) buffer;
+  ssize_t n;
+
+  while (size > 0) {
+    n = write(fd, p, size);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return -1;
+    p += n;
+    size -= n;
+  }
+  return 0;
+}
+
+static int unixAddress(char *path, struct sockaddr_un *addr) {
+  memset(addr, 0, sizeof(*addr));
+  addr->sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(addr->sun_path)) return -1;
+  strcpy(addr->sun_path, path);
+  return 0;
+}
+
+/******************************************************************/
+
+/* A worker owns a context and a request buffer for its whole life, so
+ * a warm server reuses the symbol table region, the atom table and the
+ * source buffer from one request to the next.
+ */
+typedef struct {
+  int listenFd;
+  CompilerContext ctx;
+  char *source;
+  size_t capacity;
+} ServerWorker;
+
+static void serveConnection(ServerWorker *worker, int fd) {
+  uint32_t length, header[2];
+  char *output;
+  size_t outputSize;
+  FILE *out;
+  int result;
+
+  while (readFull(fd, &length, sizeof(length)) == 0) {
+    if (length > SERVER_MAX_REQUEST) break;
+    if (length > worker->capacity) {
+      worker->capacity = length;
+      worker->source = (char*) memRealloc(worker->source, worker->capacity);
+    }
+    if (readFull(fd, worker->source, length) != 0) break;
+
+    output = NULL;
+    outputSize = 0;
+    out = open_memstream(&output, &outputSize);
+    worker->ctx.out = out;
+    result = compileBuffer(&worker->ctx, worker->source, length);
+    fclose(out);
+
+    header[0] = result;
+    header[1] = outputSize;
+    result = writeFull(fd, header, sizeof(header)) == 0
+      && writeFull(fd, output, outputSize) == 0;
+    free(output);
+    if (!result) break;
+  }
+  close(fd);
+}
+
+/* A worker waits out a shortage of descriptors or memory, and stops
+ * when the listening socket itself fails.
+ */
+static void *serverWorker(void *arg) {
+  ServerWorker *worker = (ServerWorker*) arg;
+  int fd;
+
+  for (;;) {
+    fd = accept(worker->listenFd, NULL, NULL);
+    if (fd >= 0) serveConnection(worker, fd);
+    else if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM)
+      usleep(100000);
+    else if (errno != EINTR && errno != ECONNABORTED)
+      break;
+  }
+  return NULL;
+}
+
+int runServer(char *path, int threads, Cache *cache) {
+  struct sockaddr_un addr;
+  ServerWorker *workers;
+  pthread_t thread;
+  struct stat st;
+  int listenFd, i;
+
+  if (unixAddress(path, &addr) != 0) return IO_ERROR;
+  listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listenFd < 0) return IO_ERROR;
+  /* only a socket a previous server left behind is replaced */
+  if (lstat(path, &st) == 0 && S_ISSOCK(st.st_mode))
+    unlink(path);
+  if (bind(listenFd, (struct sockaddr*) &addr, sizeof(addr)) != 0
+      || listen(listenFd, 128) != 0) {
+    close(listenFd);
+    return IO_ERROR;
+  }
+
+  /* a client that goes away must not kill the server */
+  signal(SIGPIPE, SIG_IGN);
+
+  if (threads < 1) threads = 1;
+  workers = (ServerWorker*) memAlloc(threads * sizeof(ServerWorker));
+  for (i = 0; i < threads; i++) {
+    workers[i].listenFd = listenFd;
+    initContext(&workers[i].ctx, NULL);
+    workers[i].ctx.cache = cache;
+    workers[i].source = NULL;
+    workers[i].capacity = 0;
+    if (i > 0) {
+      pthread_create(&thread, NULL, serverWorker, &workers[i]);
+      pthread_detach(thread);
+    }
+  }
+  /* the first worker returns only when the listening socket fails */
+  serverWorker(&workers[0]);
+  return IO_ERROR;
+}
+
+/******************************************************************/
+
+int connectServer(char *path) {
+  struct sockaddr_un addr;
+  int fd;
+
+  if (unixAddress(path, &addr) != 0) return -1;
+  fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) return -1;
+  if (connect(fd, (struct sockaddr*) &addr, sizeof(addr)) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+int requestCompile(int fd, const char *source, size_t size, char **output, size_t *outputSize) {
+  uint32_t length = size, header[2];
+
+  if (size > SERVER_MAX_REQUEST
+      || writeFull(fd, &length, sizeof(length)) != 0
+      || writeFull(fd, source, size) != 0
+      || readFull(fd, header, sizeof(header)) != 0)
+    return -1;
+
+  *output = (char*) memAlloc(header[1] + 1);
+  if (readFull(fd, *output, header[1]) != 0) {
+    memFree(*output);
+    return -1;
+  }
+  (*output)[header[1]] = '\0';
+  *outputSize = header[1];
+  return header[0];
+}
@@ -0,0 +1,34 @@
+/* Compile server
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#ifndef __SERVER_H__
+#define __SERVER_H__
+
+#include <stddef.h>
+#include "cache.h"
+
+/* A request on the socket is a 32-bit length followed by the source
+ * text. The reply is the 32-bit result of compile(), a 32-bit length
+ * and the output: the object tree or the diagnostic. A connection may
+ * carry any number of requests.
+ */
+#define SERVER_MAX_REQUEST (64 * 1024 * 1024)
+
+/* Serve on a Unix socket at path with a pool of threads, until killed.
+ * cache may be NULL. Returns only when the socket cannot be set up or
+ * fails. An existing file at path is replaced only if it is a socket.
+ */
+int runServer(char *path, int threads, Cache *cache);
+
+int connectServer(char *path);
+
+/* Send one source buffer and wait for the reply. The output is
+ * allocated with memAlloc and belongs to the caller. Returns the result
+ * of the compilation, or -1 when the connection failed.
+ */
+int requestCompile(int fd, const char *source, size_t size, char **output, size_t *outputSize);
+
+#endif
@@ -0,0 +1,218 @@
+/* Vectorized scanning kernels
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ *
+ * Scalar, SSE2 and AVX2 versions of the loops that skip blanks,
+ * identifier characters, digits and comment bodies. The character sets
+ * are those of charCodes[]: blanks are 9..13 and 32, identifiers are
+ * ASCII letters and digits. The best version is picked at run time.
+ */
+
+#include <stddef.h>
+#include "simd.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define HAVE_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+/******************* Scalar ******************************/
+
+#define IS_SPACE(c) ((c) == ' ' || (unsigned char) ((c) - 9) <= 4)
+#define IS_DIGIT(c) ((unsigned char) ((c) - '0') <= 9)
+#define IS_LETTER(c) ((unsigned char) (((c) | 0x20) - 'a') <= 25)
+
+static const char *skipSpaceScalar(const char *p, const char *end) {
+  while (p < end && IS_SPACE((unsigned char) *p)) p++;
+  return p;
+}
+
+static const char *skipAlnumScalar(const char *p, const char *end) {
+  while (p < end && (IS_LETTER((unsigned char) *p) || IS_DIGIT((unsigned char) *p))) p++;
+  return p;
+}
+
+static const char *skipDigitScalar(const char *p, const char *end) {
+  while (p < end && IS_DIGIT((unsigned char) *p)) p++;
+  return p;
+}
+
+static const char *findCommentEndScalar(const char *p, const char *end) {
+  while (p + 1 < end) {
+    if (p[0] == '*' && p[1] == ')') return p;
+    p++;
+  }
+  return NULL;
+}
+
+#ifdef HAVE_X86_SIMD
+
+/******************* SSE2 ******************************/
+
+/* unsigned x <= limit, byte-wise */
+#define SSE_LE(x, limit) _mm_cmpeq_epi8(_mm_min_epu8((x), (limit)), (x))
+
+static inline __m128i spaceMask16(__m128i x) {
+  __m128i blank = _mm_cmpeq_epi8(x, _mm_set1_epi8(' '));
+  __m128i ctrl = _mm_sub_epi8(x, _mm_set1_epi8(9));
+  return _mm_or_si128(blank, SSE_LE(ctrl, _mm_set1_epi8(4)));
+}
+
+static inline __m128i digitMask16(__m128i x) {
+  return SSE_LE(_mm_sub_epi8(x, _mm_set1_epi8('0')), _mm_set1_epi8(9));
+}
+
+static inline __m128i alnumMask16(__m128i x) {
+  __m128i lower = _mm_sub_epi8(_mm_or_si128(x, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+  return _mm_or_si128(SSE_LE(lower, _mm_set1_epi8(25)), digitMask16(x));
+}
+
+#define SSE_RUN(name, maskFn, scalarFn)					\
+  static const char *name(const char *p, const char *end) {		\
+    while (p + 16 <= end) {						\
+      unsigned m = ~_mm_movemask_epi8(maskFn(_mm_loadu_si128((const __m128i *) p))) & 0xFFFF; \
+      if (m != 0) return p + __builtin_ctz(m);				\
+      p += 16;								\
+    }									\
+    return scalarFn(p, end);						\
+  }
+
+SSE_RUN(skipSpaceSse2, spaceMask16, skipSpaceScalar)
+SSE_RUN(skipAlnumSse2, alnumMask16, skipAlnumScalar)
+SSE_RUN(skipDigitSse2, digitMask16, skipDigitScalar)
+
+static const char *findCommentEndSse2(const char *p, const char *end) {
+  const __m128i star = _mm_set1_epi8('*');
+  const __m128i rpar = _mm_set1_epi8(')');
+
+  while (p + 17 <= end) {
+    __m128i a = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) p), star);
+    __m128i b = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) (p + 1)), rpar);
+    unsigned m = _mm_movemask_epi8(_mm_and_si128(a, b));
+    if (m != 0) return p + __builtin_ctz(m);
+    p += 16;
+  }
+  return findCommentEndScalar(p, end);
+}
+
+/******************* AVX2 ******************************/
+
+#define AVX_LE(x, limit) _mm256_cmpeq_epi8(_mm256_min_epu8((x), (limit)), (x))
+
+__attribute__((target("avx2")))
+static inline __m256i spaceMask32(__m256i x) {
+  __m256i blank = _mm256_cmpeq_epi8(x, _mm256_set1_epi8(' '));
+  __m256i ctrl = _mm256_sub_epi8(x, _mm256_set1_epi8(9));
+  return _mm256_or_si256(blank, AVX_LE(ctrl, _mm256_set1_epi8(4)));
+}
+
+__attribute__((target("avx2")))
+static inline __m256i digitMask32(__m256i x) {
+  return AVX_LE(_mm256_sub_epi8(x, _mm256_set1_epi8('0')), _mm256_set1_epi8(9));
+}
+
+__attribute__((target("avx2")))
+static inline __m256i alnumMask32(__m256i x) {
+  __m256i lower = _mm256_sub_epi8(_mm256_or_si256(x, _mm256_set1_epi8(0x20)), _mm256_set1_epi8('a'));
+  return _mm256_or_si256(AVX_LE(lower, _mm256_set1_epi8(25)), digitMask32(x));
+}
+
+#define AVX_RUN(name, maskFn, sseFn)					\
+  __attribute__((target("avx2")))					\
+  static const char *name(const char *p, const char *end) {		\
+    while (p + 32 <= end) {						\
+      unsigned m = ~(unsigned) _mm256_movemask_epi8(maskFn(_mm256_loadu_si256((const __m256i *) p))); \
+      if (m != 0) return p + __builtin_ctz(m);				\
+      p += 32;								\
+    }									\
+    return sseFn(p, end);						\
+  }
+
+AVX_RUN(skipSpaceAvx2, spaceMask32, skipSpaceSse2)
+AVX_RUN(skipAlnumAvx2, alnumMask32, skipAlnumSse2)
+AVX_RUN(skipDigitAvx2, digitMask32, skipDigitSse2)
+
+__attribute__((target("avx2")))
+static const char *findCommentEndAvx2(const char *p, const char *end) {
+  const __m256i star = _mm256_set1_epi8('*');
+  const __m256i rpar = _mm256_set1_epi8(')');
+
+  while (p + 33 <= end) {
+    __m256i a = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *) p), star);
+    __m256i b = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *) (p + 1)), rpar);
+    unsigned m = _mm256_movemask_epi8(_mm256_and_si256(a, b));
+    if (m != 0) return p + __builtin_ctz(m);
+    p += 32;
+  }
+  return findCommentEndSse2(p, end);
+}
+
+#endif
+
+/******************* Dispatch ******************************/
+
+/* indexed by ScanRun; scalar until the best implementation is selected
+ * at load time, before any thread scans
+ */
+RunKernel skipRun[] = {
+  NULL,
+  skipSpaceScalar,
+  skipAlnumScalar,
+  skipDigitScalar
+};
+
+const char* (*findCommentEnd)(const char *p, const char *end) = findCommentEndScalar;
+
+SimdLevel selectSimdLevel(SimdLevel level) {
+#ifdef HAVE_X86_SIMD
+  __builtin_cpu_init();
+  if (level == SIMD_BEST)
+    level = __builtin_cpu_supports("avx2") ? SIMD_AVX2 : SIMD_SSE2;
+  if (level == SIMD_AVX2 && !__builtin_cpu_supports("avx2"))
+    level = SIMD_SSE2;
+#else
+  level = SIMD_SCALAR;
+#endif
+
+  switch (level) {
+#ifdef HAVE_X86_SIMD
+  case SIMD_AVX2:
+    skipRun[SCAN_RUN_SPACE] = skipSpaceAvx2;
+    skipRun[SCAN_RUN_ALNUM] = skipAlnumAvx2;
+    skipRun[SCAN_RUN_DIGIT] = skipDigitAvx2;
+    findCommentEnd = findCommentEndAvx2;
+    break;
+  case SIMD_SSE2:
+    skipRun[SCAN_RUN_SPACE] = skipSpaceSse2;
+    skipRun[SCAN_RUN_ALNUM] = skipAlnumSse2;
+    skipRun[SCAN_RUN_DIGIT] = skipDigitSse2;
+    findCommentEnd = findCommentEndSse2;
+    break;
+#endif
+  default:
+    level = SIMD_SCALAR;
+    skipRun[SCAN_RUN_SPACE] = skipSpaceScalar;
+    skipRun[SCAN_RUN_ALNUM] = skipAlnumScalar;
+    skipRun[SCAN_RUN_DIGIT] = skipDigitScalar;
+    findCommentEnd = findCommentEndScalar;
+    break;
+  }
+  return level;
+}
+
+char *simdLevelName(SimdLevel level) {
+  switch (level) {
+  case SIMD_SCALAR: return "scalar";
+  case SIMD_SSE2: return "sse2";
+  case SIMD_AVX2: return "avx2";
+  default: return "best";
+  }
+}
+
+#ifdef HAVE_X86_SIMD
+__attribute__((constructor))
+static void selectBestSimd(void) {
+  selectSimdLevel(SIMD_BEST);
+}
+#endif
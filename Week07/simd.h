@@ -0,0 +1,41 @@
+/* Vectorized scanning kernels
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#ifndef __SIMD_H__
+#define __SIMD_H__
+
+/* Runs of characters that a DFA state loops on */
+typedef enum {
+  SCAN_RUN_NONE,
+  SCAN_RUN_SPACE,
+  SCAN_RUN_ALNUM,
+  SCAN_RUN_DIGIT
+} ScanRun;
+
+typedef enum {
+  SIMD_SCALAR,
+  SIMD_SSE2,
+  SIMD_AVX2,
+  SIMD_BEST
+} SimdLevel;
+
+/* Each kernel returns the first position in [p, end) that is not part
+ * of the run (end if there is none). findCommentEnd returns the
+ * position of the '*' of the first "*)", or NULL.
+ */
+typedef const char* (*RunKernel)(const char *p, const char *end);
+
+extern RunKernel skipRun[];
+extern const char* (*findCommentEnd)(const char *p, const char *end);
+
+/* The best level is selected when the program is loaded. Selecting
+ * another one changes the kernels of every thread, so it is done before
+ * any of them scans.
+ */
+SimdLevel selectSimdLevel(SimdLevel level);
+char *simdLevelName(SimdLevel level);
+
+#endif
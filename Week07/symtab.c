@@ -7,328 +7,396 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "alloc.h"
 #include "symtab.h"
 #include "error.h"
 
-void freeObject(Object* obj);
-void freeScope(Scope* scope);
-void freeObjectList(ObjectNode *objList);
-void freeReferenceList(ObjectNode *objList);
 
-SymTab* symtab;
-Type* intType;
-Type* charType;
+/* Everything the symbol table builds lives in the region of the context
+ * and is released at once by cleanSymTab(), which keeps the blocks for
+ * the next compilation.
+ */
+#define symtabAlloc(size) regionAlloc(&ctx->region, (size))
 
 /******************* Type utilities ******************************/
 
-Type* makeIntType(void) {
-  Type* type = (Type*) malloc(sizeof(Type));
-  type->typeClass = TP_INT;
-  return type;
-}
+/* Types are hash-consed: every distinct type is built once and shared,
+ * so two types are equal exactly when they are the same pointer. A type
+ * is never modified after construction and lives until cleanSymTab().
+ * The basic types are constant data.
+ */
+static const Type builtinIntType = { TP_INT, 0, NULL };
+static const Type builtinCharType = { TP_CHAR, 0, NULL };
 
-Type* makeCharType(void) {
-  Type* type = (Type*) malloc(sizeof(Type));
-  type->typeClass = TP_CHAR;
-  return type;
-}
+Type* intType = (Type*) &builtinIntType;
+Type* charType = (Type*) &builtinCharType;
 
-Type* makeArrayType(int arraySize, Type* elementType) {
-  Type* type = (Type*) malloc(sizeof(Type));
-  type->typeClass = TP_ARRAY;
+#define TYPE_SLOT(size, element, mask) \
+  ((((unsigned int) (size) * 2654435761u) ^ (unsigned int) ((size_t) (element) >> 4)) & (mask))
+
+static Type* newType(CompilerContext *ctx, enum TypeClass typeClass, int arraySize, Type* elementType) {
+  Type* type = (Type*) symtabAlloc(sizeof(Type));
+  type->typeClass = typeClass;
   type->arraySize = arraySize;
   type->elementType = elementType;
   return type;
 }
 
-Type* duplicateType(Type* type) {
-  Type* resultType = (Type*) malloc(sizeof(Type));
-  resultType->typeClass = type->typeClass;
-  if (type->typeClass == TP_ARRAY) {
-    resultType->arraySize = type->arraySize;
-    resultType->elementType = duplicateType(type->elementType);
-  }
-  return resultType;
+static void growTypeTable(CompilerContext *ctx) {
+  Type** old = ctx->symtab->typeTable;
+  int oldSize = ctx->symtab->typeMask + 1;
+  int size = oldSize == 0 ? 64 : oldSize * 2;
+  int i, slot;
+
+  ctx->symtab->typeTable = (Type**) memAlloc(size * sizeof(Type*));
+  for (i = 0; i < size; i++)
+    ctx->symtab->typeTable[i] = NULL;
+  ctx->symtab->typeMask = size - 1;
+
+  for (i = 0; i < oldSize; i++)
+    if (old[i] != NULL) {
+      slot = TYPE_SLOT(old[i]->arraySize, old[i]->elementType, ctx->symtab->typeMask);
+      while (ctx->symtab->typeTable[slot] != NULL)
+	slot = (slot + 1) & ctx->symtab->typeMask;
+      ctx->symtab->typeTable[slot] = old[i];
+    }
+  memFree(old);
 }
 
-int compareType(Type* type1, Type* type2) {
-  if (type1->typeClass == type2->typeClass) {
-    if (type1->typeClass == TP_ARRAY) {
-      if (type1->arraySize == type2->arraySize)
-	return compareType(type1->elementType, type2->elementType);
-      else return 0;
-    } else return 1;
-  } else return 0;
+void cleanTypes(CompilerContext *ctx) {
+  memFree(ctx->symtab->typeTable);
+  ctx->symtab->typeTable = NULL;
+  ctx->symtab->typeCount = 0;
+  ctx->symtab->typeMask = -1;
 }
 
-void freeType(Type* type) {
-  switch (type->typeClass) {
-  case TP_INT:
-  case TP_CHAR:
-    free(type);
-    break;
-  case TP_ARRAY:
-    freeType(type->elementType);
-    freeType(type);
-    break;
-  }
+Type* makeIntType(void) {
+  return intType;
 }
 
-/******************* Constant utility ******************************/
+Type* makeCharType(void) {
+  return charType;
+}
 
-ConstantValue* makeIntConstant(int i) {
-  ConstantValue* value = (ConstantValue*) malloc(sizeof(ConstantValue));
-  value->type = TP_INT;
-  value->intValue = i;
-  return value;
+Type* makeArrayType(CompilerContext *ctx, int arraySize, Type* elementType) {
+  Type* type;
+  int slot;
+
+  if (2 * (ctx->symtab->typeCount + 1) > ctx->symtab->typeMask + 1)
+    growTypeTable(ctx);
+
+  slot = TYPE_SLOT(arraySize, elementType, ctx->symtab->typeMask);
+  while ((type = ctx->symtab->typeTable[slot]) != NULL) {
+    if (type->arraySize == arraySize && type->elementType == elementType)
+      return type;
+    slot = (slot + 1) & ctx->symtab->typeMask;
+  }
+
+  type = newType(ctx, TP_ARRAY, arraySize, elementType);
+  ctx->symtab->typeTable[slot] = type;
+  ctx->symtab->typeCount ++;
+  return type;
 }
 
-ConstantValue* makeCharConstant(char ch) {
-  ConstantValue* value = (ConstantValue*) malloc(sizeof(ConstantValue));
-  value->type = TP_CHAR;
-  value->charValue = ch;
+int compareType(Type* type1, Type* type2) {
+  return type1 == type2;
+}
+
+
+/******************* Constant utility ******************************/
+
+/* Constants are small and passed around by value */
+ConstantValue makeIntConstant(int i) {
+  ConstantValue value;
+  value.type = TP_INT;
+  value.intValue = i;
   return value;
 }
 
-ConstantValue* duplicateConstantValue(ConstantValue* v) {
-  ConstantValue* value = (ConstantValue*) malloc(sizeof(ConstantValue));
-  value->type = v->type;
-  if (v->type == TP_INT) 
-    value->intValue = v->intValue;
-  else
-    value->charValue = v->charValue;
+ConstantValue makeCharConstant(char ch) {
+  ConstantValue value;
+  value.type = TP_CHAR;
+  value.charValue = ch;
   return value;
 }
 
 /******************* Object utilities ******************************/
 
-Scope* createScope(Object* owner, Scope* outer) {
-  Scope* scope = (Scope*) malloc(sizeof(Scope));
-  scope->objList = NULL;
+Scope* createScope(CompilerContext *ctx, Object* owner, Scope* outer) {
+  Scope* scope = (Scope*) symtabAlloc(sizeof(Scope));
+  scope->objects = NULL;
+  scope->objectCount = 0;
+  scope->objectCapacity = 0;
   scope->owner = owner;
   scope->outer = outer;
   return scope;
 }
 
-Object* createProgramObject(char *programName) {
-  Object* program = (Object*) malloc(sizeof(Object));
-  strcpy(program->name, programName);
+Object* createProgramObject(CompilerContext *ctx, Atom programName) {
+  Object* program = (Object*) symtabAlloc(sizeof(Object));
+  program->name = programName;
   program->kind = OBJ_PROGRAM;
-  program->progAttrs = (ProgramAttributes*) malloc(sizeof(ProgramAttributes));
-  program->progAttrs->scope = createScope(program,NULL);
-  symtab->program = program;
+  program->progAttrs.scope = createScope(ctx, program,NULL);
+  program->progAttrs.body = NO_NODE;
+  ctx->symtab->program = program;
 
   return program;
 }
 
-Object* createConstantObject(char *name) {
-  Object* obj = (Object*) malloc(sizeof(Object));
-  strcpy(obj->name, name);
+Object* createConstantObject(CompilerContext *ctx, Atom name) {
+  Object* obj = (Object*) symtabAlloc(sizeof(Object));
+  obj->name = name;
   obj->kind = OBJ_CONSTANT;
-  obj->constAttrs = (ConstantAttributes*) malloc(sizeof(ConstantAttributes));
   return obj;
 }
 
-Object* createTypeObject(char *name) {
-  Object* obj = (Object*) malloc(sizeof(Object));
-  strcpy(obj->name, name);
+Object* createTypeObject(CompilerContext *ctx, Atom name) {
+  Object* obj = (Object*) symtabAlloc(sizeof(Object));
+  obj->name = name;
   obj->kind = OBJ_TYPE;
-  obj->typeAttrs = (TypeAttributes*) malloc(sizeof(TypeAttributes));
   return obj;
 }
 
-Object* createVariableObject(char *name) {
-  Object* obj = (Object*) malloc(sizeof(Object));
-  strcpy(obj->name, name);
+Object* createVariableObject(CompilerContext *ctx, Atom name) {
+  Object* obj = (Object*) symtabAlloc(sizeof(Object));
+  obj->name = name;
   obj->kind = OBJ_VARIABLE;
-  obj->varAttrs = (VariableAttributes*) malloc(sizeof(VariableAttributes));
-  obj->varAttrs->scope = symtab->currentScope;
+  obj->varAttrs.scope = ctx->symtab->currentScope;
   return obj;
 }
 
-Object* createFunctionObject(char *name) {
-  Object* obj = (Object*) malloc(sizeof(Object));
-  strcpy(obj->name, name);
+Object* createFunctionObject(CompilerContext *ctx, Atom name) {
+  Object* obj = (Object*) symtabAlloc(sizeof(Object));
+  obj->name = name;
   obj->kind = OBJ_FUNCTION;
-  obj->funcAttrs = (FunctionAttributes*) malloc(sizeof(FunctionAttributes));
-  obj->funcAttrs->paramList = NULL;
-  obj->funcAttrs->scope = createScope(obj, symtab->currentScope);
+  obj->funcAttrs.paramList = NULL;
+  obj->funcAttrs.scope = createScope(ctx, obj, ctx->symtab->currentScope);
+  obj->funcAttrs.body = NO_NODE;
   return obj;
 }
 
-Object* createProcedureObject(char *name) {
-  Object* obj = (Object*) malloc(sizeof(Object));
-  strcpy(obj->name, name);
+Object* createProcedureObject(CompilerContext *ctx, Atom name) {
+  Object* obj = (Object*) symtabAlloc(sizeof(Object));
+  obj->name = name;
   obj->kind = OBJ_PROCEDURE;
-  obj->procAttrs = (ProcedureAttributes*) malloc(sizeof(ProcedureAttributes));
-  obj->procAttrs->paramList = NULL;
-  obj->procAttrs->scope = createScope(obj, symtab->currentScope);
+  obj->procAttrs.paramList = NULL;
+  obj->procAttrs.scope = createScope(ctx, obj, ctx->symtab->currentScope);
+  obj->procAttrs.body = NO_NODE;
   return obj;
 }
 
-Object* createParameterObject(char *name, enum ParamKind kind, Object* owner) {
-  Object* obj = (Object*) malloc(sizeof(Object));
-  strcpy(obj->name, name);
+Object* createParameterObject(CompilerContext *ctx, Atom name, enum ParamKind kind, Object* owner) {
+  Object* obj = (Object*) symtabAlloc(sizeof(Object));
+  obj->name = name;
   obj->kind = OBJ_PARAMETER;
-  obj->paramAttrs = (ParameterAttributes*) malloc(sizeof(ParameterAttributes));
-  obj->paramAttrs->kind = kind;
-  obj->paramAttrs->function = owner;
+  obj->paramAttrs.kind = kind;
+  obj->paramAttrs.function = owner;
   return obj;
 }
 
-void freeObject(Object* obj) {
-  switch (obj->kind) {
-  case OBJ_CONSTANT:
-    free(obj->constAttrs->value);
-    free(obj->constAttrs);
-    break;
-  case OBJ_TYPE:
-    free(obj->typeAttrs->actualType);
-    free(obj->typeAttrs);
-    break;
-  case OBJ_VARIABLE:
-    free(obj->varAttrs->type);
-    free(obj->varAttrs);
-    break;
-  case OBJ_FUNCTION:
-    freeReferenceList(obj->funcAttrs->paramList);
-    freeType(obj->funcAttrs->returnType);
-    freeScope(obj->funcAttrs->scope);
-    free(obj->funcAttrs);
-    break;
-  case OBJ_PROCEDURE:
-    freeReferenceList(obj->procAttrs->paramList);
-    freeScope(obj->procAttrs->scope);
-    free(obj->procAttrs);
-    break;
-  case OBJ_PROGRAM:
-    freeScope(obj->progAttrs->scope);
-    free(obj->progAttrs);
-    break;
-  case OBJ_PARAMETER:
-    freeType(obj->paramAttrs->type);
-    free(obj->paramAttrs);
+void addObject(CompilerContext *ctx, ObjectNode **objList, Object* obj) {
+  ObjectNode* node = (ObjectNode*) symtabAlloc(sizeof(ObjectNode));
+  node->object = obj;
+  node->next = NULL;
+  if ((*objList) == NULL) 
+    *objList = node;
+  else {
+    ObjectNode *n = *objList;
+    while (n->next != NULL) 
+      n = n->next;
+    n->next = node;
   }
-  free(obj);
 }
 
-void freeScope(Scope* scope) {
-  freeObjectList(scope->objList);
-  free(scope);
+void addScopeObject(CompilerContext *ctx, Scope* scope, Object* obj) {
+  if (scope->objectCount == scope->objectCapacity) {
+    scope->objectCapacity = scope->objectCapacity == 0 ? 8 : scope->objectCapacity * 2;
+    scope->objects = (Object**) regionGrow(&ctx->region, scope->objects,
+					   scope->objectCount * sizeof(Object*),
+					   scope->objectCapacity * sizeof(Object*));
+  }
+  scope->objects[scope->objectCount++] = obj;
 }
 
-void freeObjectList(ObjectNode *objList) {
-  ObjectNode* list = objList;
+/******************* Bindings ******************************/
 
-  while (list != NULL) {
-    ObjectNode* node = list;
-    list = list->next;
-    freeObject(node->object);
-    free(node);
-  }
-}
+void bindObject(CompilerContext *ctx, Object* obj, Scope* scope) {
+  Binding* binding;
+  int size, i;
 
-void freeReferenceList(ObjectNode *objList) {
-  ObjectNode* list = objList;
+  if (obj->name >= ctx->symtab->visibleCapacity) {
+    size = ctx->symtab->visibleCapacity == 0 ? 256 : ctx->symtab->visibleCapacity;
+    while (size <= obj->name) size *= 2;
+    ctx->symtab->visible = (int*) memRealloc(ctx->symtab->visible, size * sizeof(int));
+    for (i = ctx->symtab->visibleCapacity; i < size; i++)
+      ctx->symtab->visible[i] = -1;
+    ctx->symtab->visibleCapacity = size;
+  }
 
-  while (list != NULL) {
-    ObjectNode* node = list;
-    list = list->next;
-    free(node);
+  if (ctx->symtab->bindingCount == ctx->symtab->bindingCapacity) {
+    ctx->symtab->bindingCapacity = ctx->symtab->bindingCapacity == 0 ? 256 : ctx->symtab->bindingCapacity * 2;
+    ctx->symtab->bindings = (Binding*) memRealloc(ctx->symtab->bindings, ctx->symtab->bindingCapacity * sizeof(Binding));
   }
+
+  binding = &(ctx->symtab->bindings[ctx->symtab->bindingCount]);
+  binding->object = obj;
+  binding->scope = scope;
+  binding->shadowed = ctx->symtab->visible[obj->name];
+  ctx->symtab->visible[obj->name] = ctx->symtab->bindingCount++;
 }
 
-void addObject(ObjectNode **objList, Object* obj) {
-  ObjectNode* node = (ObjectNode*) malloc(sizeof(ObjectNode));
-  node->object = obj;
-  node->next = NULL;
-  if ((*objList) == NULL) 
-    *objList = node;
-  else {
-    ObjectNode *n = *objList;
-    while (n->next != NULL) 
-      n = n->next;
-    n->next = node;
+/* Scopes close in the reverse order they open, so the bindings of the
+ * closing scope are exactly those on top of the stack.
+ */
+void unbindScope(CompilerContext *ctx, Scope* scope) {
+  Binding* binding;
+
+  while (ctx->symtab->bindingCount > 0) {
+    binding = &(ctx->symtab->bindings[ctx->symtab->bindingCount - 1]);
+    if (binding->scope != scope) break;
+    ctx->symtab->visible[binding->object->name] = binding->shadowed;
+    ctx->symtab->bindingCount --;
   }
 }
 
-Object* findObject(ObjectNode *objList, char *name) {
-  while (objList != NULL) {
-    if (strcmp(objList->object->name, name) == 0) 
-      return objList->object;
-    else objList = objList->next;
-  }
+/******************* Builtins ******************************/
+
+/* The builtin environment is constant data. It is never allocated or
+ * bound: the builtin names have fixed atoms, and lookupObject() falls
+ * back to this table when no declaration of the name is visible.
+ */
+static const Object builtinWriteI;
+static const Object builtinWriteC;
+
+static const Object builtinParamI = {
+  .name = ATOM_I, .kind = OBJ_PARAMETER,
+  .paramAttrs = { PARAM_VALUE, (Type*) &builtinIntType, (Object*) &builtinWriteI }
+};
+
+static const Object builtinParamCh = {
+  .name = ATOM_CH, .kind = OBJ_PARAMETER,
+  .paramAttrs = { PARAM_VALUE, (Type*) &builtinCharType, (Object*) &builtinWriteC }
+};
+
+static const ObjectNode builtinParamsI = { (Object*) &builtinParamI, NULL };
+static const ObjectNode builtinParamsCh = { (Object*) &builtinParamCh, NULL };
+
+static const Object builtinReadC = {
+  .name = ATOM_READC, .kind = OBJ_FUNCTION,
+  .funcAttrs = { NULL, (Type*) &builtinCharType, NULL }
+};
+
+static const Object builtinReadI = {
+  .name = ATOM_READI, .kind = OBJ_FUNCTION,
+  .funcAttrs = { NULL, (Type*) &builtinIntType, NULL }
+};
+
+static const Object builtinWriteI = {
+  .name = ATOM_WRITEI, .kind = OBJ_PROCEDURE,
+  .procAttrs = { (ObjectNode*) &builtinParamsI, NULL }
+};
+
+static const Object builtinWriteC = {
+  .name = ATOM_WRITEC, .kind = OBJ_PROCEDURE,
+  .procAttrs = { (ObjectNode*) &builtinParamsCh, NULL }
+};
+
+static const Object builtinWriteLn = {
+  .name = ATOM_WRITELN, .kind = OBJ_PROCEDURE,
+  .procAttrs = { NULL, NULL }
+};
+
+/* Indexed by atom */
+static const Object *const builtins[] = {
+  &builtinReadC, &builtinReadI, &builtinWriteI, &builtinWriteC, &builtinWriteLn
+};
+
+#define BUILTIN_COUNT ((int) (sizeof(builtins) / sizeof(builtins[0])))
+
+/******************* Binding lookup ******************************/
+
+Binding* visibleBinding(CompilerContext *ctx, Atom name) {
+  int b;
+
+  if (name < 0 || name >= ctx->symtab->visibleCapacity)
+    return NULL;
+  b = ctx->symtab->visible[name];
+  return b < 0 ? NULL : &(ctx->symtab->bindings[b]);
+}
+
+Object* lookupObject(CompilerContext *ctx, Atom name) {
+  Binding* binding = visibleBinding(ctx, name);
+
+  if (binding != NULL)
+    return binding->object;
+  if (name >= 0 && name < BUILTIN_COUNT)
+    return (Object*) builtins[name];
   return NULL;
 }
 
+/* The object of that name declared in the current scope, if any */
+Object* findLocalObject(CompilerContext *ctx, Atom name) {
+  Binding* binding = visibleBinding(ctx, name);
+  if (binding == NULL || binding->scope != ctx->symtab->currentScope)
+    return NULL;
+  return binding->object;
+}
+
 /******************* others ******************************/
 
-void initSymTab(void) {
-  Object* obj;
-  Object* param;
-
-  symtab = (SymTab*) malloc(sizeof(SymTab));
-  symtab->globalObjectList = NULL;
-  
-  obj = createFunctionObject("READC");
-  obj->funcAttrs->returnType = makeCharType();
-  addObject(&(symtab->globalObjectList), obj);
-
-  obj = createFunctionObject("READI");
-  obj->funcAttrs->returnType = makeIntType();
-  addObject(&(symtab->globalObjectList), obj);
-
-  obj = createProcedureObject("WRITEI");
-  param = createParameterObject("i", PARAM_VALUE, obj);
-  param->paramAttrs->type = makeIntType();
-  addObject(&(obj->procAttrs->paramList),param);
-  addObject(&(symtab->globalObjectList), obj);
-
-  obj = createProcedureObject("WRITEC");
-  param = createParameterObject("ch", PARAM_VALUE, obj);
-  param->paramAttrs->type = makeCharType();
-  addObject(&(obj->procAttrs->paramList),param);
-  addObject(&(symtab->globalObjectList), obj);
-
-  obj = createProcedureObject("WRITELN");
-  addObject(&(symtab->globalObjectList), obj);
-
-  intType = makeIntType();
-  charType = makeCharType();
+void initSymTab(CompilerContext *ctx) {
+  ctx->symtab = (SymTab*) symtabAlloc(sizeof(SymTab));
+  ctx->symtab->currentScope = NULL;
+  ctx->symtab->bindings = NULL;
+  ctx->symtab->bindingCount = 0;
+  ctx->symtab->bindingCapacity = 0;
+  ctx->symtab->visible = NULL;
+  ctx->symtab->visibleCapacity = 0;
+  ctx->symtab->typeTable = NULL;
+  ctx->symtab->typeCount = 0;
+  ctx->symtab->typeMask = -1;
 }
 
-void cleanSymTab(void) {
-  freeObject(symtab->program);
-  freeObjectList(symtab->globalObjectList);
-  free(symtab);
-  freeType(intType);
-  freeType(charType);
+void cleanSymTab(CompilerContext *ctx) {
+  if (ctx->symtab == NULL)
+    return;
+  memFree(ctx->symtab->bindings);
+  memFree(ctx->symtab->visible);
+  cleanTypes(ctx);
+  regionReset(&ctx->region);
+  ctx->symtab = NULL;
 }
 
-void enterBlock(Scope* scope) {
-  symtab->currentScope = scope;
+void enterBlock(CompilerContext *ctx, Scope* scope) {
+  int i;
+
+  ctx->symtab->currentScope = scope;
+  for (i = 0; i < scope->objectCount; i++)
+    bindObject(ctx, scope->objects[i], scope);
 }
 
-void exitBlock(void) {
-  symtab->currentScope = symtab->currentScope->outer;
+void exitBlock(CompilerContext *ctx) {
+  unbindScope(ctx, ctx->symtab->currentScope);
+  ctx->symtab->currentScope = ctx->symtab->currentScope->outer;
 }
 
-void declareObject(Object* obj) {
+void declareObject(CompilerContext *ctx, Object* obj) {
   if (obj->kind == OBJ_PARAMETER) {
-    Object* owner = symtab->currentScope->owner;
+    Object* owner = ctx->symtab->currentScope->owner;
     switch (owner->kind) {
     case OBJ_FUNCTION:
-      addObject(&(owner->funcAttrs->paramList), obj);
+      addObject(ctx, &(owner->funcAttrs.paramList), obj);
       break;
     case OBJ_PROCEDURE:
-      addObject(&(owner->procAttrs->paramList), obj);
+      addObject(ctx, &(owner->procAttrs.paramList), obj);
       break;
     default:
       break;
     }
   }
  
-  addObject(&(symtab->currentScope->objList), obj);
+  addScopeObject(ctx, ctx->symtab->currentScope, obj);
+  bindObject(ctx, obj, ctx->symtab->currentScope);
 }
 
 
@@ -8,6 +8,8 @@
 #define __SYMTAB_H__
 
 #include "token.h"
+#include "atom.h"
+#include "context.h"
 
 enum TypeClass {
   TP_INT,
@@ -55,37 +57,50 @@ struct ObjectNode_;
 struct Object_;
 
 struct ConstantAttributes_ {
-  ConstantValue* value;
+  ConstantValue value;
 };
 
+/* localOffset is the word of the variable in its frame, set by the
+ * code generator
+ */
 struct VariableAttributes_ {
   Type *type;
   struct Scope_ *scope;
+  int localOffset;
 };
 
 struct TypeAttributes_ {
   Type *actualType;
 };
 
+/* body is the root of the statements in the AST, codeAddress the entry
+ * the code generator gives the subroutine
+ */
 struct ProcedureAttributes_ {
   struct ObjectNode_ *paramList;
   struct Scope_* scope;
+  AstRef body;
+  int codeAddress;
 };
 
 struct FunctionAttributes_ {
   struct ObjectNode_ *paramList;
   Type* returnType;
   struct Scope_ *scope;
+  AstRef body;
+  int codeAddress;
 };
 
 struct ProgramAttributes_ {
   struct Scope_ *scope;
+  AstRef body;
 };
 
 struct ParameterAttributes_ {
   enum ParamKind kind;
   Type* type;
   struct Object_ *function;
+  int localOffset;
 };
 
 typedef struct ConstantAttributes_ ConstantAttributes;
@@ -96,17 +111,18 @@ typedef struct ProcedureAttributes_ ProcedureAttributes;
 typedef struct ProgramAttributes_ ProgramAttributes;
 typedef struct ParameterAttributes_ ParameterAttributes;
 
+/* The attributes are stored inline, selected by kind */
 struct Object_ {
-  char name[MAX_IDENT_LEN];
+  Atom name;
   enum ObjectKind kind;
   union {
-    ConstantAttributes* constAttrs;
-    VariableAttributes* varAttrs;
-    TypeAttributes* typeAttrs;
-    FunctionAttributes* funcAttrs;
-    ProcedureAttributes* procAttrs;
-    ProgramAttributes* progAttrs;
-    ParameterAttributes* paramAttrs;
+    ConstantAttributes constAttrs;
+    VariableAttributes varAttrs;
+    TypeAttributes typeAttrs;
+    FunctionAttributes funcAttrs;
+    ProcedureAttributes procAttrs;
+    ProgramAttributes progAttrs;
+    ParameterAttributes paramAttrs;
   };
 };
 
@@ -119,49 +135,79 @@ struct ObjectNode_ {
 
 typedef struct ObjectNode_ ObjectNode;
 
+/* The objects of a scope in declaration order. frameSize is the number
+ * of words of the frame of the block, set by the code generator.
+ */
 struct Scope_ {
-  ObjectNode *objList;
+  Object **objects;
+  int objectCount;
+  int objectCapacity;
   Object *owner;
   struct Scope_ *outer;
+  int frameSize;
 };
 
 typedef struct Scope_ Scope;
 
+/* A binding makes an object visible under its name while its scope is
+ * open. Bindings form a stack in the order they are made; a binding
+ * also links to the one it shadows.
+ */
+struct Binding_ {
+  Object *object;
+  Scope *scope;
+  int shadowed;
+};
+
+typedef struct Binding_ Binding;
+
+/* LeBlanc-Cook symbol table: visible[atom] is the innermost binding of
+ * the name, or -1, so resolving a name is one array access at any depth.
+ * typeTable indexes the array types built so far.
+ */
 struct SymTab_ {
   Object* program;
   Scope* currentScope;
-  ObjectNode *globalObjectList;
+  Binding *bindings;
+  int bindingCount;
+  int bindingCapacity;
+  int *visible;
+  int visibleCapacity;
+  Type** typeTable;
+  int typeCount;
+  int typeMask;
 };
 
 typedef struct SymTab_ SymTab;
 
+void cleanTypes(CompilerContext *ctx);
 Type* makeIntType(void);
 Type* makeCharType(void);
-Type* makeArrayType(int arraySize, Type* elementType);
-Type* duplicateType(Type* type);
+Type* makeArrayType(CompilerContext *ctx, int arraySize, Type* elementType);
 int compareType(Type* type1, Type* type2);
-void freeType(Type* type);
-
-ConstantValue* makeIntConstant(int i);
-ConstantValue* makeCharConstant(char ch);
-ConstantValue* duplicateConstantValue(ConstantValue* v);
-
-Scope* createScope(Object* owner, Scope* outer);
-
-Object* createProgramObject(char *programName);
-Object* createConstantObject(char *name);
-Object* createTypeObject(char *name);
-Object* createVariableObject(char *name);
-Object* createFunctionObject(char *name);
-Object* createProcedureObject(char *name);
-Object* createParameterObject(char *name, enum ParamKind kind, Object* owner);
-
-Object* findObject(ObjectNode *objList, char *name);
 
-void initSymTab(void);
-void cleanSymTab(void);
-void enterBlock(Scope* scope);
-void exitBlock(void);
-void declareObject(Object* obj);
+ConstantValue makeIntConstant(int i);
+ConstantValue makeCharConstant(char ch);
+
+Scope* createScope(CompilerContext *ctx, Object* owner, Scope* outer);
+
+Object* createProgramObject(CompilerContext *ctx, Atom programName);
+Object* createConstantObject(CompilerContext *ctx, Atom name);
+Object* createTypeObject(CompilerContext *ctx, Atom name);
+Object* createVariableObject(CompilerContext *ctx, Atom name);
+Object* createFunctionObject(CompilerContext *ctx, Atom name);
+Object* createProcedureObject(CompilerContext *ctx, Atom name);
+Object* createParameterObject(CompilerContext *ctx, Atom name, enum ParamKind kind, Object* owner);
+
+void addObject(CompilerContext *ctx, ObjectNode **objList, Object* obj);
+void addScopeObject(CompilerContext *ctx, Scope* scope, Object* obj);
+Object* lookupObject(CompilerContext *ctx, Atom name);
+Object* findLocalObject(CompilerContext *ctx, Atom name);
+
+void initSymTab(CompilerContext *ctx);
+void cleanSymTab(CompilerContext *ctx);
+void enterBlock(CompilerContext *ctx, Scope* scope);
+void exitBlock(CompilerContext *ctx);
+void declareObject(CompilerContext *ctx, Object* obj);
 
 #endif
@@ -6,55 +6,33 @@
 
 #include <stdlib.h>
 #include <ctype.h>
+#include <string.h>
 #include "token.h"
 
-struct {
-  char string[MAX_IDENT_LEN + 1];
-  TokenType tokenType;
-} keywords[KEYWORDS_COUNT] = {
-  {"PROGRAM", KW_PROGRAM},
-  {"CONST", KW_CONST},
-  {"TYPE", KW_TYPE},
-  {"VAR", KW_VAR},
-  {"INTEGER", KW_INTEGER},
-  {"CHAR", KW_CHAR},
-  {"ARRAY", KW_ARRAY},
-  {"OF", KW_OF},
-  {"FUNCTION", KW_FUNCTION},
-  {"PROCEDURE", KW_PROCEDURE},
-  {"BEGIN", KW_BEGIN},
-  {"END", KW_END},
-  {"CALL", KW_CALL},
-  {"IF", KW_IF},
-  {"THEN", KW_THEN},
-  {"ELSE", KW_ELSE},
-  {"WHILE", KW_WHILE},
-  {"DO", KW_DO},
-  {"FOR", KW_FOR},
-  {"TO", KW_TO}
-};
+/* The keyword table is a perfect hash generated by kwgen from keywords.def */
+#include "kwtable.h"
 
-int keywordEq(char *kw, char *string) {
-  while ((*kw != '\0') && (*string != '\0')) {
-    if (*kw != *string) break;
-    kw ++; string ++;
-  }
-  return ((*kw == '\0') && (*string == '\0'));
-}
+/* Keywords are case insensitive; the lexeme is folded to upper case here */
+TokenType checkKeyword(const char *string, int length) {
+  unsigned char s[KW_MAX_LEN];
+  int h, i;
+
+  if (length < KW_MIN_LEN || length > KW_MAX_LEN)
+    return TK_NONE;
+
+  for (i = 0; i < length; i++)
+    s[i] = toupper((unsigned char) string[i]);
 
-TokenType checkKeyword(char *string) {
-  int i;
-  for (i = 0; i < KEYWORDS_COUNT; i++)
-    if (keywordEq(keywords[i].string, string)) 
-      return keywords[i].tokenType;
+  h = KW_HASH(s, length);
+  if (kwTable[h].length == length && memcmp(kwTable[h].string, s, length) == 0)
+    return kwTable[h].tokenType;
   return TK_NONE;
 }
 
-Token* makeToken(TokenType tokenType, int lineNo, int colNo) {
-  Token *token = (Token*)malloc(sizeof(Token));
+Token* makeToken(Token *token, TokenType tokenType, int pos) {
   token->tokenType = tokenType;
-  token->lineNo = lineNo;
-  token->colNo = colNo;
+  token->pos = pos;
+  token->length = 0;
   return token;
 }
 
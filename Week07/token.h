@@ -7,9 +7,6 @@
 #ifndef __TOKEN_H__
 #define __TOKEN_H__
 
-#define MAX_IDENT_LEN 15
-#define KEYWORDS_COUNT 20
-
 typedef enum {
   TK_NONE, TK_IDENT, TK_NUMBER, TK_CHAR, TK_EOF,
 
@@ -26,15 +23,19 @@ typedef enum {
   SB_LPAR, SB_RPAR, SB_LSEL, SB_RSEL
 } TokenType; 
 
+/* A token refers to its lexeme by byte offset and length in the input
+ * buffer. Numbers and character constants carry their value, and an
+ * identifier carries its atom.
+ */
 typedef struct {
-  char string[MAX_IDENT_LEN + 1];
-  int lineNo, colNo;
+  int pos;
+  int length;
   TokenType tokenType;
   int value;
 } Token;
 
-TokenType checkKeyword(char *string);
-Token* makeToken(TokenType tokenType, int lineNo, int colNo);
+TokenType checkKeyword(const char *string, int length);
+Token* makeToken(Token *token, TokenType tokenType, int pos);
 char *tokenToString(TokenType tokenType);
 
 
@@ -0,0 +1,364 @@
+/* Stack machine
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "alloc.h"
+#include "vm.h"
+
+#if defined(__GNUC__) && !defined(VM_SWITCH_ONLY)
+#define HAVE_THREADED_DISPATCH 1
+#endif
+
+static const char *const statusMessages[] = {
+  "Halted.",
+  "Stack overflow.",
+  "Invalid memory access.",
+  "Invalid instruction.",
+  "Division by zero.",
+  "Array index out of range.",
+  "Invalid input."
+};
+
+const char *vmStatusMessage(VMStatus status) {
+  return statusMessages[status];
+}
+
+void initMachine(Machine *machine, FILE *in, FILE *out) {
+  machine->dispatch = VM_DISPATCH_BEST;
+  machine->stackSize = VM_STACK_SIZE;
+  machine->in = in;
+  machine->out = out;
+  machine->instructions = 0;
+  machine->pc = 0;
+}
+
+VMDispatch selectDispatch(VMDispatch dispatch) {
+#ifdef HAVE_THREADED_DISPATCH
+  return dispatch == VM_DISPATCH_SWITCH ? VM_DISPATCH_SWITCH : VM_DISPATCH_THREADED;
+#else
+  return VM_DISPATCH_SWITCH;
+#endif
+}
+
+char *dispatchName(VMDispatch dispatch) {
+  return dispatch == VM_DISPATCH_SWITCH ? "switch" : "threaded";
+}
+
+/* The machine trusts the instruction stream, which the generator or
+ * loadCode() has checked, but not the values it computes: every access
+ * is kept inside the live part of the stack, so a faulty program stops
+ * with a status instead of corrupting the interpreter.
+ */
+#define FAIL(st) do { status = (st); goto stop; } while (0)
+#define NEED(n) if (t < (n) - 1) FAIL(VM_BAD_ADDRESS)
+#define ROOM(n) if ((n) > size - 1 - t) FAIL(VM_STACK_OVERFLOW)
+#define CHECK_ADDRESS(x) if ((x) < 0 || (x) > t) FAIL(VM_BAD_ADDRESS)
+
+/* a = the base of the frame p static links out */
+#define BASE(p, a) do {                                         \
+    int level_ = (p);                                           \
+    a = b;                                                      \
+    while (level_-- > 0) {                                      \
+      CHECK_ADDRESS(a + FRAME_SL);                              \
+      a = s[a + FRAME_SL];                                      \
+    }                                                           \
+  } while (0)
+
+/* Arithmetic wraps around like the machine words it models */
+#define WRAP(x) ((int) (unsigned int) (x))
+
+/* What an instruction does to the stack is the same under both
+ * dispatches; each loop defines P and Q, the operands, and moves on
+ * to the next instruction its own way.
+ */
+#define DO_LA   BASE(P, a); ROOM(1); s[++t] = WRAP((unsigned) a + (unsigned) Q)
+#define DO_LV   BASE(P, a); a = WRAP((unsigned) a + (unsigned) Q); CHECK_ADDRESS(a); \
+                ROOM(1); s[t + 1] = s[a]; t ++
+#define DO_LC   ROOM(1); s[++t] = P
+#define DO_LI   NEED(1); CHECK_ADDRESS(s[t]); s[t] = s[s[t]]
+#define DO_INT  v = P; if (v < 0) FAIL(VM_BAD_INSTRUCTION); ROOM(v); t += v
+#define DO_DCT  v = P; if (v < 0) FAIL(VM_BAD_INSTRUCTION); NEED(v); t -= v
+#define DO_ST   NEED(2); CHECK_ADDRESS(s[t - 1]); s[s[t - 1]] = s[t]; t -= 2
+/* The new frame starts at t + 1 and returns to ra */
+#define DO_CALL(ra) BASE(P, a); ROOM(RESERVED_WORDS); s[t + 1 + FRAME_DL] = b; \
+                s[t + 1 + FRAME_RA] = (ra); s[t + 1 + FRAME_SL] = a; b = t + 1
+/* Leaves in v the return address, which must be the start of one of
+ * the count instructions or cells of the loop, as isStart[] marks them
+ */
+#define DO_RETURN(keep, isStart, count) if (b < 0 || b + FRAME_SL > t) FAIL(VM_BAD_ADDRESS); \
+                v = s[b + FRAME_RA]; if (v < 0 || v >= (count) || !(isStart)[v]) FAIL(VM_BAD_ADDRESS); \
+                t = (keep) ? b : b - 1; b = s[b + FRAME_DL]
+#define DO_RC   ROOM(1); if (fscanf(in, " %c", &c) != 1) FAIL(VM_BAD_INPUT); \
+                s[++t] = (unsigned char) c
+#define DO_RI   ROOM(1); if (fscanf(in, "%d", &v) != 1) FAIL(VM_BAD_INPUT); s[++t] = v
+#define DO_WRC  NEED(1); putc(s[t--], out)
+#define DO_WRI  NEED(1); fprintf(out, "%d", s[t--])
+#define DO_WLN  putc('\n', out)
+#define DO_BINARY(e) NEED(2); t --; s[t] = (e)
+#define DO_AD   DO_BINARY(WRAP((unsigned) s[t] + (unsigned) s[t + 1]))
+#define DO_SB   DO_BINARY(WRAP((unsigned) s[t] - (unsigned) s[t + 1]))
+#define DO_ML   DO_BINARY(WRAP((unsigned) s[t] * (unsigned) s[t + 1]))
+#define DO_DV   NEED(2); t --; if (s[t + 1] == 0) FAIL(VM_DIVISION_BY_ZERO); \
+                s[t] = s[t + 1] == -1 ? WRAP(0u - (unsigned) s[t]) : s[t] / s[t + 1]
+#define DO_NEG  NEED(1); s[t] = WRAP(0u - (unsigned) s[t])
+#define DO_CV   NEED(1); ROOM(1); s[t + 1] = s[t]; t ++
+#define DO_IX   NEED(2); v = s[t--]; if (v < 1 || v > P) FAIL(VM_INDEX_OUT_OF_RANGE); \
+                s[t] = WRAP(s[t] + (unsigned) (v - 1) * (unsigned) Q)
+#define DO_EQ   DO_BINARY(s[t] == s[t + 1])
+#define DO_NE   DO_BINARY(s[t] != s[t + 1])
+#define DO_GT   DO_BINARY(s[t] > s[t + 1])
+#define DO_LT   DO_BINARY(s[t] < s[t + 1])
+#define DO_GE   DO_BINARY(s[t] >= s[t + 1])
+#define DO_LE   DO_BINARY(s[t] <= s[t + 1])
+
+/******************************************************************/
+
+/* The portable loop decodes the bytecode as it goes */
+#define P codeOperand(pc, 0)
+#define Q codeOperand(pc, 1)
+
+static VMStatus runSwitch(Machine *machine, CodeBlock *block, int *s, const unsigned char *isStart) {
+  const unsigned char *code = block->code;
+  const unsigned char *pc = code;
+  FILE *in = machine->in, *out = machine->out;
+  int size = machine->stackSize;
+  int b = 0, t = -1;
+  int a, v;
+  char c;
+  long long count = 0;
+  VMStatus status = VM_HALTED;
+
+  for (;;) {
+    count ++;
+    switch (*pc) {
+    case OP_LA: DO_LA; pc += 9; break;
+    case OP_LV: DO_LV; pc += 9; break;
+    case OP_LC: DO_LC; pc += 5; break;
+    case OP_LI: DO_LI; pc += 1; break;
+    case OP_INT: DO_INT; pc += 5; break;
+    case OP_DCT: DO_DCT; pc += 5; break;
+    case OP_J:
+      pc = code + P;
+      break;
+    case OP_FJ:
+      NEED(1);
+      if (s[t--] == 0) pc = code + P;
+      else pc += 5;
+      break;
+    case OP_HL:
+      goto stop;
+    case OP_ST: DO_ST; pc += 1; break;
+    case OP_CALL:
+      DO_CALL(pc + 9 - code);
+      pc = code + Q;
+      break;
+    case OP_EP:
+    case OP_EF:
+      DO_RETURN(*pc == OP_EF, isStart, block->size);
+      pc = code + v;
+      break;
+    case OP_RC: DO_RC; pc += 1; break;
+    case OP_RI: DO_RI; pc += 1; break;
+    case OP_WRC: DO_WRC; pc += 1; break;
+    case OP_WRI: DO_WRI; pc += 1; break;
+    case OP_WLN: DO_WLN; pc += 1; break;
+    case OP_AD: DO_AD; pc += 1; break;
+    case OP_SB: DO_SB; pc += 1; break;
+    case OP_ML: DO_ML; pc += 1; break;
+    case OP_DV: DO_DV; pc += 1; break;
+    case OP_NEG: DO_NEG; pc += 1; break;
+    case OP_CV: DO_CV; pc += 1; break;
+    case OP_IX: DO_IX; pc += 9; break;
+    case OP_EQ: DO_EQ; pc += 1; break;
+    case OP_NE: DO_NE; pc += 1; break;
+    case OP_GT: DO_GT; pc += 1; break;
+    case OP_LT: DO_LT; pc += 1; break;
+    case OP_GE: DO_GE; pc += 1; break;
+    case OP_LE: DO_LE; pc += 1; break;
+    default:
+      FAIL(VM_BAD_INSTRUCTION);
+    }
+  }
+
+ stop:
+  machine->instructions = count;
+  machine->pc = pc - code;
+  return status;
+}
+
+#undef P
+#undef Q
+
+/******************************************************************/
+
+#ifdef HAVE_THREADED_DISPATCH
+
+/* Threaded code has a cell for the handler of each instruction and one
+ * for each of its operands. A jump operand points to the cell of its
+ * target, and return addresses on the stack are cell indexes.
+ */
+typedef union Cell_ {
+  const void *handler;
+  int operand;
+  const union Cell_ *target;
+} Cell;
+
+#define P (pc[1].operand)
+#define Q (pc[2].operand)
+#define NEXT do { count ++; goto *pc->handler; } while (0)
+
+static VMStatus runThreaded(Machine *machine, CodeBlock *block, int *s) {
+  static const void *const handlers[OP_COUNT] = {
+    [OP_LA] = &&do_LA, [OP_LV] = &&do_LV, [OP_LC] = &&do_LC, [OP_LI] = &&do_LI,
+    [OP_INT] = &&do_INT, [OP_DCT] = &&do_DCT, [OP_J] = &&do_J, [OP_FJ] = &&do_FJ,
+    [OP_HL] = &&do_HL, [OP_ST] = &&do_ST, [OP_CALL] = &&do_CALL, [OP_EP] = &&do_EP,
+    [OP_EF] = &&do_EF, [OP_RC] = &&do_RC, [OP_RI] = &&do_RI, [OP_WRC] = &&do_WRC,
+    [OP_WRI] = &&do_WRI, [OP_WLN] = &&do_WLN, [OP_AD] = &&do_AD, [OP_SB] = &&do_SB,
+    [OP_ML] = &&do_ML, [OP_DV] = &&do_DV, [OP_NEG] = &&do_NEG, [OP_CV] = &&do_CV,
+    [OP_IX] = &&do_IX, [OP_EQ] = &&do_EQ, [OP_NE] = &&do_NE, [OP_GT] = &&do_GT,
+    [OP_LT] = &&do_LT, [OP_GE] = &&do_GE, [OP_LE] = &&do_LE
+  };
+  FILE *in = machine->in, *out = machine->out;
+  int size = machine->stackSize;
+  int *cellOf = (int*) memAlloc(block->size * sizeof(int));
+  unsigned char *isStart;
+  const unsigned char *code;
+  Cell *cells;
+  const Cell *pc;
+  int cellCount = 0, address, i, k;
+  int b = 0, t = -1;
+  int a, v;
+  char c;
+  long long count = 0;
+  VMStatus status = VM_HALTED;
+
+  /* Translate the code before running it: number the cells first, so
+   * that jumps forward can be resolved as they are filled in.
+   */
+  for (address = 0; address < block->size; address += opLength(block->code[address])) {
+    cellOf[address] = cellCount;
+    cellCount += 1 + opOperands[block->code[address]];
+  }
+  cells = (Cell*) memAlloc(cellCount * sizeof(Cell));
+  isStart = (unsigned char*) memAlloc(cellCount);
+  memset(isStart, 0, cellCount);
+
+  for (address = 0; address < block->size; address += opLength(code[0])) {
+    code = block->code + address;
+    i = cellOf[address];
+    isStart[i] = 1;
+    cells[i].handler = handlers[code[0]];
+    switch (code[0]) {
+    case OP_J:
+    case OP_FJ:
+      cells[i + 1].target = cells + cellOf[codeOperand(code, 0)];
+      break;
+    case OP_CALL:
+      cells[i + 1].operand = codeOperand(code, 0);
+      cells[i + 2].target = cells + cellOf[codeOperand(code, 1)];
+      break;
+    default:
+      for (k = 0; k < opOperands[code[0]]; k++)
+        cells[i + 1 + k].operand = codeOperand(code, k);
+      break;
+    }
+  }
+
+  pc = cells;
+  NEXT;
+
+ do_LA: DO_LA; pc += 3; NEXT;
+ do_LV: DO_LV; pc += 3; NEXT;
+ do_LC: DO_LC; pc += 2; NEXT;
+ do_LI: DO_LI; pc += 1; NEXT;
+ do_INT: DO_INT; pc += 2; NEXT;
+ do_DCT: DO_DCT; pc += 2; NEXT;
+ do_J:
+  pc = pc[1].target;
+  NEXT;
+ do_FJ:
+  NEED(1);
+  if (s[t--] == 0) pc = pc[1].target;
+  else pc += 2;
+  NEXT;
+ do_HL:
+  goto stop;
+ do_ST: DO_ST; pc += 1; NEXT;
+ do_CALL:
+  DO_CALL(pc + 3 - cells);
+  pc = pc[2].target;
+  NEXT;
+ do_EP:
+  DO_RETURN(0, isStart, cellCount);
+  pc = cells + v;
+  NEXT;
+ do_EF:
+  DO_RETURN(1, isStart, cellCount);
+  pc = cells + v;
+  NEXT;
+ do_RC: DO_RC; pc += 1; NEXT;
+ do_RI: DO_RI; pc += 1; NEXT;
+ do_WRC: DO_WRC; pc += 1; NEXT;
+ do_WRI: DO_WRI; pc += 1; NEXT;
+ do_WLN: DO_WLN; pc += 1; NEXT;
+ do_AD: DO_AD; pc += 1; NEXT;
+ do_SB: DO_SB; pc += 1; NEXT;
+ do_ML: DO_ML; pc += 1; NEXT;
+ do_DV: DO_DV; pc += 1; NEXT;
+ do_NEG: DO_NEG; pc += 1; NEXT;
+ do_CV: DO_CV; pc += 1; NEXT;
+ do_IX: DO_IX; pc += 3; NEXT;
+ do_EQ: DO_EQ; pc += 1; NEXT;
+ do_NE: DO_NE; pc += 1; NEXT;
+ do_GT: DO_GT; pc += 1; NEXT;
+ do_LT: DO_LT; pc += 1; NEXT;
+ do_GE: DO_GE; pc += 1; NEXT;
+ do_LE: DO_LE; pc += 1; NEXT;
+
+ stop:
+  machine->instructions = count;
+  /* report the code address of the cell the machine stopped at */
+  for (address = 0; address < block->size; address += opLength(block->code[address]))
+    if (cells + cellOf[address] == pc) break;
+  machine->pc = address;
+  memFree(isStart);
+  memFree(cells);
+  memFree(cellOf);
+  return status;
+}
+
+#undef P
+#undef Q
+#undef NEXT
+
+#endif
+
+VMStatus runMachine(Machine *machine, CodeBlock *block) {
+  int *s = (int*) memAlloc(machine->stackSize * sizeof(int));
+  unsigned char *isStart = (unsigned char*) memAlloc(block->size);
+  VMStatus status;
+  int address;
+
+  /* the code addresses a return may go back to */
+  memset(isStart, 0, block->size);
+  for (address = 0; address < block->size; address += opLength(block->code[address]))
+    isStart[address] = 1;
+
+  memset(s, 0, machine->stackSize * sizeof(int));
+#ifdef HAVE_THREADED_DISPATCH
+  if (selectDispatch(machine->dispatch) == VM_DISPATCH_THREADED)
+    status = runThreaded(machine, block, s);
+  else
+#endif
+    status = runSwitch(machine, block, s, isStart);
+
+  memFree(isStart);
+  memFree(s);
+  fflush(machine->out);
+  return status;
+}
@@ -0,0 +1,56 @@
+/* Stack machine
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#ifndef __VM_H__
+#define __VM_H__
+
+#include <stdio.h>
+#include "instructions.h"
+
+#define VM_STACK_SIZE (4 * 1024 * 1024)
+
+typedef enum {
+  VM_HALTED,
+  VM_STACK_OVERFLOW,
+  VM_BAD_ADDRESS,
+  VM_BAD_INSTRUCTION,
+  VM_DIVISION_BY_ZERO,
+  VM_INDEX_OUT_OF_RANGE,
+  VM_BAD_INPUT
+} VMStatus;
+
+/* How the machine finds the handler of the next instruction: a switch
+ * on the opcode, or direct threading, where the code is translated once
+ * into the addresses of the handlers and each handler jumps to the
+ * next. Threading needs GCC's labels as values; a build with
+ * -DVM_SWITCH_ONLY, or without GCC, has the switch alone.
+ */
+typedef enum {
+  VM_DISPATCH_SWITCH,
+  VM_DISPATCH_THREADED,
+  VM_DISPATCH_BEST
+} VMDispatch;
+
+/* A machine reads with READI and READC from in and writes to out. The
+ * stack is allocated by runMachine() and released when it stops.
+ */
+typedef struct {
+  VMDispatch dispatch;
+  int stackSize;                /* in words */
+  FILE *in;
+  FILE *out;
+  long long instructions;       /* executed by the last run */
+  int pc;                       /* the code address where the last run stopped */
+} Machine;
+
+void initMachine(Machine *machine, FILE *in, FILE *out);
+/* The dispatch a machine of this build can use for the one asked */
+VMDispatch selectDispatch(VMDispatch dispatch);
+char *dispatchName(VMDispatch dispatch);
+VMStatus runMachine(Machine *machine, CodeBlock *block);
+const char *vmStatusMessage(VMStatus status);
+
+#endif
@@ -0,0 +1,493 @@
+/* x86-64 code generation
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include "codegen.h"
+#include "x86gen.h"
+#include "kplrt.h"
+
+/* Each block is a function with a frame on %rbp. The frame of the
+ * stack machine maps to it word for word: the caller pushes the
+ * arguments in order and then the static link, so that the link is at
+ * 16(%rbp) and the parameters above it; the result of a function is at
+ * -8(%rbp) and the variables below. Words are 8 bytes and integers the
+ * low 32 bits of them, which wrap as on the machines.
+ *
+ * Expressions are computed in %eax, with the left operand of a binary
+ * operator pushed while the right one is computed unless the right one
+ * is a constant or a variable of the running frame. %rdx walks static
+ * links and holds addresses. %r12 keeps %rsp while the stack is aligned
+ * for a call into the runtime; kpl_main keeps it for its caller in
+ * the slot of the result, which the program does not have.
+ */
+typedef struct {
+  CompilerContext *ctx;
+  FILE *out;
+  int labels;                   /* the last label used */
+} AsmGen;
+
+#define node(ref) astAt(&g->ctx->ast, (ref))
+
+static void genValue(AsmGen *g, AstRef expr);
+static void genStatements(AsmGen *g, AstRef statement);
+
+static void emit(AsmGen *g, const char *format, ...) {
+  va_list args;
+
+  fputc('\t', g->out);
+  va_start(args, format);
+  vfprintf(g->out, format, args);
+  va_end(args);
+  fputc('\n', g->out);
+}
+
+static int newLabel(AsmGen *g) {
+  return ++g->labels;
+}
+
+static void placeLabel(AsmGen *g, int label) {
+  fprintf(g->out, ".L%d:\n", label);
+}
+
+static void printSymbol(AsmGen *g, Object* owner) {
+  if (owner->kind == OBJ_PROGRAM)
+    fprintf(g->out, "kpl_main");
+  else fprintf(g->out, "kpl_%s_%d", atomName(&g->ctx->atoms, owner->name),
+               owner->kind == OBJ_FUNCTION ? owner->funcAttrs.codeAddress : owner->procAttrs.codeAddress);
+}
+
+static int paramCount(Scope* scope) {
+  int count = 0, i;
+
+  for (i = 0; i < scope->objectCount; i++)
+    if (scope->objects[i]->kind == OBJ_PARAMETER)
+      count ++;
+  return count;
+}
+
+/* The offset from %rbp of a word of the frame of scope */
+static int byteOffset(Scope* scope, int word) {
+  int params = paramCount(scope);
+
+  if (word == FRAME_RV) return -8;
+  if (word < RESERVED_WORDS + params) return 16 + 8 * (RESERVED_WORDS + params - word);
+  return -8 - 8 * (scope->frameSize - word);
+}
+
+/* The register holding the frame pointer of scope: %rbp for the
+ * running block, else %rdx loaded through the static links
+ */
+static const char *frameOf(AsmGen *g, Scope* scope) {
+  int level = levelOf(g->ctx, scope);
+
+  if (level == 0) return "%rbp";
+  emit(g, "movq 16(%%rbp), %%rdx");
+  while (--level > 0)
+    emit(g, "movq 16(%%rdx), %%rdx");
+  return "%rdx";
+}
+
+static void genRuntimeCall(AsmGen *g, const char *function) {
+  emit(g, "movq %%rsp, %%r12");
+  emit(g, "andq $-16, %%rsp");
+  emit(g, "call %s", function);
+  emit(g, "movq %%r12, %%rsp");
+}
+
+/* A constant or a variable of the running frame can be the operand of
+ * an instruction as it is. Returns 0 for other expressions.
+ */
+static int simpleOperand(AsmGen *g, AstRef expr, char *operand) {
+  AstNode *n = node(expr);
+  Object* obj;
+  Scope* scope;
+  int word;
+
+  switch (n->kind) {
+  case AST_NUMBER:
+  case AST_CHAR:
+    sprintf(operand, "$%d", n->value);
+    return 1;
+  case AST_VARIABLE:
+    obj = astObjectAt(&g->ctx->ast, n);
+    scope = slotOf(obj, &word);
+    if (isReferenceParameter(obj) || levelOf(g->ctx, scope) != 0) return 0;
+    sprintf(operand, "%d(%%rbp)", byteOffset(scope, word));
+    return 1;
+  default:
+    return 0;
+  }
+}
+
+/* Compute left into %eax and right into %ecx, or return right as the
+ * operand of the instruction that combines them
+ */
+static char *genOperands(AsmGen *g, AstRef left, AstRef right, char *operand) {
+  genValue(g, left);
+  if (simpleOperand(g, right, operand)) return operand;
+  emit(g, "pushq %%rax");
+  genValue(g, right);
+  emit(g, "movl %%eax, %%ecx");
+  emit(g, "popq %%rax");
+  return "%ecx";
+}
+
+/* Put the address of an lvalue in %rax and return its type */
+static Type* genAddress(AsmGen *g, AstRef lvalue) {
+  AstNode *n = node(lvalue);
+  Object* obj;
+  Scope* scope;
+  Type* type;
+  const char *frame;
+  char operand[32];
+  int word;
+
+  if (n->kind == AST_INDEX) {
+    type = genAddress(g, n->child[0]);
+    if (simpleOperand(g, n->child[1], operand))
+      emit(g, "movl %s, %%ecx", operand);
+    else {
+      emit(g, "pushq %%rax");
+      genValue(g, n->child[1]);
+      emit(g, "movl %%eax, %%ecx");
+      emit(g, "popq %%rax");
+    }
+    /* the indexes of an array of n elements run from 1 to n */
+    emit(g, "subl $1, %%ecx");
+    emit(g, "cmpl $%d, %%ecx", type->arraySize);
+    emit(g, "jae .Lindex_error");
+    if (sizeOfType(type->elementType) == 1)
+      emit(g, "leaq (%%rax,%%rcx,8), %%rax");
+    else {
+      emit(g, "imulq $%d, %%rcx", 8 * sizeOfType(type->elementType));
+      emit(g, "addq %%rcx, %%rax");
+    }
+    return type->elementType;
+  }
+
+  obj = astObjectAt(&g->ctx->ast, n);
+  scope = slotOf(obj, &word);
+  frame = frameOf(g, scope);
+  if (isReferenceParameter(obj))
+    emit(g, "movq %d(%s), %%rax", byteOffset(scope, word), frame);
+  else emit(g, "leaq %d(%s), %%rax", byteOffset(scope, word), frame);
+
+  switch (obj->kind) {
+  case OBJ_VARIABLE:
+    return obj->varAttrs.type;
+  case OBJ_PARAMETER:
+    return obj->paramAttrs.type;
+  default:
+    return obj->funcAttrs.returnType;
+  }
+}
+
+/* Load a scalar into %eax, or store %eax into it */
+static void genLoad(AsmGen *g, Object* obj) {
+  int word;
+  Scope* scope = slotOf(obj, &word);
+  const char *frame = frameOf(g, scope);
+
+  if (isReferenceParameter(obj)) {
+    emit(g, "movq %d(%s), %%rdx", byteOffset(scope, word), frame);
+    emit(g, "movl (%%rdx), %%eax");
+  } else emit(g, "movl %d(%s), %%eax", byteOffset(scope, word), frame);
+}
+
+static void genStore(AsmGen *g, Object* obj) {
+  int word;
+  Scope* scope = slotOf(obj, &word);
+  const char *frame = frameOf(g, scope);
+
+  if (isReferenceParameter(obj)) {
+    emit(g, "movq %d(%s), %%rdx", byteOffset(scope, word), frame);
+    emit(g, "movl %%eax, (%%rdx)");
+  } else emit(g, "movl %%eax, %d(%s)", byteOffset(scope, word), frame);
+}
+
+/* The arguments and then the static link of the callee's frame are
+ * pushed; the caller drops them after the call. A function returns its
+ * result in %eax.
+ */
+static void genCall(AsmGen *g, Object* callee, Scope* scope, ObjectNode* paramList, AstRef arg) {
+  int count = 0;
+
+  for (; arg != NO_NODE; arg = node(arg)->next, paramList = paramList->next) {
+    if (paramList->object->paramAttrs.kind == PARAM_REFERENCE)
+      genAddress(g, arg);
+    else genValue(g, arg);
+    emit(g, "pushq %%rax");
+    count ++;
+  }
+  emit(g, "pushq %s", frameOf(g, scope->outer));
+  fprintf(g->out, "\tcall ");
+  printSymbol(g, callee);
+  fprintf(g->out, "\n");
+  emit(g, "addq $%d, %%rsp", 8 * (count + 1));
+}
+
+static void genDivide(AsmGen *g, const char *divisor) {
+  int done = newLabel(g), divide = newLabel(g);
+
+  if (divisor[0] != '%')
+    emit(g, "movl %s, %%ecx", divisor);
+  emit(g, "testl %%ecx, %%ecx");
+  emit(g, "je .Ldivision_error");
+  /* the quotient of the least integer by -1 wraps, as on the machines */
+  emit(g, "cmpl $-1, %%ecx");
+  emit(g, "jne .L%d", divide);
+  emit(g, "negl %%eax");
+  emit(g, "jmp .L%d", done);
+  placeLabel(g, divide);
+  emit(g, "cltd");
+  emit(g, "idivl %%ecx");
+  placeLabel(g, done);
+}
+
+static void genValue(AsmGen *g, AstRef expr) {
+  AstNode *n = node(expr);
+  Object* obj;
+  const char *operand;
+  char buffer[32];
+
+  switch (n->kind) {
+  case AST_NUMBER:
+  case AST_CHAR:
+    emit(g, "movl $%d, %%eax", n->value);
+    break;
+  case AST_VARIABLE:
+    genLoad(g, astObjectAt(&g->ctx->ast, n));
+    break;
+  case AST_INDEX:
+    genAddress(g, expr);
+    emit(g, "movl (%%rax), %%eax");
+    break;
+  case AST_FCALL:
+    obj = astObjectAt(&g->ctx->ast, n);
+    if (isBuiltin(obj, ATOM_READI))
+      genRuntimeCall(g, "kpl_readi");
+    else if (isBuiltin(obj, ATOM_READC))
+      genRuntimeCall(g, "kpl_readc");
+    else genCall(g, obj, obj->funcAttrs.scope, obj->funcAttrs.paramList, n->child[0]);
+    break;
+  case AST_UNARY:
+    genValue(g, n->child[0]);
+    if (n->op == SB_MINUS)
+      emit(g, "negl %%eax");
+    break;
+  case AST_BINARY:
+    operand = genOperands(g, n->child[0], n->child[1], buffer);
+    switch (n->op) {
+    case SB_PLUS:
+      emit(g, "addl %s, %%eax", operand);
+      break;
+    case SB_MINUS:
+      emit(g, "subl %s, %%eax", operand);
+      break;
+    case SB_TIMES:
+      emit(g, "imull %s, %%eax", operand);
+      break;
+    default:
+      genDivide(g, operand);
+      break;
+    }
+    break;
+  default:
+    break;
+  }
+}
+
+/* Jump to label when the condition is false */
+static void genCondition(AsmGen *g, AstRef condition, int label) {
+  AstNode *n = node(condition);
+  const char *jump;
+  char buffer[32];
+
+  emit(g, "cmpl %s, %%eax", genOperands(g, n->child[0], n->child[1], buffer));
+  switch (n->op) {
+  case SB_EQ:
+    jump = "jne";
+    break;
+  case SB_NEQ:
+    jump = "je";
+    break;
+  case SB_LE:
+    jump = "jg";
+    break;
+  case SB_LT:
+    jump = "jge";
+    break;
+  case SB_GE:
+    jump = "jl";
+    break;
+  default:
+    jump = "jle";
+    break;
+  }
+  emit(g, "%s .L%d", jump, label);
+}
+
+static void genFor(AsmGen *g, AstNode *n) {
+  Object* obj = astObjectAt(&g->ctx->ast, n);
+  int loop = newLabel(g), done = newLabel(g);
+  char buffer[32];
+
+  genValue(g, n->child[0]);
+  genStore(g, obj);
+  placeLabel(g, loop);
+  genLoad(g, obj);
+  if (simpleOperand(g, n->child[1], buffer))
+    emit(g, "cmpl %s, %%eax", buffer);
+  else {
+    emit(g, "pushq %%rax");
+    genValue(g, n->child[1]);
+    emit(g, "movl %%eax, %%ecx");
+    emit(g, "popq %%rax");
+    emit(g, "cmpl %%ecx, %%eax");
+  }
+  emit(g, "jg .L%d", done);
+  genStatements(g, n->child[2]);
+  genLoad(g, obj);
+  emit(g, "addl $1, %%eax");
+  genStore(g, obj);
+  emit(g, "jmp .L%d", loop);
+  placeLabel(g, done);
+}
+
+static void genStatements(AsmGen *g, AstRef statement) {
+  AstNode *n;
+  Object* obj;
+  int skip, done;
+
+  for (; statement != NO_NODE; statement = n->next) {
+    n = node(statement);
+    switch (n->kind) {
+    case AST_ASSIGN:
+      if (node(n->child[0])->kind == AST_INDEX) {
+        genAddress(g, n->child[0]);
+        emit(g, "pushq %%rax");
+        genValue(g, n->child[1]);
+        emit(g, "popq %%rdx");
+        emit(g, "movl %%eax, (%%rdx)");
+      } else {
+        genValue(g, n->child[1]);
+        genStore(g, astObjectAt(&g->ctx->ast, node(n->child[0])));
+      }
+      break;
+    case AST_CALL:
+      obj = astObjectAt(&g->ctx->ast, n);
+      if (isBuiltin(obj, ATOM_WRITEI)) {
+        genValue(g, n->child[0]);
+        emit(g, "movl %%eax, %%edi");
+        genRuntimeCall(g, "kpl_writei");
+      } else if (isBuiltin(obj, ATOM_WRITEC)) {
+        genValue(g, n->child[0]);
+        emit(g, "movl %%eax, %%edi");
+        genRuntimeCall(g, "kpl_writec");
+      } else if (isBuiltin(obj, ATOM_WRITELN))
+        genRuntimeCall(g, "kpl_writeln");
+      else genCall(g, obj, obj->procAttrs.scope, obj->procAttrs.paramList, n->child[0]);
+      break;
+    case AST_GROUP:
+      genStatements(g, n->child[0]);
+      break;
+    case AST_IF:
+      skip = newLabel(g);
+      genCondition(g, n->child[0], skip);
+      genStatements(g, n->child[1]);
+      if (n->child[2] != NO_NODE) {
+        done = newLabel(g);
+        emit(g, "jmp .L%d", done);
+        placeLabel(g, skip);
+        genStatements(g, n->child[2]);
+        placeLabel(g, done);
+      } else placeLabel(g, skip);
+      break;
+    case AST_WHILE:
+      skip = newLabel(g);
+      done = newLabel(g);
+      placeLabel(g, skip);
+      genCondition(g, n->child[0], done);
+      genStatements(g, n->child[1]);
+      emit(g, "jmp .L%d", skip);
+      placeLabel(g, done);
+      break;
+    case AST_FOR:
+      genFor(g, n);
+      break;
+    }
+  }
+}
+
+/* The subroutines of a block are functions of their own, written out
+ * before it; codeAddress numbers their symbols.
+ */
+static void genAsmBlock(AsmGen *g, Object* owner) {
+  Scope* scope = ownerScope(owner);
+  Scope* outer = g->ctx->symtab->currentScope;
+  int frameBytes, i;
+
+  layoutScope(scope);
+  if (owner->kind == OBJ_FUNCTION) owner->funcAttrs.codeAddress = newLabel(g);
+  else if (owner->kind == OBJ_PROCEDURE) owner->procAttrs.codeAddress = newLabel(g);
+
+  for (i = 0; i < scope->objectCount; i++)
+    if (scope->objects[i]->kind == OBJ_FUNCTION || scope->objects[i]->kind == OBJ_PROCEDURE)
+      genAsmBlock(g, scope->objects[i]);
+
+  g->ctx->symtab->currentScope = scope;
+  frameBytes = (8 + 8 * (scope->frameSize - RESERVED_WORDS - paramCount(scope)) + 15) & ~15;
+
+  fprintf(g->out, "\n");
+  printSymbol(g, owner);
+  fprintf(g->out, ":\n");
+  emit(g, "pushq %%rbp");
+  emit(g, "movq %%rsp, %%rbp");
+  emit(g, "subq $%d, %%rsp", frameBytes);
+
+  switch (owner->kind) {
+  case OBJ_FUNCTION:
+    genStatements(g, owner->funcAttrs.body);
+    emit(g, "movl -8(%%rbp), %%eax");
+    break;
+  case OBJ_PROCEDURE:
+    genStatements(g, owner->procAttrs.body);
+    break;
+  default:
+    emit(g, "movq %%r12, -8(%%rbp)");
+    genStatements(g, owner->progAttrs.body);
+    emit(g, "movq -8(%%rbp), %%r12");
+    break;
+  }
+  emit(g, "leave");
+  emit(g, "ret");
+  g->ctx->symtab->currentScope = outer;
+}
+
+void genAssembly(CompilerContext *ctx, Object* program) {
+  AsmGen gen;
+  AsmGen *g = &gen;
+
+  gen.ctx = ctx;
+  gen.out = ctx->assembly;
+  gen.labels = 0;
+
+  fprintf(g->out, "\t.text\n\t.globl kpl_main\n");
+  genAsmBlock(g, program);
+
+  /* a runtime error does not return, so the stack is only aligned */
+  fprintf(g->out, "\n.Lindex_error:\n");
+  emit(g, "andq $-16, %%rsp");
+  emit(g, "movl $%d, %%edi", KPL_INDEX_ERROR);
+  emit(g, "call kpl_fail");
+  fprintf(g->out, ".Ldivision_error:\n");
+  emit(g, "andq $-16, %%rsp");
+  emit(g, "movl $%d, %%edi", KPL_DIVISION_ERROR);
+  emit(g, "call kpl_fail");
+  fprintf(g->out, "\n\t.section .note.GNU-stack,\"\",@progbits\n");
+}
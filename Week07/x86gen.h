@@ -0,0 +1,19 @@
+/* x86-64 code generation
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#ifndef __X86GEN_H__
+#define __X86GEN_H__
+
+#include "symtab.h"
+
+/* Write the checked AST of the program to ctx->assembly as x86-64
+ * assembly for the GNU assembler and the System V ABI. The program is
+ * the function kpl_main of kplrt.h: cc prog.s kplrt.o -o prog makes it
+ * a program.
+ */
+void genAssembly(CompilerContext *ctx, Object* program);
+
+#endif